@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "abi_lib_generator.h"
+#include "std_filesystem.h"
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+
+#include <benchmark/benchmark.h>
+
+/// Measures the ABI library emission; arguments: whitelisted functions,
+/// blacklisted functions, headers
+static void BM_GenerateABILibrary(benchmark::State &state) {
+  auto whitelisted_function_count = static_cast<std::size_t>(state.range(0));
+  auto blacklisted_function_count = static_cast<std::size_t>(state.range(1));
+  auto header_count = static_cast<std::size_t>(state.range(2));
+
+  ABILibrary abi_library;
+
+  for (std::size_t i = 0U; i < header_count; ++i) {
+    abi_library.header_list.push_back("level0_" + std::to_string(i % 4U) +
+                                      "/header_" + std::to_string(i) + ".h");
+  }
+
+  for (std::size_t i = 0U; i < whitelisted_function_count; ++i) {
+    WhitelistedFunction function;
+    function.location = {abi_library.header_list.empty()
+                             ? std::string("main.cpp")
+                             : abi_library.header_list.at(i % header_count),
+                         static_cast<std::uint32_t>(i + 1U), 1U};
+
+    function.friendly_name = "function_" + std::to_string(i);
+    function.mangled_name = "_Z" +
+                            std::to_string(function.friendly_name.size()) +
+                            function.friendly_name + "i";
+
+    abi_library.whitelisted_function_list.push_back(function);
+  }
+
+  for (std::size_t i = 0U; i < blacklisted_function_count; ++i) {
+    BlacklistedFunction function;
+    function.location = {"blacklisted.h", static_cast<std::uint32_t>(i + 1U),
+                         1U};
+
+    function.friendly_name = "blacklisted_" + std::to_string(i);
+    function.mangled_name = function.friendly_name;
+    function.reason = BlacklistedFunction::Reason::FunctionPointer;
+    function.reason_data = BlacklistedFunction::FunctionPointerLocations{
+        {{"callbacks.h", 1U, 1U}, "callback_t"}};
+
+    abi_library.blacklisted_function_list.push_back(function);
+  }
+
+  llvm::SmallString<256> output_folder;
+  if (llvm::sys::fs::createUniqueDirectory("abigen-benchmark",
+                                           output_folder)) {
+    state.SkipWithError("Failed to create the output folder");
+    return;
+  }
+
+  CommandLineOptions cmdline_options;
+  cmdline_options.language = "cxx14";
+  cmdline_options.output =
+      (stdfs::path(output_folder.str().str()) / "abi").string();
+
+  Profile profile;
+  profile.name = "synthetic";
+
+  for (auto _ : state) {
+    auto status = generateABILibrary(cmdline_options, abi_library, profile);
+    if (!status.succeeded()) {
+      state.SkipWithError("Failed to generate the ABI library");
+      break;
+    }
+  }
+
+  auto function_count = static_cast<std::int64_t>(
+      whitelisted_function_count + blacklisted_function_count);
+
+  state.SetItemsProcessed(state.iterations() * function_count);
+
+  std::error_code error;
+  stdfs::remove_all(output_folder.str().str(), error);
+}
+
+BENCHMARK(BM_GenerateABILibrary)
+    ->Args({1000, 100, 50})
+    ->Args({10000, 1000, 200})
+    ->Args({100000, 10000, 1000})
+    ->Unit(benchmark::kMillisecond);
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "astvisitor.h"
+#include "generate_utils.h"
+#include "headertreegenerator.h"
+
+#include <chrono>
+
+#include <benchmark/benchmark.h>
+
+namespace {
+/// Forwards the AST events to an ASTVisitor, measuring the time spent
+/// inside ASTVisitor::finalize
+class TimedASTVisitor final : public IASTVisitor {
+  /// The visitor that does the actual work
+  IASTVisitorRef ast_visitor;
+
+ public:
+  /// The time spent in the last finalize() call, in seconds
+  double finalize_time{0.0};
+
+  /// Constructor
+  TimedASTVisitor(IASTVisitorRef ast_visitor) : ast_visitor(ast_visitor) {}
+
+  /// Destructor
+  virtual ~TimedASTVisitor() override = default;
+
+  virtual void initialize(clang::ASTContext *ast_context,
+                          clang::SourceManager *source_manager,
+                          const NameManglerList &name_manglers) override {
+    ast_visitor->initialize(ast_context, source_manager, name_manglers);
+  }
+
+  virtual bool VisitFunctionDecl(clang::FunctionDecl *declaration) override {
+    return ast_visitor->VisitFunctionDecl(declaration);
+  }
+
+  virtual void finalize() override {
+    auto start_time = std::chrono::steady_clock::now();
+    ast_visitor->finalize();
+
+    finalize_time = std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - start_time)
+                        .count();
+  }
+
+  virtual BlacklistedFunctionList blacklistedFunctions(
+      std::size_t name_mangler_index) const override {
+    return ast_visitor->blacklistedFunctions(name_mangler_index);
+  }
+
+  virtual WhitelistedFunctionList whitelistedFunctions(
+      std::size_t name_mangler_index) const override {
+    return ast_visitor->whitelistedFunctions(name_mangler_index);
+  }
+
+  virtual std::map<std::string, std::size_t> containerSizes() const override {
+    return ast_visitor->containerSizes();
+  }
+};
+}  // namespace
+
+/// Measures ASTVisitor::finalize only (the parsing time is excluded);
+/// arguments: header count, classes per header, methods per class, function
+/// pointer chain length
+static void BM_ASTVisitorFinalize(benchmark::State &state) {
+  HeaderTreeSettings settings;
+  settings.header_count = static_cast<std::size_t>(state.range(0));
+  settings.class_count = static_cast<std::size_t>(state.range(1));
+  settings.method_count = static_cast<std::size_t>(state.range(2));
+  settings.function_pointer_count = static_cast<std::size_t>(state.range(3));
+  settings.failure_percentage = 0U;
+
+  SyntheticHeaderTreeRef header_tree;
+  if (!SyntheticHeaderTree::create(header_tree, settings)) {
+    state.SkipWithError("Failed to generate the header tree");
+    return;
+  }
+
+  CompilerInstanceRef compiler;
+  auto status = CompilerInstance::create(
+      compiler, getSyntheticCompilerSettings(*header_tree.get()));
+
+  if (!status.succeeded()) {
+    state.SkipWithError("Failed to create the compiler instance");
+    return;
+  }
+
+  auto source_buffer = generateSourceBuffer(header_tree->headerList(), {});
+
+  for (auto _ : state) {
+    IASTVisitorRef ast_visitor;
+    if (!ASTVisitor::create(ast_visitor).succeeded()) {
+      state.SkipWithError("Failed to create the ASTVisitor object");
+      break;
+    }
+
+    auto timed_ast_visitor = std::make_shared<TimedASTVisitor>(ast_visitor);
+    if (!compiler->processAST(source_buffer, timed_ast_visitor).succeeded()) {
+      state.SkipWithError("Failed to parse the header tree");
+      break;
+    }
+
+    state.SetIterationTime(timed_ast_visitor->finalize_time);
+  }
+}
+
+BENCHMARK(BM_ASTVisitorFinalize)
+    ->Args({50, 0, 0, 0})
+    ->Args({50, 4, 16, 0})
+    ->Args({50, 0, 0, 16})
+    ->Args({200, 4, 16, 16})
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond);
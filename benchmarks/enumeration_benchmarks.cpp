@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "generate_utils.h"
+#include "headertreegenerator.h"
+
+#include <benchmark/benchmark.h>
+
+/// Measures the header enumeration; arguments: header count, folder depth
+static void BM_EnumerateIncludeFiles(benchmark::State &state) {
+  HeaderTreeSettings settings;
+  settings.header_count = static_cast<std::size_t>(state.range(0));
+  settings.folder_depth = static_cast<std::size_t>(state.range(1));
+  settings.function_count = 0U;
+
+  SyntheticHeaderTreeRef header_tree;
+  if (!SyntheticHeaderTree::create(header_tree, settings)) {
+    state.SkipWithError("Failed to generate the header tree");
+    return;
+  }
+
+  for (auto _ : state) {
+    std::vector<HeaderDescriptor> header_files;
+    if (!enumerateIncludeFiles(header_files, {header_tree->root()})) {
+      state.SkipWithError("Failed to enumerate the include files");
+      break;
+    }
+
+    benchmark::DoNotOptimize(header_files.data());
+  }
+
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_EnumerateIncludeFiles)
+    ->Args({1000, 2})
+    ->Args({10000, 3})
+    ->Args({50000, 4})
+    ->Unit(benchmark::kMillisecond);
@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "headertreegenerator.h"
+#include "std_filesystem.h"
+
+#include <fstream>
+#include <sstream>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+
+namespace {
+/// Returns true if the given header should fail to compile; the selection is
+/// deterministic, so that every run uses the same tree
+bool isFailingHeader(std::size_t index, std::size_t failure_percentage) {
+  auto value =
+      ((static_cast<std::uint64_t>(index) + 1U) * 2654435761ULL) % 100ULL;
+  return value < failure_percentage;
+}
+
+/// Returns the path of the given header, relative to the tree root
+std::string getHeaderPath(std::size_t index,
+                          const HeaderTreeSettings &settings) {
+  stdfs::path path;
+
+  auto folder_index = index;
+  for (std::size_t level = 0U; level < settings.folder_depth; ++level) {
+    path /= "level" + std::to_string(level) + "_" +
+            std::to_string(folder_index % 4U);
+
+    folder_index /= 4U;
+  }
+
+  path /= "header_" + std::to_string(index) + ".h";
+  return path.generic_string();
+}
+
+/// Generates the contents of the given header
+std::string generateHeader(std::size_t index,
+                           const HeaderTreeSettings &settings) {
+  std::stringstream buffer;
+  auto id = std::to_string(index);
+
+  buffer << "#pragma once\n\n";
+
+  bool has_dependency =
+      settings.dependency_depth > 1U && index % settings.dependency_depth != 0U;
+
+  if (has_dependency) {
+    buffer << "#include <" << getHeaderPath(index - 1U, settings) << ">\n\n";
+  }
+
+  if (isFailingHeader(index, settings.failure_percentage)) {
+    buffer << "#error \"synthetic failure\"\n\n";
+  }
+
+  // A small record graph, linked to the one of the previous header
+  buffer << "struct record_" << id << " {\n"
+         << "  int value;\n"
+         << "  struct record_" << id << " *next;\n";
+
+  if (has_dependency) {
+    buffer << "  struct record_" << (index - 1U) << " *previous;\n";
+  }
+
+  buffer << "};\n\n";
+
+  // Function pointer chain; each type accepts the previous one
+  for (std::size_t i = 0U; i < settings.function_pointer_count; ++i) {
+    auto name = "callback_" + id + "_" + std::to_string(i);
+
+    buffer << "typedef int (*" << name << ")(";
+    if (i != 0U) {
+      buffer << "callback_" << id << "_" << (i - 1U) << ", ";
+    }
+
+    buffer << "struct record_" << id << " *);\n";
+
+    buffer << "struct holder_" << id << "_" << i << " { " << name
+           << " callback; };\n";
+
+    buffer << "int invoke_" << id << "_" << i << "(struct holder_" << id
+           << "_" << i << " *holder);\n\n";
+  }
+
+  for (std::size_t i = 0U; i < settings.function_count; ++i) {
+    buffer << "int function_" << id << "_" << i << "(int value, struct record_"
+           << id << " *record);\n";
+  }
+
+  buffer << "\n";
+
+  for (std::size_t i = 0U; i < settings.class_count; ++i) {
+    auto name = "class_" + id + "_" + std::to_string(i);
+
+    buffer << "class " << name;
+    if (i != 0U) {
+      buffer << " : public class_" << id << "_" << (i - 1U);
+    }
+
+    buffer << " {\n public:\n";
+
+    for (std::size_t j = 0U; j < settings.method_count; ++j) {
+      buffer << "  int method_" << i << "_" << j << "(int value, record_"
+             << id << " *record);\n";
+    }
+
+    buffer << "};\n\n";
+  }
+
+  return buffer.str();
+}
+}  // namespace
+
+/// Private class data
+struct SyntheticHeaderTree::PrivateData final {
+  /// The temporary folder containing the headers
+  std::string root;
+
+  /// The headers, relative to the root folder
+  StringList header_list;
+};
+
+SyntheticHeaderTree::SyntheticHeaderTree() : d(new PrivateData) {}
+
+bool SyntheticHeaderTree::create(SyntheticHeaderTreeRef &obj,
+                                 const HeaderTreeSettings &settings) {
+  obj.reset();
+
+  SyntheticHeaderTreeRef header_tree;
+
+  try {
+    header_tree.reset(new SyntheticHeaderTree);
+
+  } catch (const std::bad_alloc &) {
+    return false;
+  }
+
+  llvm::SmallString<256> root;
+  if (llvm::sys::fs::createUniqueDirectory("abigen-benchmark", root)) {
+    return false;
+  }
+
+  header_tree->d->root = root.str();
+
+  for (std::size_t i = 0U; i < settings.header_count; ++i) {
+    auto relative_path = getHeaderPath(i, settings);
+    auto path = stdfs::path(header_tree->d->root) / relative_path;
+
+    std::error_code error;
+    stdfs::create_directories(path.parent_path(), error);
+    if (error) {
+      return false;
+    }
+
+    std::ofstream header_file(path.string());
+    header_file << generateHeader(i, settings);
+    if (!header_file) {
+      return false;
+    }
+
+    header_tree->d->header_list.push_back(relative_path);
+  }
+
+  obj = std::move(header_tree);
+  return true;
+}
+
+SyntheticHeaderTree::~SyntheticHeaderTree() {
+  if (!d->root.empty()) {
+    std::error_code error;
+    stdfs::remove_all(d->root, error);
+  }
+}
+
+const std::string &SyntheticHeaderTree::root() const { return d->root; }
+
+const StringList &SyntheticHeaderTree::headerList() const {
+  return d->header_list;
+}
+
+CompilerInstanceSettings getSyntheticCompilerSettings(
+    const SyntheticHeaderTree &header_tree) {
+  CompilerInstanceSettings settings;
+  settings.profile.name = "synthetic";
+  settings.profile.root_path = header_tree.root();
+  settings.language = Language::CXX;
+  settings.language_standard = 14;
+  settings.additional_include_folders = {header_tree.root()};
+
+  return settings;
+}
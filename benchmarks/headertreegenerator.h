@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "compilerinstance.h"
+#include "types.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+/// Describes the synthetic header tree to generate
+struct HeaderTreeSettings final {
+  /// How many headers to generate
+  std::size_t header_count{64U};
+
+  /// How many folder levels are used to store the headers
+  std::size_t folder_depth{2U};
+
+  /// The length of the include chains; each header includes the previous
+  /// one, unless it is the first header of a chain
+  std::size_t dependency_depth{4U};
+
+  /// The percentage (0-100) of headers containing an #error directive; the
+  /// headers including them fail as well
+  std::size_t failure_percentage{10U};
+
+  /// How many classes are declared in each header (C++ only)
+  std::size_t class_count{0U};
+
+  /// How many methods are declared in each class
+  std::size_t method_count{0U};
+
+  /// The length of the function pointer typedef chain declared in each
+  /// header; every function using one of them is blacklisted
+  std::size_t function_pointer_count{0U};
+
+  /// How many plain functions are declared in each header
+  std::size_t function_count{8U};
+};
+
+class SyntheticHeaderTree;
+
+/// A reference to a SyntheticHeaderTree object
+using SyntheticHeaderTreeRef = std::unique_ptr<SyntheticHeaderTree>;
+
+/// A header tree generated inside a temporary folder, which is deleted
+/// together with this object
+class SyntheticHeaderTree final {
+  struct PrivateData;
+
+  /// Private class data
+  std::unique_ptr<PrivateData> d;
+
+  /// Private constructor; use ::create() instead
+  SyntheticHeaderTree();
+
+ public:
+  /// Generates a new header tree with the given settings
+  static bool create(SyntheticHeaderTreeRef &obj,
+                     const HeaderTreeSettings &settings);
+
+  /// Destructor
+  ~SyntheticHeaderTree();
+
+  /// The temporary folder containing the headers
+  const std::string &root() const;
+
+  /// The headers, relative to the root folder
+  const StringList &headerList() const;
+
+  /// Disable the copy constructor
+  SyntheticHeaderTree(const SyntheticHeaderTree &other) = delete;
+
+  /// Disable the assignment operator
+  SyntheticHeaderTree &operator=(const SyntheticHeaderTree &other) = delete;
+};
+
+/// Returns the settings of a compiler instance that only searches the given
+/// header tree; no profile headers are used
+CompilerInstanceSettings getSyntheticCompilerSettings(
+    const SyntheticHeaderTree &header_tree);
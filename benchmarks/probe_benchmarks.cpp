@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "generate_utils.h"
+#include "headertreegenerator.h"
+
+#include <sstream>
+
+#include <benchmark/benchmark.h>
+
+/// Measures the probe loop; arguments: header count, dependency depth,
+/// failure percentage
+static void BM_ProbeIncludeHeaders(benchmark::State &state) {
+  HeaderTreeSettings settings;
+  settings.header_count = static_cast<std::size_t>(state.range(0));
+  settings.dependency_depth = static_cast<std::size_t>(state.range(1));
+  settings.failure_percentage = static_cast<std::size_t>(state.range(2));
+
+  SyntheticHeaderTreeRef header_tree;
+  if (!SyntheticHeaderTree::create(header_tree, settings)) {
+    state.SkipWithError("Failed to generate the header tree");
+    return;
+  }
+
+  std::vector<HeaderDescriptor> header_files;
+  if (!enumerateIncludeFiles(header_files, {header_tree->root()})) {
+    state.SkipWithError("Failed to enumerate the include files");
+    return;
+  }
+
+  CompilerInstanceRef compiler;
+  auto status = CompilerInstance::create(
+      compiler, getSyntheticCompilerSettings(*header_tree.get()));
+
+  if (!status.succeeded()) {
+    state.SkipWithError("Failed to create the compiler instance");
+    return;
+  }
+
+  std::size_t included_header_count = 0U;
+
+  for (auto _ : state) {
+    auto pending_header_files = header_files;
+    std::stringstream log;
+
+    auto include_list =
+        probeIncludeHeaders(*compiler.get(), pending_header_files, {}, log);
+
+    included_header_count = include_list.size();
+  }
+
+  state.counters["included"] = static_cast<double>(included_header_count);
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_ProbeIncludeHeaders)
+    ->Args({50, 1, 0})
+    ->Args({50, 5, 0})
+    ->Args({50, 5, 20})
+    ->Args({200, 5, 10})
+    ->Unit(benchmark::kMillisecond);
@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MODULE_TESTS_WORD_H
+#define MODULE_TESTS_WORD_H
+
+/* This header is built as a module; it only compiles if the module build
+   sees the same target predefines as the translation unit */
+#if !defined(__x86_64__) || !defined(__SIZEOF_LONG__) || \
+    !defined(__STDC_VERSION__)
+#error "The module has been built without the target predefines"
+#endif
+
+typedef char module_tests_long_size_check[sizeof(long) == 8 ? 1 : -1];
+
+unsigned long module_tests_get_word(void);
+
+#endif
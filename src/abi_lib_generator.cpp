@@ -15,9 +15,11 @@
  */
 
 #include "abi_lib_generator.h"
+#include "fileutils.h"
 #include "std_filesystem.h"
 
 #include <fstream>
+#include <iomanip>
 #include <sstream>
 
 namespace {
@@ -51,7 +53,8 @@ void generateAbigenHeader(std::ostream &stream, const Profile &profile) {
          << "\n"
          << "  Profile: " << profile.name << "\n"
          << "    Root path: " << profile.root_path << "\n"
-         << "    Resource directory: " << profile.resource_dir << "\n\n";
+         << "    Resource directory: " << profile.resource_dir << "\n"
+         << "    Target triple: " << (profile.target_triple.empty() ? "(host)" : profile.target_triple) << "\n\n";
   // clang-format on
 
   stream << "    Internal isystem:\n";
@@ -83,6 +86,36 @@ void generateAbigenHeader(std::ostream &stream, const Profile &profile) {
   stream << "*/\n\n";
 }
 
+/// Replaces the given file with the new contents, but only if they differ from
+/// what is already on disk; this preserves the file timestamp, so that build
+/// systems can skip the (expensive) steps that depend on the ABI library
+bool writeFileIfChanged(bool &updated, const std::string &path,
+                        const std::string &contents) {
+  updated = false;
+
+  {
+    std::ifstream current_file(path, std::ios::binary);
+    if (current_file) {
+      std::string current_contents(
+          (std::istreambuf_iterator<char>(current_file)),
+          std::istreambuf_iterator<char>());
+
+      if (current_file.good() || current_file.eof()) {
+        if (current_contents == contents) {
+          return true;
+        }
+      }
+    }
+  }
+
+  if (!writeFileAtomically(path, contents)) {
+    return false;
+  }
+
+  updated = true;
+  return true;
+}
+
 std::ostream &operator<<(std::ostream &stream,
                          const SourceCodeLocation &location) {
   stream << location.file_path << "@" << location.line << ":"
@@ -120,23 +153,15 @@ std::ostream &operator<<(std::ostream &stream,
 
 ABILibGeneratorStatus generateABILibrary(
     const CommandLineOptions &cmdline_options, const ABILibrary &abi_library,
-    const Profile &profile) {
-  // Open the destination files
+    const Profile &profile, std::ostream &log) {
+  // Render both files in memory first; they are only written to disk if
+  // their contents have changed
   auto header_file_path = cmdline_options.output + ".h";
   auto cpp_file_path = cmdline_options.output + ".cpp";
   auto header_file_name = stdfs::path(header_file_path).filename().string();
 
-  std::fstream header_file(header_file_path, std::fstream::out);
-  if (!header_file) {
-    return ABILibGeneratorStatus(false, ABILibGeneratorError::IOError,
-                                 "Failed to create the header file");
-  }
-
-  std::fstream implementation_file(cpp_file_path, std::fstream::out);
-  if (!implementation_file) {
-    return ABILibGeneratorStatus(false, ABILibGeneratorError::IOError,
-                                 "Failed to create the implementation file");
-  }
+  std::stringstream header_file;
+  std::stringstream implementation_file;
 
   // Generate the header file
   generateAbigenHeader(header_file, profile);
@@ -245,5 +270,25 @@ ABILibGeneratorStatus generateABILibrary(
     implementation_file << "}\n";
   }
 
+  // Save the files
+  bool updated;
+  if (!writeFileIfChanged(updated, header_file_path, header_file.str())) {
+    return ABILibGeneratorStatus(false, ABILibGeneratorError::IOError,
+                                 "Failed to create the header file");
+  }
+
+  if (!updated) {
+    log << "The header file is up to date: " << header_file_path << "\n";
+  }
+
+  if (!writeFileIfChanged(updated, cpp_file_path, implementation_file.str())) {
+    return ABILibGeneratorStatus(false, ABILibGeneratorError::IOError,
+                                 "Failed to create the implementation file");
+  }
+
+  if (!updated) {
+    log << "The implementation file is up to date: " << cpp_file_path << "\n";
+  }
+
   return ABILibGeneratorStatus(true);
 }
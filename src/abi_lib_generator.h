@@ -20,6 +20,8 @@
 #include "istatus.h"
 #include "types.h"
 
+#include <ostream>
+
 /// Error code returned by ABILibGeneratorStatus objects
 enum class ABILibGeneratorError { IOError, Unknown };
 
@@ -27,7 +29,8 @@ enum class ABILibGeneratorError { IOError, Unknown };
 using ABILibGeneratorStatus = IStatus<ABILibGeneratorError>;
 
 /// Generates the ABI library using the provided command line options with the
-/// given ABI library state
+/// given ABI library state; the files that are left untouched are reported
+/// to the log
 ABILibGeneratorStatus generateABILibrary(
     const CommandLineOptions &cmdline_options, const ABILibrary &abi_library,
-    const Profile &profile);
+    const Profile &profile, std::ostream &log);
@@ -4,6 +4,7 @@
 
 #include <algorithm>
 #include <queue>
+#include <tuple>
 
 namespace {
 /// A node in the type dependency tree
@@ -41,6 +42,14 @@ using TypeInformationMap =
 
 /// A map used to tie a function to its dependencies
 using FunctionMap = std::unordered_map<clang::FunctionDecl *, TypeList>;
+
+/// Strict weak ordering for source code locations; used to make the output
+/// independent from the hash map iteration order
+bool isLocationLessThan(const SourceCodeLocation &lhs,
+                        const SourceCodeLocation &rhs) {
+  return std::tie(lhs.file_path, lhs.line, lhs.column) <
+         std::tie(rhs.file_path, rhs.line, rhs.column);
+}
 }  // namespace
 
 /// Private class data
@@ -51,8 +60,9 @@ struct ASTVisitor::PrivateData final {
   /// The source manager, used to acquire source code locations
   clang::SourceManager *source_manager{nullptr};
 
-  /// The name mangler received from the ASTConsumer
-  clang::MangleContext *name_mangler{nullptr};
+  /// The name manglers received from the ASTConsumer; the functions are
+  /// filtered once for each one of them
+  NameManglerList name_manglers;
 
   /// The type dependency tree
   TypeDependencyTree type_dependency_tree;
@@ -66,11 +76,11 @@ struct ASTVisitor::PrivateData final {
   /// Name and location for each type we encountered
   TypeInformationMap type_info_map;
 
-  /// The list of blacklisted functions
-  BlacklistedFunctionList blacklisted_function_list;
+  /// The list of blacklisted functions, for each name mangler
+  std::vector<BlacklistedFunctionList> blacklisted_function_lists;
 
-  /// The list of whitelisted functions
-  WhitelistedFunctionList whitelisted_function_list;
+  /// The list of whitelisted functions, for each name mangler
+  std::vector<WhitelistedFunctionList> whitelisted_function_lists;
 };
 
 ASTVisitor::ASTVisitor() : d(new PrivateData) {}
@@ -199,14 +209,15 @@ TypeList ASTVisitor::collectFunctionParameterTypes(clang::FunctionDecl *decl) {
 }
 
 std::string ASTVisitor::getMangledFunctionName(
-    clang::FunctionDecl *function_declaration) {
+    clang::FunctionDecl *function_declaration,
+    clang::MangleContext *name_mangler) {
   std::string function_name;
 
-  if (d->name_mangler->shouldMangleCXXName(function_declaration)) {
+  if (name_mangler->shouldMangleCXXName(function_declaration)) {
     std::string buffer;
     llvm::raw_string_ostream stream(buffer);
 
-    d->name_mangler->mangleName(function_declaration, stream);
+    name_mangler->mangleName(function_declaration, stream);
     function_name = stream.str();
   } else {
     function_name = function_declaration->getName().str();
@@ -285,17 +296,17 @@ ASTVisitor::~ASTVisitor() {}
 
 void ASTVisitor::initialize(clang::ASTContext *ast_context,
                             clang::SourceManager *source_manager,
-                            clang::MangleContext *name_mangler) {
+                            const NameManglerList &name_manglers) {
   d->ast_context = ast_context;
   d->source_manager = source_manager;
-  d->name_mangler = name_mangler;
+  d->name_manglers = name_manglers;
 
   d->type_dependency_tree.clear();
   d->function_map.clear();
   d->enumerated_type_list.clear();
   d->type_info_map.clear();
-  d->blacklisted_function_list.clear();
-  d->whitelisted_function_list.clear();
+  d->blacklisted_function_lists.clear();
+  d->whitelisted_function_lists.clear();
 }
 
 void ASTVisitor::enumerateTypeDependencies(const TypeList &root_type_list) {
@@ -469,7 +480,7 @@ void ASTVisitor::finalize() {
   };
   // clang-format on
 
-  std::unordered_set<const clang::Type *> blacklisted_type_list;
+  TypeList blacklisted_type_list;
 
   for (const auto &p : d->type_dependency_tree) {
     const auto &type = p.first;
@@ -531,13 +542,80 @@ void ASTVisitor::finalize() {
     }
   }
 
-  // Find duplicated functions
-  std::unordered_map<std::string, std::vector<clang::FunctionDecl *>>
-      name_to_function_map;
+  // Filter the functions once for each name mangler; the type dependency
+  // tree and the blacklisted types do not depend on the mangling scheme
+  d->blacklisted_function_lists.clear();
+  d->whitelisted_function_lists.clear();
+
+  for (const auto &name_mangler : d->name_manglers) {
+    BlacklistedFunctionList blacklisted_function_list;
+    WhitelistedFunctionList whitelisted_function_list;
+    filterFunctions(blacklisted_function_list, whitelisted_function_list,
+                    name_mangler, blacklisted_type_list);
+
+    d->blacklisted_function_lists.push_back(
+        std::move(blacklisted_function_list));
+
+    d->whitelisted_function_lists.push_back(
+        std::move(whitelisted_function_list));
+  }
+}
+
+void ASTVisitor::filterFunctions(
+    BlacklistedFunctionList &blacklisted_function_list,
+    WhitelistedFunctionList &whitelisted_function_list,
+    clang::MangleContext *name_mangler, const TypeList &blacklisted_type_list) {
+  blacklisted_function_list.clear();
+  whitelisted_function_list.clear();
+
+  // Sort the functions by location and mangled name; the function map is keyed
+  // by pointer, and iterating it directly would make the output change from
+  // one run to another
+  struct SortedFunction final {
+    clang::FunctionDecl *function_decl{nullptr};
+    SourceCodeLocation location;
+    std::string mangled_name;
+  };
+
+  std::vector<SortedFunction> sorted_function_list;
+  sorted_function_list.reserve(d->function_map.size());
 
   for (const auto &p : d->function_map) {
     const auto &function_decl = p.first;
-    auto function_name = getMangledFunctionName(function_decl);
+
+    SortedFunction sorted_function = {};
+    sorted_function.function_decl = function_decl;
+    sorted_function.location = getSourceCodeLocation(
+        *d->ast_context, *d->source_manager, function_decl);
+    sorted_function.mangled_name =
+        getMangledFunctionName(function_decl, name_mangler);
+
+    sorted_function_list.push_back(std::move(sorted_function));
+  }
+
+  std::sort(sorted_function_list.begin(), sorted_function_list.end(),
+            [](const SortedFunction &lhs, const SortedFunction &rhs) -> bool {
+              if (isLocationLessThan(lhs.location, rhs.location)) {
+                return true;
+              }
+
+              if (isLocationLessThan(rhs.location, lhs.location)) {
+                return false;
+              }
+
+              return lhs.mangled_name < rhs.mangled_name;
+            });
+
+  // Find duplicated functions; the function map is shared across all the
+  // name manglers, so it is never modified here
+  std::unordered_set<clang::FunctionDecl *> duplicated_functions;
+
+  std::unordered_map<std::string, std::vector<clang::FunctionDecl *>>
+      name_to_function_map;
+
+  for (const auto &sorted_function : sorted_function_list) {
+    const auto &function_decl = sorted_function.function_decl;
+    const auto &function_name = sorted_function.mangled_name;
 
     auto it = name_to_function_map.find(function_name);
     if (it != name_to_function_map.end()) {
@@ -570,12 +648,12 @@ void ASTVisitor::finalize() {
 
     BlacklistedFunction::DuplicateFunctionLocations locations = {};
 
-    d->function_map.erase(first_function_decl);
+    duplicated_functions.insert(first_function_decl);
 
     for (auto func_decl_list_it = function_decl_list.begin() + 1;
          func_decl_list_it != function_decl_list.end(); func_decl_list_it++) {
       const auto &next_func_decl = *func_decl_list_it;
-      d->function_map.erase(next_func_decl);
+      duplicated_functions.insert(next_func_decl);
 
       auto next_func_location = getSourceCodeLocation(
           *d->ast_context, *d->source_manager, next_func_decl);
@@ -583,19 +661,28 @@ void ASTVisitor::finalize() {
     }
 
     func.reason_data = locations;
-    d->blacklisted_function_list.push_back(func);
+    blacklisted_function_list.push_back(func);
   }
 
   // Filter the remaining functions
-  for (const auto &p : d->function_map) {
-    const auto &function_decl = p.first;
-    const auto &type_dependencies = p.second;
+  for (const auto &sorted_function : sorted_function_list) {
+    const auto &function_decl = sorted_function.function_decl;
 
-    auto mangled_function_name = getMangledFunctionName(function_decl);
+    if (duplicated_functions.count(function_decl) != 0U) {
+      continue;
+    }
+
+    auto function_map_it = d->function_map.find(function_decl);
+    if (function_map_it == d->function_map.end()) {
+      continue;
+    }
+
+    const auto &type_dependencies = function_map_it->second;
+
+    const auto &mangled_function_name = sorted_function.mangled_name;
     auto friendly_function_name = getFriendlyFunctionName(function_decl);
 
-    auto function_location = getSourceCodeLocation(
-        *d->ast_context, *d->source_manager, function_decl);
+    const auto &function_location = sorted_function.location;
 
     // Search for bad types (function pointers)
     TypeList bad_type_list = {};
@@ -657,9 +744,24 @@ void ASTVisitor::finalize() {
         std::cerr << "Failed to determine the type locations.\n";
       }
 
+      std::sort(bad_type_locs.begin(), bad_type_locs.end(),
+                [](const std::pair<SourceCodeLocation, std::string> &lhs,
+                   const std::pair<SourceCodeLocation, std::string> &rhs)
+                    -> bool {
+                  if (isLocationLessThan(lhs.first, rhs.first)) {
+                    return true;
+                  }
+
+                  if (isLocationLessThan(rhs.first, lhs.first)) {
+                    return false;
+                  }
+
+                  return lhs.second < rhs.second;
+                });
+
       func.reason_data = bad_type_locs;
 
-      d->blacklisted_function_list.push_back(func);
+      blacklisted_function_list.push_back(func);
       continue;
     }
 
@@ -670,7 +772,7 @@ void ASTVisitor::finalize() {
       func.mangled_name = mangled_function_name;
       func.reason = BlacklistedFunction::Reason::Variadic;
 
-      d->blacklisted_function_list.push_back(func);
+      blacklisted_function_list.push_back(func);
       continue;
     }
 
@@ -681,7 +783,7 @@ void ASTVisitor::finalize() {
       func.mangled_name = mangled_function_name;
       func.reason = BlacklistedFunction::Reason::Templated;
 
-      d->blacklisted_function_list.push_back(func);
+      blacklisted_function_list.push_back(func);
       continue;
     }
 
@@ -690,14 +792,61 @@ void ASTVisitor::finalize() {
     func.friendly_name = friendly_function_name;
     func.mangled_name = mangled_function_name;
 
-    d->whitelisted_function_list.push_back(func);
+    whitelisted_function_list.push_back(func);
+  }
+
+  // The duplicated functions have been collected from an unordered map; sort
+  // the blacklist so that identical inputs always produce the same output
+  std::stable_sort(
+      blacklisted_function_list.begin(), blacklisted_function_list.end(),
+      [](const BlacklistedFunction &lhs, const BlacklistedFunction &rhs)
+          -> bool {
+        if (isLocationLessThan(lhs.location, rhs.location)) {
+          return true;
+        }
+
+        if (isLocationLessThan(rhs.location, lhs.location)) {
+          return false;
+        }
+
+        return lhs.mangled_name < rhs.mangled_name;
+      });
+}
+
+BlacklistedFunctionList ASTVisitor::blacklistedFunctions(
+    std::size_t name_mangler_index) const {
+  if (name_mangler_index >= d->blacklisted_function_lists.size()) {
+    return {};
   }
+
+  return d->blacklisted_function_lists.at(name_mangler_index);
 }
 
-BlacklistedFunctionList ASTVisitor::blacklistedFunctions() const {
-  return d->blacklisted_function_list;
+WhitelistedFunctionList ASTVisitor::whitelistedFunctions(
+    std::size_t name_mangler_index) const {
+  if (name_mangler_index >= d->whitelisted_function_lists.size()) {
+    return {};
+  }
+
+  return d->whitelisted_function_lists.at(name_mangler_index);
 }
 
-WhitelistedFunctionList ASTVisitor::whitelistedFunctions() const {
-  return d->whitelisted_function_list;
+std::map<std::string, std::size_t> ASTVisitor::containerSizes() const {
+  auto L_countFunctions = [](const auto &function_lists) -> std::size_t {
+    std::size_t count = 0U;
+    for (const auto &function_list : function_lists) {
+      count += function_list.size();
+    }
+
+    return count;
+  };
+
+  return {{"type dependency tree", d->type_dependency_tree.size()},
+          {"function map", d->function_map.size()},
+          {"enumerated types", d->enumerated_type_list.size()},
+          {"type information", d->type_info_map.size()},
+          {"blacklisted functions",
+           L_countFunctions(d->blacklisted_function_lists)},
+          {"whitelisted functions",
+           L_countFunctions(d->whitelisted_function_lists)}};
 }
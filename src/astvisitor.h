@@ -57,7 +57,8 @@ class ASTVisitor final : public IASTVisitor {
   void enumerateTypeDependencies(const clang::Type *root_type);
 
   /// Returns the mangled name for the given function
-  std::string getMangledFunctionName(clang::FunctionDecl *function_declaration);
+  std::string getMangledFunctionName(clang::FunctionDecl *function_declaration,
+                                     clang::MangleContext *name_mangler);
 
   /// Returns the friendly (i.e.: unmangled) function name
   std::string getFriendlyFunctionName(
@@ -68,6 +69,13 @@ class ASTVisitor final : public IASTVisitor {
                           SourceCodeLocation &type_location,
                           const clang::Type *type);
 
+  /// Splits the collected functions in the blacklisted and whitelisted
+  /// lists, using the given name mangler
+  void filterFunctions(BlacklistedFunctionList &blacklisted_function_list,
+                       WhitelistedFunctionList &whitelisted_function_list,
+                       clang::MangleContext *name_mangler,
+                       const TypeList &blacklisted_type_list);
+
  public:
   /// Status code, used with ASTVisitor::Status
   enum class StatusCode { MemoryAllocationFailure, Unknown };
@@ -84,7 +92,7 @@ class ASTVisitor final : public IASTVisitor {
   /// This method is called when entering a new translation unit
   virtual void initialize(clang::ASTContext *ast_context,
                           clang::SourceManager *source_manager,
-                          clang::MangleContext *name_mangler) override;
+                          const NameManglerList &name_manglers) override;
 
   /// This method is called each time a new function (or method) declaration is
   /// found
@@ -93,9 +101,14 @@ class ASTVisitor final : public IASTVisitor {
   /// Called after the last AST callback
   virtual void finalize() override;
 
-  /// Returns the blacklisted functions
-  virtual BlacklistedFunctionList blacklistedFunctions() const override;
+  /// Returns the blacklisted functions for the given name mangler
+  virtual BlacklistedFunctionList blacklistedFunctions(
+      std::size_t name_mangler_index) const override;
+
+  /// Returns the whitelisted functions for the given name mangler
+  virtual WhitelistedFunctionList whitelistedFunctions(
+      std::size_t name_mangler_index) const override;
 
-  /// Returns the whitelisted functions
-  virtual WhitelistedFunctionList whitelistedFunctions() const override;
+  /// Returns the number of entries in each of the internal containers
+  virtual std::map<std::string, std::size_t> containerSizes() const override;
 };
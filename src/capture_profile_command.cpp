@@ -0,0 +1,496 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cmdline.h"
+#include "generate_utils.h"
+#include "std_filesystem.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <set>
+#include <sstream>
+
+#include <json11.hpp>
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+namespace {
+/// The maximum folder depth, used to avoid symbolic link loops
+const int kMaxCopyDepth = 32;
+
+/// The include folders used by the host compiler for a single language
+struct HostLanguageSettings final {
+  /// The internal-isystem folders, in search order
+  StringList internal_isystem;
+
+  /// The internal-externc-isystem folders, in search order
+  StringList internal_externc_isystem;
+};
+
+/// Runs the given shell command, returning its output (stdout and stderr)
+bool executeCommand(std::string &output, const std::string &command) {
+  output.clear();
+
+  auto process = popen((command + " 2>&1").c_str(), "r");
+  if (process == nullptr) {
+    return false;
+  }
+
+  char buffer[4096];
+  while (true) {
+    auto size = std::fread(buffer, 1U, sizeof(buffer), process);
+    if (size == 0U) {
+      break;
+    }
+
+    output.append(buffer, size);
+  }
+
+  return pclose(process) == 0;
+}
+
+/// Quotes the given string so that it can be passed to the shell
+std::string quoteShellArgument(const std::string &argument) {
+  std::string output = "'";
+  for (auto c : argument) {
+    if (c == '\'') {
+      output += "'\\''";
+    } else {
+      output.push_back(c);
+    }
+  }
+
+  output += "'";
+  return output;
+}
+
+/// Returns true if the given include folder is one of the C library folders,
+/// which clang adds with -internal-externc-isystem (i.e.: /usr/include and
+/// the multiarch folder)
+bool isExternCIncludeFolder(const stdfs::path &folder) {
+  if (folder == "/usr/include" || folder == "/include") {
+    return true;
+  }
+
+  return folder.parent_path() == "/usr/include" &&
+         folder.filename().string().find("-linux-") != std::string::npos;
+}
+
+/// Acquires the include folders used by the host compiler, by parsing the
+/// output of `clang -E -v`
+bool getHostLanguageSettings(HostLanguageSettings &settings,
+                             const std::string &compiler, Language language) {
+  settings = {};
+
+  auto command = quoteShellArgument(compiler) + " -E -v -x " +
+                 (language == Language::CXX ? "c++" : "c") + " - < /dev/null";
+
+  std::string output;
+  if (!executeCommand(output, command)) {
+    std::cerr << "Failed to execute the following command: " << command
+              << "\n";
+    return false;
+  }
+
+  std::stringstream stream(output);
+  bool search_list = false;
+  bool search_list_found = false;
+
+  std::string line;
+  while (std::getline(stream, line)) {
+    if (line == "#include <...> search starts here:") {
+      search_list = true;
+      search_list_found = true;
+      continue;
+    }
+
+    if (line == "End of search list.") {
+      search_list = false;
+      continue;
+    }
+
+    if (!search_list || line.empty() || line.front() != ' ') {
+      continue;
+    }
+
+    auto folder = line.substr(line.find_first_not_of(' '));
+
+    auto framework_marker = folder.find(" (framework directory)");
+    if (framework_marker != std::string::npos) {
+      continue;
+    }
+
+    auto normalized_folder =
+        stdfs::path(folder).lexically_normal().generic_string();
+
+    if (normalized_folder.size() > 1U && normalized_folder.back() == '/') {
+      normalized_folder.pop_back();
+    }
+
+    if (isExternCIncludeFolder(normalized_folder)) {
+      settings.internal_externc_isystem.push_back(normalized_folder);
+    } else {
+      settings.internal_isystem.push_back(normalized_folder);
+    }
+  }
+
+  if (!search_list_found) {
+    std::cerr << "Failed to parse the include search list\n";
+    return false;
+  }
+
+  return true;
+}
+
+/// Returns the clang resource folder used by the host compiler
+bool getHostResourceDir(std::string &resource_dir, const std::string &compiler,
+                        const HostLanguageSettings &c_settings) {
+  resource_dir.clear();
+
+  std::string output;
+  if (executeCommand(output,
+                     quoteShellArgument(compiler) + " -print-resource-dir")) {
+    while (!output.empty() && std::isspace(static_cast<unsigned char>(
+                                  output.back()))) {
+      output.pop_back();
+    }
+
+    std::error_code error;
+    if (!output.empty() && stdfs::is_directory(output, error)) {
+      resource_dir = stdfs::path(output).lexically_normal().generic_string();
+      return true;
+    }
+  }
+
+  // Older versions do not support -print-resource-dir; look for the
+  // <resource dir>/include folder in the search list instead
+  for (const auto &folder : c_settings.internal_isystem) {
+    stdfs::path path(folder);
+    if (path.filename() == "include" &&
+        path.parent_path().parent_path().filename() == "clang") {
+      resource_dir = path.parent_path().generic_string();
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/// Returns the target triple used by the host compiler
+bool getHostTargetTriple(std::string &target_triple,
+                         const std::string &compiler) {
+  target_triple.clear();
+
+  std::string output;
+  if (!executeCommand(output, quoteShellArgument(compiler) + " -dumpmachine")) {
+    return false;
+  }
+
+  while (!output.empty() &&
+         std::isspace(static_cast<unsigned char>(output.back()))) {
+    output.pop_back();
+  }
+
+  if (output.empty() || output.find('\n') != std::string::npos) {
+    return false;
+  }
+
+  target_triple = output;
+  return true;
+}
+
+/// Converts an absolute host path to a path relative to the profile root
+std::string getProfileRelativePath(const std::string &host_path) {
+  return stdfs::path(host_path)
+      .lexically_normal()
+      .relative_path()
+      .generic_string();
+}
+
+/// Copies the given host file inside the profile
+bool copyHostFile(const stdfs::path &host_path,
+                  const stdfs::path &profile_root) {
+  auto destination_path =
+      profile_root / getProfileRelativePath(host_path.string());
+
+  std::error_code error;
+  stdfs::create_directories(destination_path.parent_path(), error);
+
+  // Symbolic links are resolved, since they could point outside of the
+  // profile folder
+  stdfs::copy_file(host_path, destination_path,
+                   stdfs::copy_options::overwrite_existing, error);
+
+  if (error) {
+    std::cerr << "Failed to copy the following file: " << host_path << "\n";
+    return false;
+  }
+
+  return true;
+}
+
+/// Copies the given host folder inside the profile
+bool copyHostFolder(const stdfs::path &host_folder,
+                    const stdfs::path &profile_root) {
+  std::error_code error;
+  if (!stdfs::is_directory(host_folder, error)) {
+    return true;
+  }
+
+  try {
+    stdfs::recursive_directory_iterator it(
+        host_folder, stdfs::directory_options::follow_directory_symlink);
+
+    for (; it != stdfs::recursive_directory_iterator(); ++it) {
+      if (it.depth() >= kMaxCopyDepth) {
+        it.disable_recursion_pending();
+      }
+
+      if (!stdfs::is_regular_file(it->path(), error)) {
+        continue;
+      }
+
+      if (!copyHostFile(it->path(), profile_root)) {
+        return false;
+      }
+    }
+
+  } catch (...) {
+    std::cerr << "Failed to enumerate the following folder: " << host_folder
+              << "\n";
+    return false;
+  }
+
+  return true;
+}
+
+/// Collects the host headers reachable from the seed headers; the include
+/// graph only contains the directives that have been processed, so the
+/// result depends on the language and the predefined macros
+bool getReachableHostHeaders(std::set<std::string> &reachable_headers,
+                             const Profile &host_profile, Language language,
+                             int language_standard,
+                             const StringList &seed_headers) {
+  CompilerInstanceSettings settings;
+  settings.profile = host_profile;
+  settings.language = language;
+  settings.language_standard = language_standard;
+  settings.enable_gnu_extensions = true;
+
+  CompilerInstanceRef compiler;
+  auto status = CompilerInstance::create(compiler, settings);
+  if (!status.succeeded()) {
+    std::cerr << status.toString() << "\n";
+    return false;
+  }
+
+  IncludeGraph include_graph;
+  status = compiler->processAST(generateSourceBuffer(seed_headers, {}),
+                                IASTVisitorRef(), &include_graph);
+
+  // Seeds that only work with one of the languages are expected to fail
+  if (!status.succeeded()) {
+    std::cerr << "Warning: the seed headers could not be parsed as "
+              << language << "; the pruned profile may be incomplete\n";
+  }
+
+  for (const auto &directive : include_graph.main_file_includes) {
+    if (!directive.path.empty()) {
+      reachable_headers.insert(directive.path);
+    }
+  }
+
+  for (const auto &p : include_graph.inclusion_paths) {
+    reachable_headers.insert(p.second);
+  }
+
+  return true;
+}
+
+/// Writes the profile.json file
+bool writeProfileSettings(const std::string &path, const std::string &name,
+                          const std::string &resource_dir,
+                          const std::string &target_triple,
+                          const HostLanguageSettings &c_settings,
+                          const HostLanguageSettings &cpp_settings) {
+  auto L_getPathList = [](const StringList &folder_list) -> json11::Json {
+    json11::Json::array path_list;
+    for (const auto &folder : folder_list) {
+      path_list.push_back(getProfileRelativePath(folder));
+    }
+
+    return path_list;
+  };
+
+  auto L_getLanguageSection =
+      [&L_getPathList](const HostLanguageSettings &settings) -> json11::Json {
+    return json11::Json::object{
+        {"internal-isystem", L_getPathList(settings.internal_isystem)},
+        {"internal-externc-isystem",
+         L_getPathList(settings.internal_externc_isystem)}};
+  };
+
+  json11::Json profile = json11::Json::object{
+      {"name", name},
+      {"resource-dir", getProfileRelativePath(resource_dir)},
+      {"target-triple", target_triple},
+      {"c", L_getLanguageSection(c_settings)},
+      {"c++", L_getLanguageSection(cpp_settings)}};
+
+  std::ofstream profile_file(path);
+  profile_file << profile.dump() << "\n";
+
+  return static_cast<bool>(profile_file);
+}
+}  // namespace
+
+/// Handler for the 'capture_profile' command
+bool captureProfileCommandHandler(ProfileManagerRef &profile_manager,
+                                  const LanguageManager &language_manager,
+                                  const CommandLineOptions &cmdline_options) {
+  static_cast<void>(language_manager);
+
+  const auto &compiler = cmdline_options.host_compiler;
+
+  HostLanguageSettings c_settings;
+  HostLanguageSettings cpp_settings;
+  if (!getHostLanguageSettings(c_settings, compiler, Language::C) ||
+      !getHostLanguageSettings(cpp_settings, compiler, Language::CXX)) {
+    return false;
+  }
+
+  std::string resource_dir;
+  if (!getHostResourceDir(resource_dir, compiler, c_settings)) {
+    std::cerr << "Failed to locate the clang resource folder\n";
+    return false;
+  }
+
+  std::string target_triple;
+  if (!getHostTargetTriple(target_triple, compiler)) {
+    std::cerr << "Failed to acquire the target triple of the host compiler\n";
+    return false;
+  }
+
+  // All the include folders, without duplicates
+  StringList folder_list;
+  for (const auto &settings : {c_settings, cpp_settings}) {
+    for (const auto &list :
+         {settings.internal_isystem, settings.internal_externc_isystem}) {
+      for (const auto &folder : list) {
+        if (std::find(folder_list.begin(), folder_list.end(), folder) ==
+            folder_list.end()) {
+          folder_list.push_back(folder);
+        }
+      }
+    }
+  }
+
+  stdfs::path profile_root(cmdline_options.output);
+
+  std::error_code error;
+  stdfs::create_directories(profile_root, error);
+  if (error) {
+    std::cerr << "Failed to create the profile folder: " << profile_root
+              << "\n";
+    return false;
+  }
+
+  if (cmdline_options.seed_headers.empty()) {
+    for (const auto &folder : folder_list) {
+      std::cerr << "Copying " << folder << "\n";
+      if (!copyHostFolder(folder, profile_root)) {
+        return false;
+      }
+    }
+
+  } else {
+    // Only keep the headers that can be reached from the seed headers, using
+    // the host folders as they are
+    Profile host_profile;
+    host_profile.name = cmdline_options.profile_name;
+    host_profile.root_path = "/";
+    host_profile.resource_dir = resource_dir;
+    host_profile.target_triple = target_triple;
+
+    host_profile.internal_isystem.insert(
+        {Language::C, c_settings.internal_isystem});
+    host_profile.internal_externc_isystem.insert(
+        {Language::C, c_settings.internal_externc_isystem});
+
+    host_profile.internal_isystem.insert(
+        {Language::CXX, cpp_settings.internal_isystem});
+    host_profile.internal_externc_isystem.insert(
+        {Language::CXX, cpp_settings.internal_externc_isystem});
+
+    std::set<std::string> reachable_headers;
+    if (!getReachableHostHeaders(reachable_headers, host_profile, Language::C,
+                                 11, cmdline_options.seed_headers) ||
+        !getReachableHostHeaders(reachable_headers, host_profile,
+                                 Language::CXX, 14,
+                                 cmdline_options.seed_headers)) {
+      return false;
+    }
+
+    std::cerr << "Copying " << reachable_headers.size()
+              << " reachable headers\n";
+
+    for (const auto &header : reachable_headers) {
+      if (!copyHostFile(header, profile_root)) {
+        return false;
+      }
+    }
+
+    // Make sure that all the include folders exist, even if empty
+    for (const auto &folder : folder_list) {
+      stdfs::create_directories(profile_root / getProfileRelativePath(folder),
+                                error);
+    }
+  }
+
+  auto profile_path = (profile_root / "profile.json").string();
+  if (!writeProfileSettings(profile_path, cmdline_options.profile_name,
+                            resource_dir, target_triple, c_settings,
+                            cpp_settings)) {
+    std::cerr << "Failed to write the profile settings: " << profile_path
+              << "\n";
+    return false;
+  }
+
+  // Profiles captured inside the profiles root folder are made available to
+  // the other commands right away
+  auto relative_profile_root =
+      stdfs::absolute(profile_root, error)
+          .lexically_relative(stdfs::absolute(profile_manager->profilesRoot(),
+                                              error));
+
+  if (!relative_profile_root.empty() &&
+      *relative_profile_root.begin() != "..") {
+    auto status = profile_manager->registerProfile(profile_path);
+    if (!status.succeeded()) {
+      std::cerr << status.message() << "\n";
+      return false;
+    }
+
+    std::cerr << "The profile has been added to the profile index\n";
+  }
+
+  return true;
+}
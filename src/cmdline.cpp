@@ -40,13 +40,14 @@ void initializeCommandLineParser(CLI::App &cmdline_parser,
       cmdline_parser.add_subcommand("generate", "Generate an ABI library");
 
   // The profile determines the options and include folders we will use when
-  // parsing the include headers
+  // parsing the include headers; when more than one is selected, the headers
+  // are enumerated once and the profiles are processed concurrently
   auto profile_option =
-      generate_cmd->add_option("-p,--profile", cmdline_options.profile_name,
+      generate_cmd->add_option("-p,--profile", cmdline_options.profile_names,
                                "Profile name; use the list_profiles command to "
-                               "list the available options");
-
-  profile_option->required(true)->take_last();
+                               "list the available options. Can be repeated, "
+                               "in which case each ABI library is saved in a "
+                               "folder named after its profile");
 
   // clang-format off
   profile_option->check(
@@ -68,7 +69,7 @@ void initializeCommandLineParser(CLI::App &cmdline_parser,
                                "Language name; use the list_languages command "
                                "to list the available options");
 
-  language_option->required(true)->take_last();
+  language_option->take_last();
 
   // clang-format off
   language_option->check(
@@ -95,15 +96,32 @@ void initializeCommandLineParser(CLI::App &cmdline_parser,
                  "Use Visual C++ name mangling")
       ->take_last();
 
+  // The name mangling schemes can be combined; the headers are only parsed
+  // once, and one ABI library is written for each scheme
+  auto name_mangling_option = generate_cmd->add_option(
+      "-m,--name-mangling", cmdline_options.name_mangling_schemes,
+      "Name mangling schemes (itanium, microsoft); when more than one is "
+      "specified, the scheme name is appended to the output file name");
+
+  // clang-format off
+  name_mangling_option->check(
+      [](const std::string &scheme_name) -> std::string {
+        if (scheme_name != "itanium" && scheme_name != "microsoft") {
+          return "Invalid name mangling scheme";
+        }
+
+        return "";
+      }
+  );
+  // clang-format on
+
   generate_cmd->add_option("-i,--include-search-paths",
                            cmdline_options.additional_include_folders,
                            "Additional include folders");
 
   // The folder to scan for include files
-  generate_cmd
-      ->add_option("-f,--header-folders", cmdline_options.header_folders,
-                   "Header folders")
-      ->required();
+  generate_cmd->add_option("-f,--header-folders",
+                           cmdline_options.header_folders, "Header folders");
 
   // Include files that will always be added inside the ABI library
   generate_cmd->add_option(
@@ -111,10 +129,76 @@ void initializeCommandLineParser(CLI::App &cmdline_parser,
       "Includes that should always be present in the ABI header");
 
   // Where the output should be saved
+  generate_cmd->add_option(
+      "-o,--output", cmdline_options.output,
+      "Output path, including the file name without the extension");
+
+  // The header folders, the output and the language are required unless
+  // the jobs are read from a manifest; this is validated by the handler
+  generate_cmd->add_option(
+      "--manifest", cmdline_options.manifest_path,
+      "JSON file listing several jobs to run in a single process; each job "
+      "can override the header folders, base includes, language, output and "
+      "profiles given on the command line");
+
   generate_cmd
-      ->add_option("-o,--output", cmdline_options.output,
-                   "Output path, including the file name without the extension")
-      ->required();
+      ->add_flag("--no-pch", cmdline_options.disable_precompiled_header,
+                 "Do not precompile the base includes")
+      ->take_last();
+
+  generate_cmd
+      ->add_flag("--use-header-maps", cmdline_options.use_header_maps,
+                 "Use header maps for the profile include folders; header "
+                 "maps are looked up without regard to case, so only enable "
+                 "them when the includes match the file names exactly")
+      ->take_last();
+
+  generate_cmd
+      ->add_flag("--use-modules", cmdline_options.use_modules,
+                 "Generate a module map for the header folders and the "
+                 "profile headers, so that each header is built once as a "
+                 "clang module and imported from the module cache")
+      ->take_last();
+
+  generate_cmd
+      ->add_flag("--no-conflict-prediction",
+                 cmdline_options.disable_conflict_prediction,
+                 "Do not defer the headers that a quick scan shows to "
+                 "redefine a name provided by an included header")
+      ->take_last();
+
+  generate_cmd
+      ->add_flag("--all-profiles", cmdline_options.all_profiles,
+                 "Generate one ABI library for each available profile")
+      ->take_last();
+
+  generate_cmd
+      ->add_flag("--stats", cmdline_options.print_statistics,
+                 "Print the time spent in each phase and the clang "
+                 "invocation counters")
+      ->take_last();
+
+  generate_cmd->add_option(
+      "--trace-file", cmdline_options.trace_file,
+      "Save the phase timings and counters to this file, using the Chrome "
+      "trace event format");
+
+  generate_cmd
+      ->add_flag("--header-report", cmdline_options.save_header_report,
+                 "Save the probe count, parse time, failures and transitive "
+                 "size of each header to <output>.header_report.txt and "
+                 "<output>.header_report.json")
+      ->take_last();
+
+  generate_cmd->add_option(
+      "--memory-limit", cmdline_options.memory_limit,
+      "AST size, in megabytes, above which the headers are analyzed in "
+      "smaller shards instead of a single translation unit");
+
+  generate_cmd->add_option("-j,--jobs", cmdline_options.job_count,
+                           "How many ABI libraries can be generated "
+                           "concurrently; defaults to the number of hardware "
+                           "threads");
 
   command_map.insert({generate_cmd, generateCommandHandler});
 
@@ -175,10 +259,13 @@ void initializeCommandLineParser(CLI::App &cmdline_parser,
                  cmdline_options.enable_gnu_extensions, "Enable GNU extensions")
       ->take_last();
 
+  // Only the generate command mangles names; the flag is still accepted here
+  // so that existing compile invocations keep working
   compile_cmd
       ->add_flag("-z,--use-visual-cxx-mangling",
                  cmdline_options.use_visual_cxx_mangling,
-                 "Use Visual C++ name mangling")
+                 "Ignored; kept for compatibility, since the compile command "
+                 "does not mangle names")
       ->take_last();
 
   compile_cmd->add_option("-i,--include-search-paths",
@@ -198,12 +285,226 @@ void initializeCommandLineParser(CLI::App &cmdline_parser,
 
   // Where the output should be saved
   compile_cmd
-      ->add_option("-o,--output", cmdline_options.output,
-                   "Output path, including the file name without the extension")
+      ->add_option("-o,--output", cmdline_options.output, "Output file path")
       ->required();
 
+  auto output_format_option = compile_cmd->add_option(
+      "-t,--output-format", cmdline_options.output_format,
+      "Output format: bitcode (default), ir or object");
+
+  output_format_option->take_last();
+
+  // clang-format off
+  output_format_option->check(
+      [](const std::string &format_name) -> std::string {
+        if (format_name != "bitcode" && format_name != "ir" &&
+            format_name != "object") {
+          return "Invalid output format";
+        }
+
+        return "";
+      }
+  );
+  // clang-format on
+
+  compile_cmd
+      ->add_flag("-s,--emit-module-summary",
+                 cmdline_options.emit_module_summary,
+                 "Embed a ThinLTO module summary index in the bitcode")
+      ->take_last();
+
   command_map.insert({compile_cmd, compileCommandHandler});
 
+  //
+  // Initialize the 'pack_profile' command
+  //
+
+  auto pack_profile_cmd = cmdline_parser.add_subcommand(
+      "pack_profile", "Packs the profile headers into a single archive");
+
+  profile_option = pack_profile_cmd->add_option(
+      "-p,--profile", cmdline_options.profile_name,
+      "Profile name; use the list_profiles command to list the available "
+      "options");
+
+  profile_option->required(true)->take_last();
+
+  // clang-format off
+  profile_option->check(
+      [&profile_manager](const std::string &profile_name) -> std::string {
+        Profile profile;
+        auto status = profile_manager->get(profile, profile_name);
+        if (!status.succeeded()) {
+          return status.message();
+        }
+
+        return "";
+      }
+  );
+  // clang-format on
+
+  pack_profile_cmd
+      ->add_flag("-c,--compress", cmdline_options.compress_profile_archive,
+                 "Compress the profile headers")
+      ->take_last();
+
+  // Where the output should be saved
+  pack_profile_cmd->add_option(
+      "-o,--output", cmdline_options.output,
+      "Output path; defaults to profile.pack inside the profile folder, "
+      "which is automatically used by the other commands");
+
+  command_map.insert({pack_profile_cmd, packProfileCommandHandler});
+
+  //
+  // Initialize the 'store_profile' command
+  //
+
+  auto store_profile_cmd = cmdline_parser.add_subcommand(
+      "store_profile",
+      "Adds the profile headers to the header store shared by all the "
+      "profiles");
+
+  profile_option = store_profile_cmd->add_option(
+      "-p,--profile", cmdline_options.profile_name,
+      "Profile name; use the list_profiles command to list the available "
+      "options");
+
+  profile_option->required(true)->take_last();
+
+  // clang-format off
+  profile_option->check(
+      [&profile_manager](const std::string &profile_name) -> std::string {
+        Profile profile;
+        auto status = profile_manager->get(profile, profile_name);
+        if (!status.succeeded()) {
+          return status.message();
+        }
+
+        return "";
+      }
+  );
+  // clang-format on
+
+  store_profile_cmd
+      ->add_flag("-r,--remove-headers", cmdline_options.remove_stored_headers,
+                 "Remove the profile headers once they have been stored")
+      ->take_last();
+
+  command_map.insert({store_profile_cmd, storeProfileCommandHandler});
+
+  //
+  // Initialize the 'prepare_profile' command
+  //
+
+  auto prepare_profile_cmd = cmdline_parser.add_subcommand(
+      "prepare_profile",
+      "Precompiles the base includes used by the generate command");
+
+  profile_option = prepare_profile_cmd->add_option(
+      "-p,--profile", cmdline_options.profile_name,
+      "Profile name; use the list_profiles command to list the available "
+      "options");
+
+  profile_option->required(true)->take_last();
+
+  // clang-format off
+  profile_option->check(
+      [&profile_manager](const std::string &profile_name) -> std::string {
+        Profile profile;
+        auto status = profile_manager->get(profile, profile_name);
+        if (!status.succeeded()) {
+          return status.message();
+        }
+
+        return "";
+      }
+  );
+  // clang-format on
+
+  language_option = prepare_profile_cmd->add_option(
+      "-l,--language", cmdline_options.language,
+      "Language name; use the list_languages command to list the available "
+      "options");
+
+  language_option->required(true)->take_last();
+
+  // clang-format off
+  language_option->check(
+      [&language_manager](const std::string &definition) -> std::string {
+        Language language;
+        int standard;
+        if (!language_manager.parseLanguageDefinition(language, standard, definition)) {
+          return "Invalid language";
+        }
+
+        return "";
+      }
+  );
+  // clang-format on
+
+  prepare_profile_cmd
+      ->add_flag("-x,--enable-gnu-extensions",
+                 cmdline_options.enable_gnu_extensions, "Enable GNU extensions")
+      ->take_last();
+
+  // The header folders are part of the include search path, and must match
+  // the ones passed to the generate command
+  prepare_profile_cmd->add_option(
+      "-f,--header-folders", cmdline_options.header_folders, "Header folders");
+
+  prepare_profile_cmd
+      ->add_option("-b,--base-includes", cmdline_options.base_includes,
+                   "The includes to precompile")
+      ->required();
+
+  command_map.insert({prepare_profile_cmd, prepareProfileCommandHandler});
+
+  //
+  // Initialize the 'capture_profile' command
+  //
+
+  auto capture_profile_cmd = cmdline_parser.add_subcommand(
+      "capture_profile",
+      "Creates a new profile from the headers of the host compiler");
+
+  capture_profile_cmd
+      ->add_option("-n,--name", cmdline_options.profile_name, "Profile name")
+      ->required();
+
+  capture_profile_cmd
+      ->add_option("-o,--output", cmdline_options.output,
+                   "Profile folder; profiles created inside the data folder "
+                   "are automatically added to the profile index")
+      ->required();
+
+  capture_profile_cmd->add_option(
+      "-c,--compiler", cmdline_options.host_compiler,
+      "The clang executable used to locate the host include folders");
+
+  capture_profile_cmd->add_option(
+      "-s,--seed-headers", cmdline_options.seed_headers,
+      "Only copy the headers that can be reached from these ones");
+
+  command_map.insert({capture_profile_cmd, captureProfileCommandHandler});
+
+  //
+  // Initialize the 'serve' command
+  //
+
+  auto serve_cmd = cmdline_parser.add_subcommand(
+      "serve",
+      "Runs a resident server that keeps the profiles and the parser caches "
+      "in memory; use --connect <socket> as the first argument to send a "
+      "command to it");
+
+  serve_cmd
+      ->add_option("-s,--socket", cmdline_options.socket_path,
+                   "The UNIX socket the server listens on")
+      ->required();
+
+  command_map.insert({serve_cmd, serveCommandHandler});
+
   //
   // Initialize the 'list_profiles' command
   //
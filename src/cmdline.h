@@ -28,9 +28,40 @@ struct CommandLineOptions final {
   /// The profile to use when generating the ABI library
   std::string profile_name;
 
+  /// The profiles selected for the 'generate' command; one ABI library is
+  /// generated for each of them
+  std::vector<std::string> profile_names;
+
+  /// If true, the 'generate' command will use every available profile
+  bool all_profiles{false};
+
+  /// How many jobs can be run concurrently; zero means one for each
+  /// hardware thread
+  std::size_t job_count{0U};
+
   /// The language used to parse the include headers
   std::string language;
 
+  /// When not empty, the 'generate' command runs the jobs listed in this
+  /// JSON file
+  std::string manifest_path;
+
+  /// If true, the 'generate' command prints the time spent in each phase,
+  /// along with the clang invocation counters
+  bool print_statistics{false};
+
+  /// When not empty, the 'generate' command saves a Chrome trace event file
+  /// at this path
+  std::string trace_file;
+
+  /// The AST size (in megabytes) above which the 'generate' command stops the
+  /// parse and switches to the sharded analysis; zero means no limit
+  std::size_t memory_limit{0U};
+
+  /// If true, the 'generate' command saves the parse cost of each header
+  /// next to the ABI library, both as text and as JSON
+  bool save_header_report{false};
+
   /// If true, gnu extensions will be enabled when parsing the include files
   bool enable_gnu_extensions{false};
 
@@ -54,8 +85,54 @@ struct CommandLineOptions final {
   std::vector<std::string> additional_include_folders;
 
   /// If true, name mangling will follow the Microsoft Visual C++ convention
-  /// instead of the standard one
+  /// instead of the standard one; the compile command accepts it, but
+  /// ignores it
   bool use_visual_cxx_mangling{false};
+
+  /// The name mangling schemes to use (itanium, microsoft); when more than
+  /// one is given, one ABI library is generated for each of them
+  std::vector<std::string> name_mangling_schemes;
+
+  /// The output format used by the compile command (bitcode, ir, object)
+  std::string output_format{"bitcode"};
+
+  /// If true, the files inside the profile archive will be compressed
+  bool compress_profile_archive{false};
+
+  /// The compiler used by the 'capture_profile' command to locate the host
+  /// include folders
+  std::string host_compiler{"clang"};
+
+  /// When not empty, the captured profile will only contain the headers
+  /// that can be reached from these ones
+  std::vector<std::string> seed_headers;
+
+  /// If true, the base includes will not be precompiled
+  bool disable_precompiled_header{false};
+
+  /// If true, header maps are used to speed up the header search; they are
+  /// opt-in because clang looks them up without regard to case, which would
+  /// accept includes that fail on a case-sensitive file system
+  bool use_header_maps{false};
+
+  /// If true, the headers are parsed as clang modules, which are cached on
+  /// disk and reused across runs
+  bool use_modules{false};
+
+  /// If true, the headers are probed without first predicting the
+  /// conflicting definitions from their declaration index
+  bool disable_conflict_prediction{false};
+
+  /// If true, the profile headers will be deleted once they have been added
+  /// to the header store
+  bool remove_stored_headers{false};
+
+  /// The UNIX socket used by the 'serve' command
+  std::string socket_path;
+
+  /// If true, the compiled ABI library will also contain a module summary
+  /// index, allowing ThinLTO-style linking to only import what is used
+  bool emit_module_summary{false};
 };
 
 /// Command handler
@@ -81,6 +158,37 @@ bool compileCommandHandler(ProfileManagerRef &profile_manager,
                            const LanguageManager &language_manager,
                            const CommandLineOptions &cmdline_options);
 
+/// Handler for the 'pack_profile' command
+bool packProfileCommandHandler(ProfileManagerRef &profile_manager,
+                               const LanguageManager &language_manager,
+                               const CommandLineOptions &cmdline_options);
+
+/// Handler for the 'store_profile' command
+bool storeProfileCommandHandler(ProfileManagerRef &profile_manager,
+                                const LanguageManager &language_manager,
+                                const CommandLineOptions &cmdline_options);
+
+/// Handler for the 'prepare_profile' command
+bool prepareProfileCommandHandler(ProfileManagerRef &profile_manager,
+                                  const LanguageManager &language_manager,
+                                  const CommandLineOptions &cmdline_options);
+
+/// Handler for the 'capture_profile' command
+bool captureProfileCommandHandler(ProfileManagerRef &profile_manager,
+                                  const LanguageManager &language_manager,
+                                  const CommandLineOptions &cmdline_options);
+
+/// Handler for the 'serve' command
+bool serveCommandHandler(ProfileManagerRef &profile_manager,
+                         const LanguageManager &language_manager,
+                         const CommandLineOptions &cmdline_options);
+
+/// Sends the given command line (without the executable name) to the abigen
+/// server listening on the given UNIX socket, printing the command output;
+/// exit_code receives the exit code of the command
+bool sendServerRequest(int &exit_code, const std::string &socket_path,
+                       const StringList &arguments);
+
 /// Handler for the 'list_profiles' command
 bool listProfilesCommandHandler(ProfileManagerRef &profile_manager,
                                 const LanguageManager &language_manager,
@@ -14,8 +14,11 @@
  * limitations under the License.
  */
 
+#include <llvm/Analysis/ModuleSummaryAnalysis.h>
+#include <llvm/Analysis/ProfileSummaryInfo.h>
 #include <llvm/Bitcode/BitcodeWriter.h>
 #include <llvm/IR/Module.h>
+#include <llvm/IR/ModuleSummaryIndex.h>
 
 #include <clang/AST/Mangle.h>
 #include <clang/AST/RecursiveASTVisitor.h>
@@ -27,8 +30,10 @@
 #include <clang/Lex/PreprocessorOptions.h>
 #include <clang/Parse/ParseAST.h>
 
+#include "fileutils.h"
 #include "generate_command.h"
 #include "generate_utils.h"
+#include "std_filesystem.h"
 
 /// Handler for the 'compile' command
 bool compileCommandHandler(ProfileManagerRef &profile_manager,
@@ -38,8 +43,6 @@ bool compileCommandHandler(ProfileManagerRef &profile_manager,
   clang_settings.additional_include_folders =
       cmdline_options.additional_include_folders;
   clang_settings.enable_gnu_extensions = cmdline_options.enable_gnu_extensions;
-  clang_settings.use_visual_cxx_mangling =
-      cmdline_options.use_visual_cxx_mangling;
 
   auto prof_mgr_status = profile_manager->get(clang_settings.profile,
                                               cmdline_options.profile_name);
@@ -74,7 +77,7 @@ bool compileCommandHandler(ProfileManagerRef &profile_manager,
   // Replicate the invocation here to make this work
   std::vector<std::string> clang_arguments = {
       "-triple",
-      "x86_64-pc-linux-gnu",
+      getProfileTargetTriple(clang_settings.profile),
       "-nostdsysteminc",
       "-nobuiltininc",
       "-resource-dir",
@@ -104,10 +107,65 @@ bool compileCommandHandler(ProfileManagerRef &profile_manager,
     }
   }
 
-  clang_arguments.push_back("-S");
-  clang_arguments.push_back("-emit-llvm");
+  CompileOutputFormat output_format;
+  if (!parseCompileOutputFormat(output_format, cmdline_options.output_format)) {
+    std::cerr << "Invalid output format: " << cmdline_options.output_format
+              << "\n";
+    return false;
+  }
+
+  // The summary index is only stored inside bitcode files
+  if (cmdline_options.emit_module_summary &&
+      output_format != CompileOutputFormat::Bitcode) {
+    std::cerr << "The module summary can only be emitted with the bitcode "
+                 "output format\n";
+    return false;
+  }
+
+  // The generated implementation file always has the .cpp extension, even
+  // when it contains C code
+  clang_arguments.push_back("-x");
+  clang_arguments.push_back(clang_settings.language == Language::CXX ? "c++"
+                                                                     : "c");
+
   clang_arguments.push_back(cmdline_options.abi_library_source_file);
 
+  // The output is written to a temporary file next to the destination, and
+  // only renamed over it once the compilation succeeds; a failed run never
+  // leaves a truncated file behind. Creating it now also reports a bad
+  // output path without wasting time on the code generation
+  std::string temporary_path;
+  if (!createTemporaryFile(temporary_path, cmdline_options.output)) {
+    std::cerr << "Failed to create the output file " << cmdline_options.output
+              << "\n";
+    return false;
+  }
+
+  auto L_discardOutput = [&temporary_path]() -> void {
+    std::error_code error;
+    stdfs::remove(temporary_path, error);
+  };
+
+  auto L_saveOutput = [&temporary_path, &cmdline_options]() -> bool {
+    std::error_code error;
+    stdfs::rename(temporary_path, cmdline_options.output, error);
+    if (!error) {
+      return true;
+    }
+
+    std::cerr << "Failed to save the output to file " << cmdline_options.output
+              << ": " << error.message() << "\n";
+
+    stdfs::remove(temporary_path, error);
+    return false;
+  };
+
+  if (output_format == CompileOutputFormat::Object) {
+    clang_arguments.push_back("-emit-obj");
+    clang_arguments.push_back("-o");
+    clang_arguments.push_back(temporary_path);
+  }
+
   std::string language_flag = "-std=";
   switch (clang_settings.language) {
     case Language::C: {
@@ -140,24 +198,80 @@ bool compileCommandHandler(ProfileManagerRef &profile_manager,
       &invocation[0] + invocation.size(), compiler->getDiagnostics());
   compiler->setInvocation(compiler_invocation);
 
+  // Object files are written directly by the code generator
+  if (output_format == CompileOutputFormat::Object) {
+    clang::EmitObjAction compiler_action;
+    if (!compiler->ExecuteAction(compiler_action)) {
+      std::cerr << "Error: " << clang_output_buffer << "\n";
+
+      L_discardOutput();
+      return false;
+    }
+
+    return L_saveOutput();
+  }
+
+  std::error_code stream_error_code;
+  llvm::raw_fd_ostream output_stream(
+      temporary_path, stream_error_code,
+      output_format == CompileOutputFormat::TextualIR ? llvm::sys::fs::F_Text
+                                                      : llvm::sys::fs::F_None);
+
+  if (stream_error_code) {
+    std::cerr << "Failed to open the output file " << cmdline_options.output
+              << ": " << stream_error_code.message() << "\n";
+
+    L_discardOutput();
+    return false;
+  }
+
   clang::EmitLLVMOnlyAction compiler_action;
   if (!compiler->ExecuteAction(compiler_action)) {
     std::cerr << "Error: " << clang_output_buffer << "\n";
-    return 1;
-  }
 
-  std::error_code stream_error_code;
-  llvm::raw_fd_ostream output_stream(cmdline_options.output, stream_error_code,
-                                     llvm::sys::fs::F_None);
+    output_stream.close();
+    L_discardOutput();
+    return false;
+  }
 
   auto module = compiler_action.takeModule();
-  llvm::WriteBitcodeToFile(*module.get(), output_stream);
+  if (!module) {
+    std::cerr << "Failed to generate the LLVM module\n";
 
-  output_stream.flush();
-  if (stream_error_code) {
-    std::cerr << "Failed to save the output to file\n";
+    output_stream.close();
+    L_discardOutput();
+    return false;
+  }
+
+  if (output_format == CompileOutputFormat::TextualIR) {
+    module->print(output_stream, nullptr);
+
+  } else if (cmdline_options.emit_module_summary) {
+    // Attach the summary index (and the module hash) so that the linker can
+    // import only the declarations that are actually referenced; function
+    // bodies remain lazily loadable through the function-level symbol table
+    llvm::ProfileSummaryInfo profile_summary_info(*module.get());
+
+    auto summary_index = llvm::buildModuleSummaryIndex(
+        *module.get(), nullptr, &profile_summary_info);
+
+    llvm::WriteBitcodeToFile(*module.get(), output_stream, false,
+                             &summary_index, true);
+  } else {
+    llvm::WriteBitcodeToFile(*module.get(), output_stream);
+  }
+
+  output_stream.close();
+  if (output_stream.has_error()) {
+    std::cerr << "Failed to save the output to file "
+              << cmdline_options.output << ": "
+              << output_stream.error().message() << "\n";
+
+    output_stream.clear_error();
+
+    L_discardOutput();
     return false;
   }
 
-  return true;
+  return L_saveOutput();
 }
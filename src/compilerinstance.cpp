@@ -16,12 +16,15 @@
 
 #include "compilerinstance.h"
 #include "generate_utils.h"
+#include "profilefilesystem.h"
 #include "std_filesystem.h"
+#include "tracing.h"
 
 #include <iostream>
 
 #include <clang/AST/Mangle.h>
 #include <clang/AST/RecursiveASTVisitor.h>
+#include <clang/Basic/FileManager.h>
 #include <clang/Basic/TargetInfo.h>
 #include <clang/CodeGen/CodeGenAction.h>
 #include <clang/Frontend/FrontendOptions.h>
@@ -30,10 +33,22 @@
 #include <clang/Lex/PreprocessorOptions.h>
 #include <clang/Parse/ParseAST.h>
 
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/Path.h>
+
 /// Private class data
 struct CompilerInstance::PrivateData final {
   /// The compiler settings, such as language and include directories
   CompilerInstanceSettings compiler_settings;
+
+  /// True once the include search folders have been initialized
+  bool include_search_initialized{false};
+
+  /// The include search folders, in search order
+  StringList include_search_paths;
+
+  /// The file system used to resolve the include directives
+  FileSystemRef file_system;
 };
 
 CompilerInstance::CompilerInstance(const CompilerInstanceSettings &settings)
@@ -62,20 +77,65 @@ CompilerInstance::Status CompilerInstance::create(
 CompilerInstance::~CompilerInstance() {}
 
 CompilerInstance::Status CompilerInstance::processAST(
-    const std::string &buffer, IASTVisitorRef ast_visitor) {
+    const std::string &buffer, IASTVisitorRef ast_visitor,
+    IncludeGraph *include_graph, ParseStatistics *statistics) {
+  // The precompiled header replaces the base includes at the top of the
+  // buffer; it is not used when recording the include graph, since the
+  // directives it contains would not be reported
+  const auto *settings = &d->compiler_settings;
+  llvm::StringRef source_buffer(buffer);
+
+  CompilerInstanceSettings settings_without_pch;
+
+  if (!settings->precompiled_header.empty()) {
+    auto prefix = generateSourceBuffer({}, settings->base_includes);
+
+    if (include_graph == nullptr && source_buffer.startswith(prefix)) {
+      source_buffer = source_buffer.substr(prefix.size());
+
+    } else {
+      settings_without_pch = *settings;
+      settings_without_pch.precompiled_header.clear();
+      settings = &settings_without_pch;
+    }
+  }
+
+  TraceScope trace_scope("clang", "clang invocation");
+  incrementTraceCounter("clang invocations");
+
+  // The memory limit flag is always needed, even when the caller did not ask
+  // for the statistics
+  ParseStatistics local_statistics;
+  if (statistics == nullptr) {
+    statistics = &local_statistics;
+  }
+
+  statistics->found_identifiers.clear();
+  statistics->found_files.clear();
+  statistics->loaded_bytes = 0U;
+  statistics->ast_bytes = 0U;
+  statistics->memory_limit_exceeded = false;
+
   std::unique_ptr<clang::CompilerInstance> compiler;
-  auto status =
-      createClangCompilerInstance(compiler, d->compiler_settings, ast_visitor);
 
-  if (!status.succeeded()) {
-    return status;
+  {
+    TraceScope setup_trace_scope("clang", "compiler instance setup");
+
+    auto status =
+        createClangCompilerInstance(compiler, *settings, ast_visitor,
+                                    include_graph, clang::TU_Complete,
+                                    statistics);
+
+    if (!status.succeeded()) {
+      return status;
+    }
   }
 
   auto &source_manager = compiler->getSourceManager();
 
   clang::FileID file_id =
       source_manager.createFileID(llvm::MemoryBuffer::getMemBuffer(
-          llvm::StringRef(buffer), llvm::StringRef("main.cpp")));
+          source_buffer, llvm::StringRef("main.cpp")));
 
   source_manager.setMainFileID(file_id);
 
@@ -98,6 +158,81 @@ CompilerInstance::Status CompilerInstance::processAST(
 
   diagnostic_consumer.EndSourceFile();
 
+  // The size of the buffers loaded by the source manager; this includes the
+  // main file and every header that has been read from disk
+  auto buffer_sizes = source_manager.getMemoryBufferSizes();
+  statistics->loaded_bytes = static_cast<std::uint64_t>(
+      buffer_sizes.malloc_bytes + buffer_sizes.mmap_bytes);
+
+  const auto &ast_context = compiler->getASTContext();
+  statistics->ast_bytes =
+      static_cast<std::uint64_t>(ast_context.getASTAllocatedMemory() +
+                                 ast_context.getSideTableAllocatedMemory());
+
+  if (isTracingEnabled()) {
+    auto bytes_parsed = static_cast<std::int64_t>(statistics->loaded_bytes);
+    trace_scope.addArgument("bytes", bytes_parsed);
+    trace_scope.addArgument("ast bytes",
+                            static_cast<std::int64_t>(statistics->ast_bytes));
+    trace_scope.addArgument("errors",
+                            static_cast<std::int64_t>(
+                                diagnostic_consumer.getNumErrors()));
+
+    incrementTraceCounter("bytes parsed", bytes_parsed);
+  }
+
+  // The watched names are only looked up when the parse succeeds. The
+  // identifier table holds every identifier that has been lexed, so a name
+  // that is declared by any of the included headers is always found
+  bool parse_succeeded = diagnostic_consumer.getNumErrors() == 0;
+
+  if (parse_succeeded && !statistics->watched_identifiers.empty()) {
+    auto &identifier_table = preprocessor.getIdentifierTable();
+
+    // The identifiers stored in the modules (and in the precompiled header)
+    // only enter the table when they are looked up
+    auto external_lookup = identifier_table.getExternalIdentifierLookup();
+
+    for (const auto &identifier_name : statistics->watched_identifiers) {
+      bool found =
+          identifier_table.find(identifier_name) != identifier_table.end();
+
+      if (!found && external_lookup != nullptr) {
+        found = external_lookup->get(identifier_name) != nullptr;
+      }
+
+      if (found) {
+        statistics->found_identifiers.push_back(identifier_name);
+      }
+    }
+  }
+
+  // Headers imported from a module are not loaded by the source manager, but
+  // they are still known to the file manager
+  if (parse_succeeded && !statistics->watched_files.empty()) {
+    llvm::SmallVector<const clang::FileEntry *, 256> file_entry_list;
+    compiler->getFileManager().GetUniqueIDMapping(file_entry_list);
+
+    for (const auto *file_entry : file_entry_list) {
+      if (file_entry == nullptr) {
+        continue;
+      }
+
+      llvm::StringRef file_path = file_entry->getName();
+
+      for (const auto &watched_file : statistics->watched_files) {
+        if (file_path.endswith("/" + watched_file)) {
+          statistics->found_files.push_back(watched_file);
+        }
+      }
+    }
+  }
+
+  if (statistics->memory_limit_exceeded) {
+    return Status(false, StatusCode::MemoryLimitExceeded,
+                  "The memory limit has been reached while parsing");
+  }
+
   if (diagnostic_consumer.getNumErrors() != 0) {
     return Status(false, StatusCode::CompilationError, clang_output_buffer);
   }
@@ -108,3 +243,42 @@ CompilerInstance::Status CompilerInstance::processAST(
 
   return Status(true);
 }
+
+const CompilerInstanceSettings &CompilerInstance::settings() const {
+  return d->compiler_settings;
+}
+
+bool CompilerInstance::resolveIncludeDirective(
+    std::string &resolved_path, const std::string &include_directive) {
+  resolved_path.clear();
+
+  if (!d->include_search_initialized) {
+    for (const auto &search_path :
+         getIncludeSearchPaths(d->compiler_settings)) {
+      d->include_search_paths.push_back(search_path.first);
+    }
+
+    if (!getProfileFileSystem(d->file_system, d->compiler_settings.profile)) {
+      d->file_system = vfs::getRealFileSystem();
+    }
+
+    d->include_search_initialized = true;
+  }
+
+  // The first folder containing the file wins, like it happens in clang
+  for (const auto &search_path : d->include_search_paths) {
+    llvm::SmallString<256> candidate_path(search_path);
+    llvm::sys::path::append(candidate_path, include_directive);
+    llvm::sys::path::remove_dots(candidate_path, true);
+
+    auto status_or_error = d->file_system->status(candidate_path);
+    if (!status_or_error || !status_or_error->isRegularFile()) {
+      continue;
+    }
+
+    resolved_path = candidate_path.str().str();
+    return true;
+  }
+
+  return false;
+}
@@ -16,12 +16,21 @@
 
 #include "profilemanager.h"
 
+#include <cstdint>
+#include <map>
+
 #include <clang/AST/ASTContext.h>
 #include <clang/AST/RecursiveASTVisitor.h>
 #include <clang/Frontend/CompilerInstance.h>
 
 #pragma once
 
+/// The supported name mangling schemes
+enum class NameManglingScheme { Itanium, Microsoft };
+
+/// A list of name mangling schemes
+using NameManglingSchemeList = std::vector<NameManglingScheme>;
+
 /// Settings for the clang compiler instance
 struct CompilerInstanceSettings final {
   /// The profile to use
@@ -39,11 +48,36 @@ struct CompilerInstanceSettings final {
   /// Whether GNU extensions should be enabled or not
   bool enable_gnu_extensions{false};
 
-  /// Whether to use standard C++ name mangling rules or the Visual C++
-  /// compatibility mode
-  bool use_visual_cxx_mangling{false};
+  /// The name mangling schemes to use; when more than one is specified, the
+  /// AST visitor will produce one set of results for each of them (in the
+  /// same order) using a single parse
+  NameManglingSchemeList name_mangling_schemes{NameManglingScheme::Itanium};
+
+  /// The includes that are always placed at the top of the source buffer
+  StringList base_includes;
+
+  /// If not empty, this precompiled header (built from the base includes) is
+  /// loaded instead of parsing them again; see preparePrecompiledHeader
+  std::string precompiled_header;
+
+  /// If true, header maps are placed in front of the profile search paths,
+  /// so that most includes are resolved with a single lookup
+  bool use_header_maps{false};
+
+  /// If true, clang modules are enabled; the headers listed in the module
+  /// map generated by getModuleMap are built once, and then imported from
+  /// the on-disk module cache
+  bool use_modules{false};
+
+  /// When not zero, the parses that run an AST visitor are stopped as soon
+  /// as the memory allocated by their ASTContext exceeds this amount of
+  /// bytes; processAST fails with StatusCode::MemoryLimitExceeded
+  std::uint64_t memory_limit{0U};
 };
 
+/// A list of name manglers, one for each NameManglingScheme in use
+using NameManglerList = std::vector<clang::MangleContext *>;
+
 class IASTVisitor;
 
 /// A reference to an IASTVisitor object
@@ -58,7 +92,7 @@ class IASTVisitor : public clang::RecursiveASTVisitor<IASTVisitor> {
   /// This method is called when entering a new translation unit
   virtual void initialize(clang::ASTContext *ast_context,
                           clang::SourceManager *source_manager,
-                          clang::MangleContext *name_mangler) = 0;
+                          const NameManglerList &name_manglers) = 0;
 
   /// This method is called each time a new function (or method) declaration is
   /// found
@@ -67,11 +101,48 @@ class IASTVisitor : public clang::RecursiveASTVisitor<IASTVisitor> {
   /// Called after the last AST callback
   virtual void finalize() = 0;
 
-  /// Returns the blacklisted functions
-  virtual BlacklistedFunctionList blacklistedFunctions() const = 0;
+  /// Returns the blacklisted functions for the given name mangler
+  virtual BlacklistedFunctionList blacklistedFunctions(
+      std::size_t name_mangler_index) const = 0;
+
+  /// Returns the whitelisted functions for the given name mangler
+  virtual WhitelistedFunctionList whitelistedFunctions(
+      std::size_t name_mangler_index) const = 0;
+
+  /// Returns the number of entries in each of the visitor containers,
+  /// indexed by container name; used for memory accounting
+  virtual std::map<std::string, std::size_t> containerSizes() const {
+    return {};
+  }
+};
+
+/// Statistics collected by CompilerInstance::processAST; the watched names
+/// are the only input fields, and they are kept across calls
+struct ParseStatistics final {
+  /// Identifiers that should be looked up once the parse has completed
+  StringList watched_identifiers;
+
+  /// File names (as spelled in an include directive) that should be looked
+  /// up among the files loaded by the parse
+  StringList watched_files;
+
+  /// The watched identifiers that have been found in the translation unit,
+  /// either as a token or as a macro name
+  StringList found_identifiers;
+
+  /// The watched file names that match one of the loaded files
+  StringList found_files;
+
+  /// The size of all the buffers loaded while parsing; this includes the main
+  /// file and every header that has been read
+  std::uint64_t loaded_bytes{0U};
+
+  /// The memory allocated by the ASTContext, including the side tables
+  std::uint64_t ast_bytes{0U};
 
-  /// Returns the whitelisted functions
-  virtual WhitelistedFunctionList whitelistedFunctions() const = 0;
+  /// True if the parse (or the AST visitor) has been stopped because the
+  /// memory limit has been reached
+  bool memory_limit_exceeded{false};
 };
 
 class CompilerInstance;
@@ -101,6 +172,10 @@ class CompilerInstance final {
     MemoryAllocationFailure,
     CompilationError,
     CompilationWarning,
+    FileSystemError,
+    PrecompiledHeaderError,
+    InvalidTarget,
+    MemoryLimitExceeded,
     Unknown
   };
 
@@ -120,9 +195,24 @@ class CompilerInstance final {
   /// Destructor
   ~CompilerInstance();
 
-  /// Processes the AST of the given source code
+  /// Processes the AST of the given source code; if an include graph is
+  /// passed, it will be filled with the include directives found while
+  /// parsing. The precompiled header (if any) is used when the buffer starts
+  /// with the base includes and no include graph has been requested. The
+  /// statistics object, if any, receives the memory usage of the parse
   Status processAST(const std::string &buffer,
-                    IASTVisitorRef ast_visitor = IASTVisitorRef());
+                    IASTVisitorRef ast_visitor = IASTVisitorRef(),
+                    IncludeGraph *include_graph = nullptr,
+                    ParseStatistics *statistics = nullptr);
+
+  /// Resolves the given include directive (i.e.: #include <directive>)
+  /// against the include search paths, without compiling anything; returns
+  /// false if the file can't be found. The resolved path is absolute
+  bool resolveIncludeDirective(std::string &resolved_path,
+                               const std::string &include_directive);
+
+  /// Returns the settings used to create this instance
+  const CompilerInstanceSettings &settings() const;
 
   /// Disable the copy constructor
   CompilerInstance(const CompilerInstance &other) = delete;
@@ -0,0 +1,854 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "declarationscanner.h"
+
+#include <cstddef>
+#include <unordered_set>
+#include <vector>
+
+#include <clang/Basic/LangOptions.h>
+#include <clang/Basic/TokenKinds.h>
+#include <clang/Lex/Lexer.h>
+
+#include <llvm/Support/MemoryBuffer.h>
+
+namespace {
+/// A token returned by the raw lexer
+struct ScannedToken final {
+  /// The token kind; keywords are reported as raw identifiers
+  clang::tok::TokenKind kind{clang::tok::unknown};
+
+  /// The token spelling
+  std::string spelling;
+
+  /// True if this is the first token of a line
+  bool at_start_of_line{false};
+
+  /// True if the token is preceded by whitespace
+  bool has_leading_space{false};
+};
+
+/// A list of scanned tokens
+using ScannedTokenList = std::vector<ScannedToken>;
+
+/// A brace block opened while scanning
+struct ScannedBlock final {
+  /// True for namespaces and linkage specifications, whose contents are
+  /// still at the top level
+  bool transparent{false};
+
+  /// The namespace prefix of the block contents (i.e.: "ns::")
+  std::string scope_prefix;
+
+  /// True for the bodies of unscoped enums
+  bool unscoped_enum{false};
+
+  /// True if the statement ends with the block (i.e.: function bodies)
+  bool ends_statement{false};
+};
+
+/// Identifiers that are followed by a parenthesized list, but are not
+/// function names
+const std::unordered_set<std::string> kNonFunctionIdentifiers = {
+    "__attribute__", "__declspec", "alignas", "decltype", "noexcept",
+    "throw",         "__asm__",    "__asm",   "asm",      "typeof",
+    "__typeof__",    "sizeof",     "if",      "while",    "for",
+    "switch",        "return"};
+
+/// Returns the spelling of the given raw token
+std::string getTokenSpelling(const clang::Token &token) {
+  if (token.is(clang::tok::raw_identifier)) {
+    return token.getRawIdentifier().str();
+  }
+
+  if (token.isLiteral()) {
+    return std::string(token.getLiteralData(), token.getLength());
+  }
+
+  auto punctuator_spelling = clang::tok::getPunctuatorSpelling(token.getKind());
+  if (punctuator_spelling != nullptr) {
+    return punctuator_spelling;
+  }
+
+  return std::string();
+}
+
+/// Lexes the whole buffer; comments are discarded
+ScannedTokenList lexBuffer(const llvm::MemoryBuffer &buffer,
+                           Language language) {
+  clang::LangOptions language_options;
+  language_options.LineComment = 1;
+  language_options.DollarIdents = 1;
+
+  if (language == Language::CXX) {
+    language_options.CPlusPlus = 1;
+    language_options.CPlusPlus11 = 1;
+  }
+
+  clang::Lexer lexer(clang::SourceLocation(), language_options,
+                     buffer.getBufferStart(), buffer.getBufferStart(),
+                     buffer.getBufferEnd());
+
+  ScannedTokenList token_list;
+
+  // The raw lexer reports the end of the buffer along with the last token
+  for (bool end_of_buffer = false; !end_of_buffer;) {
+    clang::Token token;
+    end_of_buffer = lexer.LexFromRawLexer(token);
+
+    if (token.is(clang::tok::eof)) {
+      break;
+    }
+
+    ScannedToken scanned_token;
+    scanned_token.kind = token.getKind();
+    scanned_token.spelling = getTokenSpelling(token);
+    scanned_token.at_start_of_line = token.isAtStartOfLine();
+    scanned_token.has_leading_space = token.hasLeadingSpace();
+
+    token_list.push_back(std::move(scanned_token));
+  }
+
+  return token_list;
+}
+
+/// Returns true if the given token is an identifier (or a keyword)
+bool isIdentifier(const ScannedToken &token) {
+  return token.kind == clang::tok::raw_identifier;
+}
+
+/// Joins the spelling of the given tokens, separated by spaces
+std::string joinTokens(ScannedTokenList::const_iterator begin,
+                       ScannedTokenList::const_iterator end) {
+  std::string output;
+
+  for (auto it = begin; it != end; ++it) {
+    if (!output.empty()) {
+      output.push_back(' ');
+    }
+
+    output += it->spelling;
+  }
+
+  return output;
+}
+
+/// Returns the position of the token closing the group opened at the given
+/// position, or the list size if the group is never closed
+std::size_t findClosingToken(const ScannedTokenList &token_list,
+                             std::size_t open_position,
+                             clang::tok::TokenKind open_kind,
+                             clang::tok::TokenKind close_kind) {
+  std::size_t depth = 0U;
+
+  for (auto i = open_position; i < token_list.size(); ++i) {
+    if (token_list.at(i).kind == open_kind) {
+      ++depth;
+
+    } else if (token_list.at(i).kind == close_kind) {
+      if (--depth == 0U) {
+        return i;
+      }
+    }
+  }
+
+  return token_list.size();
+}
+
+/// Returns the first position after the template parameter lists found at
+/// the start of the given statement
+std::size_t skipTemplateHeader(const ScannedTokenList &statement) {
+  std::size_t position = 0U;
+
+  while (position + 1U < statement.size() &&
+         statement.at(position).spelling == "template" &&
+         statement.at(position + 1U).kind == clang::tok::less) {
+    auto closing_position = findClosingToken(
+        statement, position + 1U, clang::tok::less, clang::tok::greater);
+
+    position = closing_position + 1U;
+  }
+
+  return position;
+}
+
+/// Returns the types of the parameter list found between the given
+/// positions; parameter names and default arguments are dropped, so that
+/// the definitions of the same function can be compared
+std::string getParameterTypes(const ScannedTokenList &token_list,
+                              std::size_t begin_position,
+                              std::size_t end_position) {
+  static const std::unordered_set<std::string> kTypeKeywords = {
+      "void",     "bool",     "char",     "char16_t", "char32_t", "wchar_t",
+      "short",    "int",      "long",     "float",    "double",   "signed",
+      "unsigned", "const",    "volatile", "struct",   "class",    "enum",
+      "union",    "typename", "auto"};
+
+  // Keywords that must be followed by a type name
+  static const std::unordered_set<std::string> kTypePrefixes = {
+      "const", "volatile", "struct", "class", "enum", "union", "typename"};
+
+  std::string output;
+  ScannedTokenList parameter;
+
+  auto L_addParameter = [&output, &parameter]() -> void {
+    // The last identifier is the name, unless it is part of the type
+    if (parameter.size() > 1U && isIdentifier(parameter.back()) &&
+        kTypeKeywords.count(parameter.back().spelling) == 0U) {
+      const auto &previous_token = parameter.at(parameter.size() - 2U);
+
+      if (previous_token.kind != clang::tok::coloncolon &&
+          kTypePrefixes.count(previous_token.spelling) == 0U) {
+        parameter.pop_back();
+      }
+    }
+
+    if (!output.empty()) {
+      output += " , ";
+    }
+
+    output += joinTokens(parameter.begin(), parameter.end());
+    parameter.clear();
+  };
+
+  std::size_t nesting_depth = 0U;
+  bool default_argument = false;
+
+  for (auto i = begin_position; i < end_position && i < token_list.size();
+       ++i) {
+    const auto &token = token_list.at(i);
+
+    if (token.kind == clang::tok::l_paren ||
+        token.kind == clang::tok::l_square ||
+        token.kind == clang::tok::less) {
+      ++nesting_depth;
+
+    } else if ((token.kind == clang::tok::r_paren ||
+                token.kind == clang::tok::r_square ||
+                token.kind == clang::tok::greater) &&
+               nesting_depth != 0U) {
+      --nesting_depth;
+
+    } else if (nesting_depth == 0U && token.kind == clang::tok::comma) {
+      L_addParameter();
+      default_argument = false;
+      continue;
+
+    } else if (nesting_depth == 0U && token.kind == clang::tok::equal) {
+      default_argument = true;
+    }
+
+    if (!default_argument) {
+      parameter.push_back(token);
+    }
+  }
+
+  if (!parameter.empty() || !output.empty()) {
+    L_addParameter();
+  }
+
+  return output;
+}
+
+/// Scans the tokens of a header, filling the declaration index
+class DeclarationScanner final {
+  /// The header tokens
+  const ScannedTokenList &token_list;
+
+  /// The header language
+  Language language;
+
+  /// The output index
+  HeaderDeclarationIndex &index;
+
+  /// The open brace blocks
+  std::vector<ScannedBlock> block_stack;
+
+  /// How many preprocessor conditionals are open
+  std::size_t conditional_depth{0U};
+
+  /// The conditional depth of the include guard; zero if not open
+  std::size_t include_guard_depth{0U};
+
+  /// The macro tested by the first directive, if it is an #ifndef
+  std::string include_guard_candidate;
+
+  /// True once the first token that is not part of a directive is found
+  bool found_code{false};
+
+  /// The tokens of the current top level statement
+  ScannedTokenList statement;
+
+  /// True if part of the current statement is inside a conditional
+  bool conditional_statement{false};
+
+  /// True if the next identifier inside the enum body is an enumerator
+  bool expect_enumerator{false};
+
+  /// The parenthesis depth inside the current enum body
+  std::size_t enum_parenthesis_depth{0U};
+
+  /// Returns true if no preprocessor conditional other than the include
+  /// guard is open
+  bool isUnconditional() const {
+    auto guard_levels = include_guard_depth != 0U ? 1U : 0U;
+    return conditional_depth == guard_levels;
+  }
+
+  /// Returns true if only transparent blocks are open; the innermost
+  /// blocks can be excluded from the check
+  bool isTopLevel(std::size_t excluded_blocks = 0U) const {
+    if (excluded_blocks > block_stack.size()) {
+      return false;
+    }
+
+    auto block_count = block_stack.size() - excluded_blocks;
+    for (std::size_t i = 0U; i < block_count; ++i) {
+      if (!block_stack.at(i).transparent) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  /// Returns the namespace prefix of the top level
+  std::string getScopePrefix() const {
+    return block_stack.empty() ? std::string()
+                               : block_stack.back().scope_prefix;
+  }
+
+  /// Adds a definition to the index; the first definition wins
+  void addDefinition(const std::string &name, DeclarationIndexEntry::Kind kind,
+                     const std::string &signature) {
+    if (name.empty()) {
+      return;
+    }
+
+    DeclarationIndexEntry entry;
+    entry.kind = kind;
+    entry.signature = signature;
+
+    index.definitions.insert({name, std::move(entry)});
+  }
+
+  /// Handles the preprocessor directive starting at the given position, and
+  /// returns the position of the first token after it
+  std::size_t processDirective(std::size_t position) {
+    auto end_position = position + 1U;
+    while (end_position < token_list.size() &&
+           !token_list.at(end_position).at_start_of_line) {
+      ++end_position;
+    }
+
+    if (end_position - position < 2U) {
+      return end_position;
+    }
+
+    const auto &directive = token_list.at(position + 1U).spelling;
+    const std::string *argument = nullptr;
+    if (end_position - position >= 3U) {
+      argument = &token_list.at(position + 2U).spelling;
+    }
+
+    if (directive == "if" || directive == "ifdef" || directive == "ifndef") {
+      ++conditional_depth;
+
+      bool first_directive = !found_code && conditional_depth == 1U &&
+                             index.include_guard.empty();
+
+      include_guard_candidate.clear();
+      if (directive == "ifndef" && first_directive && argument != nullptr) {
+        include_guard_candidate = *argument;
+      }
+
+    } else if (directive == "endif") {
+      if (conditional_depth != 0U) {
+        --conditional_depth;
+      }
+
+      if (conditional_depth < include_guard_depth) {
+        include_guard_depth = 0U;
+      }
+
+    } else if (directive == "define" && argument != nullptr) {
+      if (!include_guard_candidate.empty() &&
+          *argument == include_guard_candidate) {
+        index.include_guard = include_guard_candidate;
+        include_guard_depth = conditional_depth;
+
+      } else if (isUnconditional()) {
+        index.macros[*argument] = joinTokens(
+            token_list.begin() + static_cast<std::ptrdiff_t>(position + 3U),
+            token_list.begin() + static_cast<std::ptrdiff_t>(end_position));
+      }
+
+      include_guard_candidate.clear();
+
+    } else if (directive == "undef" && argument != nullptr) {
+      if (isUnconditional()) {
+        index.macros.erase(*argument);
+      }
+
+      include_guard_candidate.clear();
+
+    } else if (directive == "pragma" && argument != nullptr &&
+               *argument == "once") {
+      index.pragma_once = true;
+      include_guard_candidate.clear();
+
+    } else if (directive != "else" && directive != "elif") {
+      include_guard_candidate.clear();
+    }
+
+    return end_position;
+  }
+
+  /// Returns the name declared by the given tag definition, or an empty
+  /// string if this is an anonymous tag or a specialization
+  std::string getTagName(std::size_t keyword_position,
+                         std::size_t end_position) const {
+    std::string name;
+
+    for (auto i = keyword_position + 1U; i < end_position; ++i) {
+      const auto &token = statement.at(i);
+
+      if (token.kind == clang::tok::l_paren) {
+        i = findClosingToken(statement, i, clang::tok::l_paren,
+                             clang::tok::r_paren);
+
+      } else if (token.kind == clang::tok::l_square) {
+        i = findClosingToken(statement, i, clang::tok::l_square,
+                             clang::tok::r_square);
+
+      } else if (token.kind == clang::tok::less) {
+        // Template specializations are not indexed
+        return std::string();
+
+      } else if (token.kind == clang::tok::colon) {
+        break;
+
+      } else if (token.kind == clang::tok::equal) {
+        // Variables initialized with a brace list
+        return std::string();
+
+      } else if (isIdentifier(token) && token.spelling != "final" &&
+                 token.spelling != "class" && token.spelling != "struct" &&
+                 kNonFunctionIdentifiers.count(token.spelling) == 0U) {
+        name = token.spelling;
+      }
+    }
+
+    return name;
+  }
+
+  /// Indexes the function defined by the current statement, if any; returns
+  /// true if the statement is a function definition
+  bool processFunctionDefinition(std::size_t begin_position,
+                                 bool add_definition) {
+    // Constructor initializer lists are not part of the declarator
+    auto end_position = statement.size();
+    for (auto i = begin_position; i + 1U < end_position; ++i) {
+      if (statement.at(i).kind == clang::tok::r_paren &&
+          statement.at(i + 1U).kind == clang::tok::colon) {
+        end_position = i + 1U;
+        break;
+      }
+    }
+
+    // The function name is the last identifier followed by a parameter list
+    std::size_t name_position = end_position;
+    std::size_t parameters_position = end_position;
+
+    for (auto i = begin_position; i < end_position; ++i) {
+      const auto &token = statement.at(i);
+
+      if (token.kind == clang::tok::equal) {
+        return false;
+      }
+
+      if (token.spelling == "operator") {
+        return false;
+      }
+
+      if (token.kind != clang::tok::l_paren) {
+        continue;
+      }
+
+      auto closing_position = findClosingToken(
+          statement, i, clang::tok::l_paren, clang::tok::r_paren);
+
+      if (i > begin_position && isIdentifier(statement.at(i - 1U)) &&
+          kNonFunctionIdentifiers.count(statement.at(i - 1U).spelling) == 0U) {
+        name_position = i - 1U;
+        parameters_position = i;
+      }
+
+      i = closing_position;
+    }
+
+    if (name_position == end_position) {
+      return false;
+    }
+
+    // Include the class and namespace qualifiers
+    auto qualified_name = statement.at(name_position).spelling;
+    auto qualifier_position = name_position;
+
+    if (qualifier_position > begin_position &&
+        statement.at(qualifier_position - 1U).kind == clang::tok::tilde) {
+      qualified_name = "~" + qualified_name;
+      --qualifier_position;
+    }
+
+    while (qualifier_position >= begin_position + 2U &&
+           statement.at(qualifier_position - 1U).kind ==
+               clang::tok::coloncolon &&
+           isIdentifier(statement.at(qualifier_position - 2U))) {
+      qualified_name =
+          statement.at(qualifier_position - 2U).spelling + "::" +
+          qualified_name;
+
+      qualifier_position -= 2U;
+    }
+
+    auto closing_position =
+        findClosingToken(statement, parameters_position, clang::tok::l_paren,
+                         clang::tok::r_paren);
+
+    auto parameters = getParameterTypes(statement, parameters_position + 1U,
+                                        closing_position);
+
+    auto name = getScopePrefix() + qualified_name;
+
+    // C++ functions can be overloaded
+    if (language == Language::CXX) {
+      name += "(" + parameters + ")";
+    }
+
+    if (add_definition) {
+      addDefinition(name, DeclarationIndexEntry::Kind::Function, parameters);
+    }
+
+    return true;
+  }
+
+  /// Handles an opening brace found at the top level
+  void processTopLevelBlock() {
+    ScannedBlock block;
+    block.scope_prefix = getScopePrefix();
+
+    auto begin_position = skipTemplateHeader(statement);
+    if (begin_position < statement.size() &&
+        statement.at(begin_position).spelling == "inline") {
+      ++begin_position;
+    }
+
+    bool is_conditional = conditional_statement || !isUnconditional();
+
+    if (begin_position < statement.size() &&
+        statement.at(begin_position).spelling == "namespace") {
+      block.transparent = true;
+
+      for (auto i = begin_position + 1U; i < statement.size(); ++i) {
+        if (isIdentifier(statement.at(i))) {
+          block.scope_prefix += statement.at(i).spelling + "::";
+        }
+      }
+
+      statement.clear();
+      conditional_statement = false;
+
+      block_stack.push_back(std::move(block));
+      return;
+    }
+
+    if (begin_position + 1U < statement.size() &&
+        statement.at(begin_position).spelling == "extern" &&
+        statement.at(begin_position + 1U).kind == clang::tok::string_literal) {
+      block.transparent = true;
+
+      statement.clear();
+      conditional_statement = false;
+
+      block_stack.push_back(std::move(block));
+      return;
+    }
+
+    auto keyword_position = begin_position;
+    if (keyword_position < statement.size() &&
+        statement.at(keyword_position).spelling == "typedef") {
+      ++keyword_position;
+    }
+
+    const auto *keyword = keyword_position < statement.size()
+                              ? &statement.at(keyword_position).spelling
+                              : nullptr;
+
+    bool is_tag = keyword != nullptr &&
+                  (*keyword == "struct" || *keyword == "class" ||
+                   *keyword == "union" || *keyword == "enum");
+
+    // Functions returning tags are also introduced by a tag keyword
+    if ((keyword == nullptr || *keyword != "typedef") &&
+        processFunctionDefinition(begin_position, !is_conditional)) {
+      block.ends_statement = true;
+
+    } else if (is_tag) {
+      bool scoped_enum = false;
+      if (*keyword == "enum" && keyword_position + 1U < statement.size()) {
+        const auto &next_token = statement.at(keyword_position + 1U).spelling;
+        scoped_enum = next_token == "class" || next_token == "struct";
+      }
+
+      block.unscoped_enum = *keyword == "enum" && !scoped_enum;
+      expect_enumerator = block.unscoped_enum;
+      enum_parenthesis_depth = 0U;
+
+      auto tag_name = getTagName(keyword_position, statement.size());
+      if (!tag_name.empty() && !is_conditional) {
+        addDefinition("tag " + block.scope_prefix + tag_name,
+                      DeclarationIndexEntry::Kind::Tag, std::string());
+      }
+    }
+
+    if (!block.ends_statement) {
+      statement.push_back(ScannedToken{clang::tok::l_brace, "{"});
+    }
+
+    block_stack.push_back(std::move(block));
+  }
+
+  /// Handles the end of a top level statement
+  void processStatement() {
+    auto begin_position = skipTemplateHeader(statement);
+    bool is_conditional = conditional_statement || !isUnconditional();
+
+    if (is_conditional || begin_position >= statement.size()) {
+      return;
+    }
+
+    auto signature = joinTokens(
+        statement.begin() + static_cast<std::ptrdiff_t>(begin_position),
+        statement.end());
+
+    const auto &first_token = statement.at(begin_position).spelling;
+
+    // Alias declarations: using name = type;
+    if (first_token == "using") {
+      if (begin_position + 2U < statement.size() &&
+          isIdentifier(statement.at(begin_position + 1U)) &&
+          statement.at(begin_position + 2U).kind == clang::tok::equal) {
+        addDefinition(
+            getScopePrefix() + statement.at(begin_position + 1U).spelling,
+            DeclarationIndexEntry::Kind::Typedef, signature);
+      }
+
+      return;
+    }
+
+    if (first_token != "typedef") {
+      return;
+    }
+
+    // Skip the body of the tag, if any; each declarator is separated by a
+    // comma at the top level
+    auto declarator_position = begin_position + 1U;
+    for (auto i = begin_position + 1U; i < statement.size(); ++i) {
+      if (statement.at(i).kind == clang::tok::r_brace) {
+        declarator_position = i + 1U;
+      }
+    }
+
+    std::size_t nesting_depth = 0U;
+    std::string declarator_name;
+    bool stop_declarator = false;
+
+    auto L_addDeclarator = [&]() -> void {
+      addDefinition(getScopePrefix() + declarator_name,
+                    DeclarationIndexEntry::Kind::Typedef, signature);
+
+      declarator_name.clear();
+      stop_declarator = false;
+    };
+
+    for (auto i = declarator_position; i < statement.size(); ++i) {
+      const auto &token = statement.at(i);
+
+      if (token.kind == clang::tok::l_paren ||
+          token.kind == clang::tok::l_square) {
+        // Function pointers: typedef int (*name)(int);
+        if (token.kind == clang::tok::l_paren && !stop_declarator &&
+            i + 2U < statement.size() &&
+            (statement.at(i + 1U).kind == clang::tok::star ||
+             statement.at(i + 1U).kind == clang::tok::caret) &&
+            isIdentifier(statement.at(i + 2U))) {
+          declarator_name = statement.at(i + 2U).spelling;
+          stop_declarator = true;
+        }
+
+        ++nesting_depth;
+
+      } else if (token.kind == clang::tok::r_paren ||
+                 token.kind == clang::tok::r_square) {
+        if (nesting_depth != 0U) {
+          --nesting_depth;
+        }
+
+      } else if (nesting_depth == 0U && token.kind == clang::tok::comma) {
+        L_addDeclarator();
+
+      } else if (nesting_depth == 0U && isIdentifier(token) &&
+                 !stop_declarator) {
+        if (kNonFunctionIdentifiers.count(token.spelling) != 0U) {
+          stop_declarator = true;
+        } else {
+          declarator_name = token.spelling;
+        }
+      }
+    }
+
+    L_addDeclarator();
+  }
+
+ public:
+  /// Constructor
+  DeclarationScanner(const ScannedTokenList &token_list, Language language,
+                     HeaderDeclarationIndex &index)
+      : token_list(token_list), language(language), index(index) {}
+
+  /// Scans the whole token list
+  void scan() {
+    for (std::size_t i = 0U; i < token_list.size();) {
+      const auto &token = token_list.at(i);
+
+      if (token.kind == clang::tok::hash && token.at_start_of_line) {
+        i = processDirective(i);
+        continue;
+      }
+
+      found_code = true;
+      include_guard_candidate.clear();
+      ++i;
+
+      if (token.kind == clang::tok::l_brace) {
+        if (isTopLevel()) {
+          processTopLevelBlock();
+        } else {
+          block_stack.push_back(ScannedBlock{});
+        }
+
+        continue;
+      }
+
+      if (token.kind == clang::tok::r_brace) {
+        if (block_stack.empty()) {
+          continue;
+        }
+
+        auto block = std::move(block_stack.back());
+        block_stack.pop_back();
+
+        if (isTopLevel() && !block.transparent) {
+          if (block.ends_statement) {
+            statement.clear();
+            conditional_statement = false;
+          } else {
+            statement.push_back(ScannedToken{clang::tok::r_brace, "}"});
+          }
+        }
+
+        expect_enumerator = false;
+        continue;
+      }
+
+      // Enumerators are declared in the enclosing scope
+      if (!block_stack.empty() && block_stack.back().unscoped_enum) {
+        if (!isTopLevel(1U)) {
+          continue;
+        }
+
+        if (token.kind == clang::tok::l_paren) {
+          ++enum_parenthesis_depth;
+
+        } else if (token.kind == clang::tok::r_paren &&
+                   enum_parenthesis_depth != 0U) {
+          --enum_parenthesis_depth;
+
+        } else if (token.kind == clang::tok::comma &&
+                   enum_parenthesis_depth == 0U) {
+          expect_enumerator = true;
+
+        } else if (expect_enumerator && isIdentifier(token)) {
+          if (!conditional_statement && isUnconditional()) {
+            addDefinition(block_stack.back().scope_prefix + token.spelling,
+                          DeclarationIndexEntry::Kind::Enumerator,
+                          std::string());
+          }
+
+          expect_enumerator = false;
+        }
+
+        continue;
+      }
+
+      if (!isTopLevel()) {
+        continue;
+      }
+
+      if (token.kind == clang::tok::semi) {
+        processStatement();
+
+        statement.clear();
+        conditional_statement = false;
+        continue;
+      }
+
+      statement.push_back(token);
+      if (!isUnconditional()) {
+        conditional_statement = true;
+      }
+    }
+  }
+};
+}  // namespace
+
+bool scanHeaderDeclarations(HeaderDeclarationIndex &index,
+                            const std::string &path, Language language) {
+  index = {};
+
+  auto buffer_or_error = llvm::MemoryBuffer::getFile(path);
+  if (!buffer_or_error) {
+    return false;
+  }
+
+  auto token_list = lexBuffer(*buffer_or_error.get(), language);
+
+  DeclarationScanner scanner(token_list, language, index);
+  scanner.scan();
+
+  return true;
+}
+
+bool isConflictingDefinition(const DeclarationIndexEntry &lhs,
+                             const DeclarationIndexEntry &rhs) {
+  // Typedef redeclarations are legal as long as both name the same type,
+  // which can't be decided from the tokens alone (i.e.: "unsigned" and
+  // "unsigned int", or a typedef of another typedef)
+  return lhs.kind != DeclarationIndexEntry::Kind::Typedef ||
+         rhs.kind != DeclarationIndexEntry::Kind::Typedef;
+}
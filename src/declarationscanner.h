@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "languagemanager.h"
+
+#include <map>
+#include <string>
+
+/// A name defined by a header
+struct DeclarationIndexEntry final {
+  /// The supported definition kinds
+  enum class Kind { Tag, Typedef, Function, Enumerator };
+
+  /// The definition kind
+  Kind kind{Kind::Tag};
+
+  /// The declaration tokens (typedefs) or the parameter list (functions)
+  std::string signature;
+};
+
+/// The names defined at the top level of a header, outside of any
+/// preprocessor conditional (the include guard excluded)
+struct HeaderDeclarationIndex final {
+  /// The include guard macro; empty if the header has none
+  std::string include_guard;
+
+  /// True if the header contains #pragma once
+  bool pragma_once{false};
+
+  /// The defined names; tags are prefixed with "tag ", and C++ functions
+  /// are followed by their parameter list
+  std::map<std::string, DeclarationIndexEntry> definitions;
+
+  /// The macros, along with their replacement list
+  std::map<std::string, std::string> macros;
+};
+
+/// Builds the declaration index of the given header using the raw lexer;
+/// nothing is preprocessed, so this is much faster than a parse. Returns
+/// false if the file could not be read
+bool scanHeaderDeclarations(HeaderDeclarationIndex &index,
+                            const std::string &path, Language language);
+
+/// Returns true if the given definitions of the same name can't appear in
+/// the same translation unit; typedefs never conflict with each other, since
+/// they may legally be redeclared
+bool isConflictingDefinition(const DeclarationIndexEntry &lhs,
+                             const DeclarationIndexEntry &rhs);
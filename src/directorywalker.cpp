@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "directorywalker.h"
+#include "std_filesystem.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#include <system_error>
+#else
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <dirent.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+namespace {
+#ifndef _WIN32
+/// The state shared by the directory walker threads
+struct DirectoryWalkerState final {
+  /// Guards the whole structure
+  std::mutex mutex;
+
+  /// Signaled when new folders are queued or when the walk is over
+  std::condition_variable condition;
+
+  /// The folders that still have to be read, relative to the root
+  StringList pending_folders;
+
+  /// How many threads are currently reading a folder
+  std::size_t active_thread_count{0U};
+
+  /// The files found so far, relative to the root
+  StringList file_list;
+
+  /// Set when a folder could not be read; stops all the threads
+  bool failed{false};
+};
+
+/// Joins the given relative path and entry name
+std::string joinRelativePath(const std::string &folder,
+                             const std::string &name) {
+  return folder.empty() ? name : folder + "/" + name;
+}
+
+/// Reads a single folder, returning its files and sub folders
+bool readFolder(StringList &file_list, StringList &folder_list,
+                const std::string &root, const std::string &folder) {
+  auto absolute_folder = folder.empty() ? root : root + "/" + folder;
+
+  auto directory = opendir(absolute_folder.c_str());
+  if (directory == nullptr) {
+    return false;
+  }
+
+  bool succeeded = true;
+
+  while (true) {
+    errno = 0;
+    auto entry = readdir(directory);
+    if (entry == nullptr) {
+      succeeded = (errno == 0);
+      break;
+    }
+
+    std::string name = entry->d_name;
+    if (name == "." || name == "..") {
+      continue;
+    }
+
+    auto relative_path = joinRelativePath(folder, name);
+    auto entry_type = entry->d_type;
+
+    // Only symbolic links and file systems that do not report the entry
+    // type require a stat() call
+    if (entry_type == DT_LNK || entry_type == DT_UNKNOWN) {
+      auto absolute_path = absolute_folder + "/" + name;
+
+      struct stat file_status = {};
+      if (stat(absolute_path.c_str(), &file_status) != 0) {
+        continue;
+      }
+
+      if (S_ISREG(file_status.st_mode)) {
+        entry_type = DT_REG;
+
+      } else if (S_ISDIR(file_status.st_mode) && entry_type == DT_UNKNOWN) {
+        entry_type = DT_DIR;
+
+      } else {
+        continue;
+      }
+    }
+
+    if (entry_type == DT_DIR) {
+      folder_list.push_back(relative_path);
+
+    } else if (entry_type == DT_REG) {
+      file_list.push_back(relative_path);
+    }
+  }
+
+  closedir(directory);
+  return succeeded;
+}
+
+/// Directory walker thread; reads folders until the queue is empty and no
+/// other thread can add new ones
+void directoryWalkerThread(DirectoryWalkerState &state,
+                           const std::string &root) {
+  while (true) {
+    std::string folder;
+
+    {
+      std::unique_lock<std::mutex> lock(state.mutex);
+
+      state.condition.wait(lock, [&state]() -> bool {
+        return state.failed || !state.pending_folders.empty() ||
+               state.active_thread_count == 0U;
+      });
+
+      if (state.failed || state.pending_folders.empty()) {
+        break;
+      }
+
+      folder = std::move(state.pending_folders.back());
+      state.pending_folders.pop_back();
+
+      ++state.active_thread_count;
+    }
+
+    StringList file_list;
+    StringList folder_list;
+    auto succeeded = readFolder(file_list, folder_list, root, folder);
+
+    {
+      std::lock_guard<std::mutex> lock(state.mutex);
+
+      --state.active_thread_count;
+
+      if (!succeeded) {
+        state.failed = true;
+      }
+
+      state.pending_folders.insert(state.pending_folders.end(),
+                                   folder_list.begin(), folder_list.end());
+
+      state.file_list.insert(state.file_list.end(), file_list.begin(),
+                             file_list.end());
+    }
+
+    state.condition.notify_all();
+  }
+}
+#endif
+}  // namespace
+
+bool enumerateFolderFiles(StringList &file_list, const std::string &root,
+                          std::size_t thread_count) {
+  file_list = {};
+
+  std::error_code error;
+  auto root_path = stdfs::absolute(root, error);
+  if (error || !stdfs::is_directory(root_path, error)) {
+    return false;
+  }
+
+  StringList output;
+
+#ifdef _WIN32
+  static_cast<void>(thread_count);
+
+  try {
+    for (const auto &directory_entry :
+         stdfs::recursive_directory_iterator(root_path)) {
+      const auto &path = directory_entry.path();
+      if (!stdfs::is_regular_file(path)) {
+        continue;
+      }
+
+      output.push_back(path.lexically_relative(root_path).generic_string());
+    }
+
+  } catch (...) {
+    return false;
+  }
+
+#else
+  if (thread_count == 0U) {
+    thread_count = std::max(1U, std::thread::hardware_concurrency());
+  }
+
+  DirectoryWalkerState state;
+  state.pending_folders.push_back("");
+
+  auto root_folder = root_path.string();
+
+  std::vector<std::thread> thread_pool;
+  for (std::size_t i = 0U; i < thread_count; ++i) {
+    thread_pool.emplace_back(directoryWalkerThread, std::ref(state),
+                             std::cref(root_folder));
+  }
+
+  for (auto &thread : thread_pool) {
+    thread.join();
+  }
+
+  if (state.failed) {
+    return false;
+  }
+
+  output = std::move(state.file_list);
+#endif
+
+  std::sort(output.begin(), output.end());
+
+  file_list = std::move(output);
+  return true;
+}
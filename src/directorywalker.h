@@ -0,0 +1,32 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "types.h"
+
+#include <cstddef>
+#include <string>
+
+/// Recursively enumerates the regular files inside the given folder. Folders
+/// are read concurrently using the given amount of threads (zero selects the
+/// number of hardware threads); the entry types reported by the directory
+/// listing are used whenever possible, so that the files do not have to be
+/// stat'ed one by one. Symbolic links to files are reported, while symbolic
+/// links to folders are not followed. Paths are relative to the given folder,
+/// use forward slashes and are sorted so that the output is reproducible
+bool enumerateFolderFiles(StringList &file_list, const std::string &root,
+                          std::size_t thread_count = 0U);
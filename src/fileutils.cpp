@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fileutils.h"
+#include "std_filesystem.h"
+
+#include <fstream>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+
+bool createTemporaryFile(std::string &temporary_path,
+                         const std::string &path) {
+  temporary_path.clear();
+
+  llvm::SmallString<256> unique_path;
+  if (llvm::sys::fs::createUniqueFile(path + ".%%%%%%%%.abigen-tmp",
+                                      unique_path)) {
+    return false;
+  }
+
+  temporary_path = unique_path.str().str();
+  return true;
+}
+
+bool writeFileAtomically(const std::string &path, llvm::StringRef contents) {
+  std::string temporary_path;
+  if (!createTemporaryFile(temporary_path, path)) {
+    return false;
+  }
+
+  std::error_code error;
+
+  {
+    std::ofstream temporary_file(temporary_path,
+                                 std::ios::binary | std::ios::trunc);
+
+    temporary_file.write(contents.data(),
+                         static_cast<std::streamsize>(contents.size()));
+    temporary_file.flush();
+
+    if (!temporary_file) {
+      temporary_file.close();
+
+      stdfs::remove(temporary_path, error);
+      return false;
+    }
+  }
+
+  stdfs::rename(temporary_path, path, error);
+  if (error) {
+    stdfs::remove(temporary_path, error);
+    return false;
+  }
+
+  return true;
+}
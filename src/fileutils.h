@@ -0,0 +1,32 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+
+#include <llvm/ADT/StringRef.h>
+
+/// Creates a new, uniquely named temporary file in the same folder as the
+/// given path, so that it can later be renamed over it. Each call returns a
+/// different file, even across processes
+bool createTemporaryFile(std::string &temporary_path, const std::string &path);
+
+/// Replaces the given file with the specified contents. The data is written
+/// to a unique temporary file which is then renamed over the destination, so
+/// that readers (and concurrent writers) never observe a partially written
+/// file. The parent folder must exist
+bool writeFileAtomically(const std::string &path, llvm::StringRef contents);
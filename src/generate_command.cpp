@@ -18,132 +18,936 @@
 #include "abi_lib_generator.h"
 #include "astvisitor.h"
 #include "generate_utils.h"
+#include "std_filesystem.h"
+#include "tracing.h"
 
-/// Handler for the 'generate' command
-bool generateCommandHandler(ProfileManagerRef &profile_manager,
-                            const LanguageManager &language_manager,
-                            const CommandLineOptions &cmdline_options) {
-  // Start by enumerating all the include files
-  std::vector<HeaderDescriptor> header_files;
-  if (!enumerateIncludeFiles(header_files, cmdline_options.header_folders)) {
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <tuple>
+#include <unordered_set>
+
+#include <json11.hpp>
+
+namespace {
+/// Returns the profiles selected on the command line, either with the
+/// --profile option or with --all-profiles
+bool getGenerateProfileNames(StringList &profile_names,
+                             ProfileManagerRef &profile_manager,
+                             const CommandLineOptions &cmdline_options) {
+  profile_names.clear();
+
+  if (cmdline_options.all_profiles) {
+    profile_manager->enumerate<StringList *>(
+        [](const Profile &profile, StringList *profile_names) -> bool {
+          profile_names->push_back(profile.name);
+          return true;
+        },
+
+        &profile_names);
+
+  } else {
+    for (const auto &profile_name : cmdline_options.profile_names) {
+      if (std::find(profile_names.begin(), profile_names.end(),
+                    profile_name) == profile_names.end()) {
+        profile_names.push_back(profile_name);
+      }
+    }
+  }
+
+  if (profile_names.empty()) {
+    std::cerr << "No profile has been selected; use either --profile or "
+                 "--all-profiles\n";
     return false;
   }
 
-  // Allocate a new compiler instance
-  CompilerInstanceRef compiler;
-  if (!createCompilerInstance(compiler, profile_manager, language_manager,
-                              cmdline_options)) {
+  // Always process the profiles in the same order
+  if (cmdline_options.all_profiles) {
+    std::sort(profile_names.begin(), profile_names.end());
+  }
+
+  return true;
+}
+
+/// Returns the output path used for the given profile when generating more
+/// than one ABI library; the profile name is used as a folder name
+bool getProfileOutputPath(std::string &profile_output,
+                          const std::string &output,
+                          const std::string &profile_name) {
+  profile_output.clear();
+
+  std::string folder_name;
+  for (auto c : profile_name) {
+    folder_name.push_back(std::isalnum(static_cast<unsigned char>(c)) ||
+                                  c == '.' || c == '-'
+                              ? c
+                              : '_');
+  }
+
+  auto output_path = stdfs::path(output);
+  auto output_folder = output_path.parent_path() / folder_name;
+
+  std::error_code error;
+  stdfs::create_directories(output_folder, error);
+  if (error) {
     return false;
   }
 
-  // Attempt to include as many headers as possible; stop when we can no longer
-  // add new ones to the list of active ones. We do not care about the AST right
-  // now! Just try to pass the compilation
-  std::cerr << "Processed headers\n\n";
-  std::string total_header_count_str = std::to_string(header_files.size());
-  auto header_counter_digits = static_cast<int>(total_header_count_str.size());
+  profile_output = (output_folder / output_path.filename()).string();
+  return true;
+}
 
-  StringList active_include_headers;
+/// Returns the output path used for the given name mangling scheme; the
+/// scheme name is only appended when more than one scheme is generated
+std::string getNameManglingSchemeOutputPath(
+    const std::string &output,
+    const NameManglingSchemeList &name_mangling_schemes, std::size_t index) {
+  if (name_mangling_schemes.size() <= 1U) {
+    return output;
+  }
 
-  while (true) {
-    auto previous_active_header_count = active_include_headers.size();
-    for (auto header_desc_it = header_files.begin();
-         header_desc_it != header_files.end();) {
-      auto possible_include_directives =
-          generateIncludeDirectives(*header_desc_it);
+  return output + "_" +
+         getNameManglingSchemeName(name_mangling_schemes.at(index));
+}
 
-      bool include_succeeded = false;
-      for (const auto &include_directive : possible_include_directives) {
-        auto new_include_headers = active_include_headers;
-        new_include_headers.push_back(include_directive);
+/// The functions collected by the AST visitor, for each name mangling scheme
+struct CollectedFunctions final {
+  /// The blacklisted functions, one list for each name mangling scheme
+  std::vector<BlacklistedFunctionList> blacklisted_function_lists;
 
-        auto source_buffer = generateSourceBuffer(
-            new_include_headers, cmdline_options.base_includes);
+  /// The whitelisted functions, one list for each name mangling scheme
+  std::vector<WhitelistedFunctionList> whitelisted_function_lists;
+};
 
-        auto compiler_status = compiler->processAST(source_buffer);
-        include_succeeded = compiler_status.succeeded();
+/// Parses the given headers with the AST visitor enabled, appending the
+/// functions found to the output lists
+CompilerInstance::Status collectFunctions(
+    CollectedFunctions &collected_functions, CompilerInstance &compiler,
+    const StringList &include_list, const StringList &base_includes,
+    std::size_t name_mangling_scheme_count,
+    IncludeGraph *include_graph = nullptr) {
+  IASTVisitorRef visitor_ref;
+  auto visitor_status = ASTVisitor::create(visitor_ref);
+  if (!visitor_status.succeeded()) {
+    return CompilerInstance::Status(
+        false, CompilerInstance::StatusCode::MemoryAllocationFailure,
+        "Failed to create the ASTVisitor object: " +
+            visitor_status.toString());
+  }
 
-        if (include_succeeded) {
-          active_include_headers.push_back(include_directive);
+  auto source_buffer = generateSourceBuffer(include_list, base_includes);
 
-          std::cerr << "  [" << std::setfill('0')
-                    << std::setw(header_counter_digits)
-                    << active_include_headers.size();
+  auto compiler_status =
+      compiler.processAST(source_buffer, visitor_ref, include_graph);
+  if (!compiler_status.succeeded()) {
+    return compiler_status;
+  }
 
-          std::cerr << "/" << total_header_count_str << "] "
-                    << include_directive << "\n";
+  auto &blacklisted_function_lists =
+      collected_functions.blacklisted_function_lists;
+  auto &whitelisted_function_lists =
+      collected_functions.whitelisted_function_lists;
 
-          break;
-        }
-      }
+  blacklisted_function_lists.resize(name_mangling_scheme_count);
+  whitelisted_function_lists.resize(name_mangling_scheme_count);
+
+  for (std::size_t i = 0U; i < name_mangling_scheme_count; ++i) {
+    auto blacklisted_function_list = visitor_ref->blacklistedFunctions(i);
+    blacklisted_function_lists.at(i).insert(
+        blacklisted_function_lists.at(i).end(),
+        std::make_move_iterator(blacklisted_function_list.begin()),
+        std::make_move_iterator(blacklisted_function_list.end()));
+
+    auto whitelisted_function_list = visitor_ref->whitelistedFunctions(i);
+    whitelisted_function_lists.at(i).insert(
+        whitelisted_function_lists.at(i).end(),
+        std::make_move_iterator(whitelisted_function_list.begin()),
+        std::make_move_iterator(whitelisted_function_list.end()));
+  }
+
+  return compiler_status;
+}
+
+/// Removes the functions that have been collected by more than one shard,
+/// and sorts the lists by location like the AST visitor does. Functions
+/// that have been blacklisted by any of the shards are never whitelisted
+void mergeShardFunctions(CollectedFunctions &collected_functions) {
+  auto L_isLessThan = [](const auto &lhs, const auto &rhs) -> bool {
+    return std::tie(lhs.location.file_path, lhs.location.line,
+                    lhs.location.column, lhs.mangled_name) <
+           std::tie(rhs.location.file_path, rhs.location.line,
+                    rhs.location.column, rhs.mangled_name);
+  };
+
+  auto L_removeDuplicates = [&L_isLessThan](auto &function_list) -> void {
+    std::stable_sort(function_list.begin(), function_list.end(), L_isLessThan);
+
+    std::unordered_set<std::string> visited_functions;
+    auto new_end = std::remove_if(
+        function_list.begin(), function_list.end(),
+        [&visited_functions](const auto &function) -> bool {
+          return !visited_functions.insert(function.mangled_name).second;
+        });
+
+    function_list.erase(new_end, function_list.end());
+  };
+
+  auto &blacklisted_function_lists =
+      collected_functions.blacklisted_function_lists;
+  auto &whitelisted_function_lists =
+      collected_functions.whitelisted_function_lists;
+
+  for (std::size_t i = 0U; i < blacklisted_function_lists.size(); ++i) {
+    auto &blacklisted_function_list = blacklisted_function_lists.at(i);
+    auto &whitelisted_function_list = whitelisted_function_lists.at(i);
+
+    L_removeDuplicates(blacklisted_function_list);
+    L_removeDuplicates(whitelisted_function_list);
+
+    std::unordered_set<std::string> blacklisted_names;
+    for (const auto &function : blacklisted_function_list) {
+      blacklisted_names.insert(function.mangled_name);
+    }
+
+    auto new_end = std::remove_if(
+        whitelisted_function_list.begin(), whitelisted_function_list.end(),
+        [&blacklisted_names](const WhitelistedFunction &function) -> bool {
+          return blacklisted_names.count(function.mangled_name) != 0U;
+        });
+
+    whitelisted_function_list.erase(new_end, whitelisted_function_list.end());
+  }
+}
+
+/// Analyzes the headers a few at a time, so that each translation unit
+/// needs less memory than the whole include list. Shards that can't be
+/// parsed are split in half; a single header that fails on its own is
+/// parsed again along with a growing number of the headers that precede it,
+/// since this is how it has been included while probing. Returns false if
+/// any of the headers could not be analyzed
+bool collectShardedFunctions(CollectedFunctions &collected_functions,
+                             CompilerInstance &compiler,
+                             const StringList &include_list,
+                             const StringList &base_includes,
+                             std::size_t name_mangling_scheme_count,
+                             std::ostream &log) {
+  // The shards are further split only when needed
+  const std::size_t kInitialShardCount = 4U;
+
+  auto shard_size = (include_list.size() + kInitialShardCount - 1U) /
+                    kInitialShardCount;
+
+  shard_size = std::max<std::size_t>(shard_size, 1U);
+
+  // Header ranges, as [first, last) pairs; the back is processed first
+  std::vector<std::pair<std::size_t, std::size_t>> pending_shards;
+  for (std::size_t first = 0U; first < include_list.size();
+       first += shard_size) {
+    pending_shards.emplace_back(
+        first, std::min(first + shard_size, include_list.size()));
+  }
+
+  std::reverse(pending_shards.begin(), pending_shards.end());
+
+  std::size_t shard_count = 0U;
+  std::size_t skipped_header_count = 0U;
+
+  while (!pending_shards.empty()) {
+    auto first = pending_shards.back().first;
+    auto last = pending_shards.back().second;
+    pending_shards.pop_back();
+
+    StringList shard_headers(
+        include_list.begin() + static_cast<std::ptrdiff_t>(first),
+        include_list.begin() + static_cast<std::ptrdiff_t>(last));
+
+    TraceScope trace_scope("generate", "shard parse");
+    trace_scope.addArgument("headers",
+                            static_cast<std::int64_t>(shard_headers.size()));
+
+    auto compiler_status =
+        collectFunctions(collected_functions, compiler, shard_headers,
+                         base_includes, name_mangling_scheme_count);
+
+    if (compiler_status.succeeded()) {
+      ++shard_count;
+      continue;
+    }
+
+    if (last - first > 1U) {
+      auto middle = first + (last - first) / 2U;
 
-      if (include_succeeded) {
-        header_desc_it = header_files.erase(header_desc_it);
-      } else {
-        header_desc_it++;
+      pending_shards.emplace_back(middle, last);
+      pending_shards.emplace_back(first, middle);
+      continue;
+    }
+
+    // The context is doubled each time, so that the header is never parsed
+    // with more of the preceding headers than needed; a parse that reaches
+    // the memory limit again ends the search
+    for (std::size_t context_size = 1U;
+         compiler_status.statusCode() ==
+             CompilerInstance::StatusCode::CompilationError &&
+         first != 0U;
+         context_size *= 2U) {
+      auto context_first = first - std::min(context_size, first);
+
+      StringList context_headers(
+          include_list.begin() + static_cast<std::ptrdiff_t>(context_first),
+          include_list.begin() + static_cast<std::ptrdiff_t>(last));
+
+      compiler_status =
+          collectFunctions(collected_functions, compiler, context_headers,
+                           base_includes, name_mangling_scheme_count);
+
+      if (context_first == 0U) {
+        break;
       }
     }
 
-    if (previous_active_header_count == active_include_headers.size()) {
-      break;
+    if (compiler_status.succeeded()) {
+      ++shard_count;
+      continue;
     }
+
+    log << "Skipping " << include_list.at(first)
+        << " in the sharded analysis: " << compiler_status.toString() << "\n";
+
+    ++skipped_header_count;
+  }
+
+  log << "Analyzed " << include_list.size() - skipped_header_count << "/"
+      << include_list.size() << " headers using " << shard_count
+      << " shards\n\n";
+
+  mergeShardFunctions(collected_functions);
+
+  return skipped_header_count == 0U;
+}
+
+/// Generates the ABI library for the profile selected in the given options;
+/// the header list is consumed while probing
+bool generateProfileABILibrary(std::vector<HeaderDescriptor> header_files,
+                               ProfileManagerRef &profile_manager,
+                               const LanguageManager &language_manager,
+                               const CommandLineOptions &cmdline_options,
+                               std::ostream &log) {
+  // Allocate a new compiler instance
+  CompilerInstanceRef compiler;
+  if (!createCompilerInstance(compiler, profile_manager, language_manager,
+                              cmdline_options, log)) {
+    return false;
   }
 
-  std::cerr << "\n";
+  // Attempt to include as many headers as possible; we do not care about the
+  // AST right now! Just try to pass the compilation
+  log << "Processed headers\n\n";
+
+  HeaderCostReport cost_report;
+  auto active_include_headers = probeIncludeHeaders(
+      *compiler.get(), header_files, cmdline_options.base_includes, log,
+      cmdline_options.save_header_report ? &cost_report : nullptr,
+      !cmdline_options.disable_conflict_prediction);
+
+  log << "\n";
+
+  // The report is saved next to the ABI library, before the final parse so
+  // that it is available even if the generation fails
+  if (cmdline_options.save_header_report) {
+    auto report_path = cmdline_options.output + ".header_report";
+
+    if (!saveHeaderCostReport(report_path + ".txt", cost_report) ||
+        !saveHeaderCostReportAsJSON(report_path + ".json", cost_report)) {
+      log << "Failed to save the header report: " << report_path << "\n";
+      return false;
+    }
+
+    log << "Header report saved to " << report_path << ".{txt,json}\n\n";
+  }
 
   // Print a list of the headers we couldn't import
   if (!header_files.empty()) {
-    std::cerr << "Discarded headers\n\n";
+    log << "Discarded headers\n\n";
     for (const auto &header : header_files) {
-      std::cerr << "  {\"";
+      log << "  {\"";
       for (auto it = header.possible_prefixes.begin();
            it != header.possible_prefixes.end(); it++) {
-        std::cerr << (*it);
+        log << (*it);
         if (std::next(it, 1) != header.possible_prefixes.end()) {
-          std::cerr << ", ";
+          log << ", ";
         }
       }
-      std::cerr << "\"} " << header.name << "\n";
+      log << "\"} " << header.name << "\n";
     }
-    std::cerr << "\n";
+    log << "\n";
   }
 
-  // We now have a list of includes that work fine; enable the AST callbacks
-  IASTVisitorRef visitor_ref;
-  auto visitor_status = ASTVisitor::create(visitor_ref);
-  if (!visitor_status.succeeded()) {
-    std::cerr << "Failed to create the ASTVisitor object: "
-              << visitor_status.toString() << "\n";
+  NameManglingSchemeList name_mangling_schemes;
+  if (!getNameManglingSchemes(name_mangling_schemes, cmdline_options)) {
+    log << "Invalid name mangling scheme\n";
     return false;
   }
 
-  // Compile the source buffer one last time with our ASTVisitor enabled
-  auto source_buffer = generateSourceBuffer(active_include_headers,
-                                            cmdline_options.base_includes);
+  // We now have a list of includes that work fine; compile the source buffer
+  // one last time with the AST callbacks enabled. The sharded analysis is
+  // used if the AST of this parse goes above the memory limit
+  bool use_sharding = false;
 
-  auto compiler_status = compiler->processAST(source_buffer, visitor_ref);
-  if (!compiler_status.succeeded()) {
-    std::cerr << compiler_status.toString() << "\n";
-    return false;
+  CollectedFunctions collected_functions;
+  IncludeGraph include_graph;
+
+  {
+    TraceScope trace_scope("generate", "final parse");
+
+    auto compiler_status = collectFunctions(
+        collected_functions, *compiler.get(), active_include_headers,
+        cmdline_options.base_includes, name_mangling_schemes.size(),
+        &include_graph);
+
+    if (compiler_status.statusCode() ==
+        CompilerInstance::StatusCode::MemoryLimitExceeded) {
+      use_sharding = true;
+
+    } else if (!compiler_status.succeeded()) {
+      log << compiler_status.toString() << "\n";
+      return false;
+    }
   }
 
-  // Render the ABI library
+  // The include graph is not recorded by the shards, so the include list is
+  // not reduced in this mode
+  if (use_sharding) {
+    log << "The memory limit has been reached; switching to the sharded "
+           "analysis\n\n";
+
+    collected_functions = {};
+    include_graph = {};
+
+    TraceScope trace_scope("generate", "sharded parse");
+
+    if (!collectShardedFunctions(collected_functions, *compiler.get(),
+                                 active_include_headers,
+                                 cmdline_options.base_includes,
+                                 name_mangling_schemes.size(), log)) {
+      log << "The sharded analysis has failed\n";
+      return false;
+    }
+  }
+
+  // Render one ABI library for each name mangling scheme
   Profile profile;
   auto prof_mgr_status =
       profile_manager->get(profile, cmdline_options.profile_name);
 
   assert(prof_mgr_status.succeeded());
 
-  ABILibrary abi_library;
-  abi_library.blacklisted_function_list = visitor_ref->blacklistedFunctions();
-  abi_library.whitelisted_function_list = visitor_ref->whitelistedFunctions();
-  abi_library.header_list = active_include_headers;
+  collected_functions.blacklisted_function_lists.resize(
+      name_mangling_schemes.size());
+  collected_functions.whitelisted_function_lists.resize(
+      name_mangling_schemes.size());
+
+  // Only emit the headers that are not already pulled in by the previous
+  // ones
+  auto header_list = computeMinimalIncludeList(
+      active_include_headers, cmdline_options.base_includes, include_graph);
+
+  if (header_list.size() != active_include_headers.size()) {
+    log << "Reduced the include list from " << active_include_headers.size()
+        << " to " << header_list.size() << " headers\n\n";
+  }
+
+  for (std::size_t i = 0U; i < name_mangling_schemes.size(); ++i) {
+    ABILibrary abi_library;
+    abi_library.blacklisted_function_list =
+        std::move(collected_functions.blacklisted_function_lists.at(i));
+    abi_library.whitelisted_function_list =
+        std::move(collected_functions.whitelisted_function_lists.at(i));
+    abi_library.header_list = header_list;
+
+    auto abi_library_options = cmdline_options;
+    abi_library_options.output = getNameManglingSchemeOutputPath(
+        cmdline_options.output, name_mangling_schemes, i);
+
+    TraceScope trace_scope("generate", "emission");
+    trace_scope.addArgument("output", abi_library_options.output);
+
+    auto status =
+        generateABILibrary(abi_library_options, abi_library, profile, log);
+    if (!status.succeeded()) {
+      log << status.message() << "\n";
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/// A single generation request; either the command line itself, or one of
+/// the jobs listed in a manifest file
+struct GenerateJob final {
+  /// The job name, used in the logs and in the summary
+  std::string name;
+
+  /// The options used by this job
+  CommandLineOptions options;
+};
+
+/// Returns the prefix used for the log messages related to the given job
+std::string getJobLogPrefix(const GenerateJob &job) {
+  return job.name.empty() ? std::string() : job.name + ": ";
+}
+
+/// An ABI library to generate: a job paired with one of its profiles
+struct GenerateTask final {
+  /// The job this task belongs to
+  std::size_t job_index{0U};
 
-  auto status = generateABILibrary(cmdline_options, abi_library, profile);
-  if (!status.succeeded()) {
-    std::cerr << status.message() << "\n";
+  /// The job options, with the profile name and the output path of this task
+  CommandLineOptions options;
+
+  /// The include files found in the job header folders; shared with the
+  /// other tasks using the same folders
+  const std::vector<HeaderDescriptor> *header_files{nullptr};
+};
+
+/// Loads the generate jobs listed in the manifest file specified on the
+/// command line. Each job starts from the command line options, and can
+/// override the following ones:
+///
+///   {
+///     "jobs": [
+///       {
+///         "name": "libc",
+///         "header-folders": ["include"],
+///         "output": "output/libc",
+///         "language": "c11",
+///         "base-includes": ["stddef.h"],
+///         "include-search-paths": [],
+///         "profiles": ["Ubuntu 18.04.1 LTS"],
+///         "enable-gnu-extensions": false,
+///         "name-mangling": ["itanium"]
+///       }
+///     ]
+///   }
+///
+/// Only "header-folders" and "output" are mandatory; relative paths are
+/// resolved against the folder containing the manifest
+bool loadGenerateManifest(std::vector<GenerateJob> &job_list,
+                          const CommandLineOptions &cmdline_options) {
+  job_list.clear();
+
+  std::ifstream manifest_file(cmdline_options.manifest_path);
+  if (!manifest_file) {
+    std::cerr << "Failed to open the manifest file: "
+              << cmdline_options.manifest_path << "\n";
     return false;
   }
 
+  std::string manifest_buffer((std::istreambuf_iterator<char>(manifest_file)),
+                              std::istreambuf_iterator<char>());
+
+  std::string error_messages;
+  auto manifest = json11::Json::parse(manifest_buffer, error_messages);
+  if (!manifest["jobs"].is_array() || manifest["jobs"].array_items().empty()) {
+    std::cerr << "Invalid manifest file: " << cmdline_options.manifest_path
+              << "\n";
+    if (!error_messages.empty()) {
+      std::cerr << error_messages << "\n";
+    }
+
+    return false;
+  }
+
+  std::error_code error;
+  auto manifest_folder =
+      stdfs::absolute(cmdline_options.manifest_path, error).parent_path();
+
+  auto L_getPath = [&manifest_folder](const std::string &path) -> std::string {
+    return (manifest_folder / path).lexically_normal().string();
+  };
+
+  auto L_getStringList = [](StringList &string_list,
+                            const json11::Json &value) -> bool {
+    string_list.clear();
+
+    if (!value.is_array()) {
+      return false;
+    }
+
+    for (const auto &item : value.array_items()) {
+      if (!item.is_string()) {
+        return false;
+      }
+
+      string_list.push_back(item.string_value());
+    }
+
+    return true;
+  };
+
+  const auto &job_items = manifest["jobs"].array_items();
+  for (std::size_t i = 0U; i < job_items.size(); ++i) {
+    const auto &item = job_items.at(i);
+
+    GenerateJob job;
+    job.options = cmdline_options;
+    job.name = item["name"].is_string() ? item["name"].string_value()
+                                        : "#" + std::to_string(i + 1U);
+
+    auto L_invalidJob = [&job](const std::string &message) -> bool {
+      std::cerr << "Invalid manifest job " << job.name << ": " << message
+                << "\n";
+      return false;
+    };
+
+    StringList header_folders;
+    if (!L_getStringList(header_folders, item["header-folders"]) ||
+        header_folders.empty()) {
+      return L_invalidJob("the header-folders list is missing");
+    }
+
+    job.options.header_folders.clear();
+    for (const auto &folder : header_folders) {
+      job.options.header_folders.push_back(L_getPath(folder));
+    }
+
+    if (!item["output"].is_string() || item["output"].string_value().empty()) {
+      return L_invalidJob("the output path is missing");
+    }
+
+    job.options.output = L_getPath(item["output"].string_value());
+
+    if (!item["language"].is_null()) {
+      if (!item["language"].is_string()) {
+        return L_invalidJob("the language must be a string");
+      }
+
+      job.options.language = item["language"].string_value();
+    }
+
+    if (job.options.language.empty()) {
+      return L_invalidJob("no language has been specified");
+    }
+
+    if (!item["base-includes"].is_null() &&
+        !L_getStringList(job.options.base_includes, item["base-includes"])) {
+      return L_invalidJob("base-includes must be a list of strings");
+    }
+
+    if (!item["include-search-paths"].is_null()) {
+      StringList include_folders;
+      if (!L_getStringList(include_folders, item["include-search-paths"])) {
+        return L_invalidJob("include-search-paths must be a list of strings");
+      }
+
+      job.options.additional_include_folders.clear();
+      for (const auto &folder : include_folders) {
+        job.options.additional_include_folders.push_back(L_getPath(folder));
+      }
+    }
+
+    if (!item["profiles"].is_null()) {
+      if (!L_getStringList(job.options.profile_names, item["profiles"])) {
+        return L_invalidJob("profiles must be a list of strings");
+      }
+
+      job.options.all_profiles = false;
+    }
+
+    if (!item["enable-gnu-extensions"].is_null()) {
+      if (!item["enable-gnu-extensions"].is_bool()) {
+        return L_invalidJob("enable-gnu-extensions must be a boolean");
+      }
+
+      job.options.enable_gnu_extensions =
+          item["enable-gnu-extensions"].bool_value();
+    }
+
+    if (!item["name-mangling"].is_null() &&
+        !L_getStringList(job.options.name_mangling_schemes,
+                         item["name-mangling"])) {
+      return L_invalidJob("name-mangling must be a list of strings");
+    }
+
+    job_list.push_back(job);
+  }
+
   return true;
 }
+
+/// Prints the status of each task, grouped by job
+void printGenerateSummary(const std::vector<GenerateJob> &job_list,
+                          const std::vector<GenerateTask> &task_list,
+                          const std::vector<bool> &task_results) {
+  std::size_t succeeded_task_count = 0U;
+
+  std::cerr << "Summary\n\n";
+
+  for (std::size_t i = 0U; i < task_list.size(); ++i) {
+    const auto &task = task_list.at(i);
+    const auto &job = job_list.at(task.job_index);
+
+    bool succeeded = task_results.at(i);
+    if (succeeded) {
+      ++succeeded_task_count;
+    }
+
+    std::cerr << "  " << (succeeded ? "[ OK ] " : "[FAIL] ")
+              << getJobLogPrefix(job) << task.options.profile_name << " -> "
+              << task.options.output << "\n";
+  }
+
+  std::cerr << "\n"
+            << succeeded_task_count << " of " << task_list.size()
+            << " ABI libraries have been generated\n";
+}
+
+/// Runs the generate command
+bool runGenerateCommand(ProfileManagerRef &profile_manager,
+                        const LanguageManager &language_manager,
+                        const CommandLineOptions &cmdline_options) {
+  std::vector<GenerateJob> job_list;
+
+  bool use_manifest = !cmdline_options.manifest_path.empty();
+  if (use_manifest) {
+    if (!loadGenerateManifest(job_list, cmdline_options)) {
+      return false;
+    }
+
+  } else {
+    if (cmdline_options.header_folders.empty() ||
+        cmdline_options.output.empty() || cmdline_options.language.empty()) {
+      std::cerr << "The --header-folders, --output and --language options "
+                   "are required when --manifest is not used\n";
+      return false;
+    }
+
+    GenerateJob job;
+    job.options = cmdline_options;
+    job_list.push_back(job);
+  }
+
+  // Validate all the jobs before starting, so that a typo in the last one
+  // does not waste the time spent on the previous ones
+  std::vector<GenerateTask> task_list;
+
+  // Maps each output path to the task writing it; two tasks sharing the same
+  // output would overwrite (or, when running concurrently, corrupt) each
+  // other's files
+  std::map<std::string, std::string> output_owners;
+
+  for (std::size_t job_index = 0U; job_index < job_list.size(); ++job_index) {
+    const auto &job = job_list.at(job_index);
+
+    Language language;
+    int language_standard;
+    if (!language_manager.parseLanguageDefinition(
+            language, language_standard, job.options.language)) {
+      std::cerr << getJobLogPrefix(job)
+                << "Invalid language: " << job.options.language << "\n";
+      return false;
+    }
+
+    NameManglingSchemeList name_mangling_schemes;
+    if (!getNameManglingSchemes(name_mangling_schemes, job.options)) {
+      std::cerr << getJobLogPrefix(job) << "Invalid name mangling scheme\n";
+      return false;
+    }
+
+    StringList profile_names;
+    if (!getGenerateProfileNames(profile_names, profile_manager,
+                                 job.options)) {
+      return false;
+    }
+
+    for (const auto &profile_name : profile_names) {
+      Profile profile;
+      auto status = profile_manager->get(profile, profile_name);
+      if (!status.succeeded()) {
+        std::cerr << getJobLogPrefix(job) << status.message() << "\n";
+        return false;
+      }
+
+      GenerateTask task;
+      task.job_index = job_index;
+      task.options = job.options;
+      task.options.profile_name = profile_name;
+
+      // Each ABI library is saved inside a folder named after its profile
+      // when the job has more than one
+      if (profile_names.size() > 1U &&
+          !getProfileOutputPath(task.options.output, job.options.output,
+                                profile_name)) {
+        std::cerr << getJobLogPrefix(job)
+                  << "Failed to create the output folder for the following "
+                     "profile: "
+                  << profile_name << "\n";
+        return false;
+      }
+
+      auto task_description = getJobLogPrefix(job) + profile_name;
+
+      for (std::size_t i = 0U; i < name_mangling_schemes.size(); ++i) {
+        auto output_path = getNameManglingSchemeOutputPath(
+            task.options.output, name_mangling_schemes, i);
+
+        std::error_code error;
+        output_path =
+            stdfs::absolute(output_path, error).lexically_normal().string();
+
+        auto insert_status =
+            output_owners.insert({output_path, task_description});
+
+        if (!insert_status.second) {
+          std::cerr << "The output path " << output_path
+                    << " is used by both " << insert_status.first->second
+                    << " and " << task_description << "\n";
+          return false;
+        }
+      }
+
+      task_list.push_back(task);
+    }
+  }
+
+  // Enumerate the include files; the lists are shared by all the profiles
+  // and by the jobs using the same header folders
+  std::map<StringList, std::vector<HeaderDescriptor>> header_file_lists;
+
+  for (auto &task : task_list) {
+    const auto &header_folders = task.options.header_folders;
+
+    auto header_file_list_it = header_file_lists.find(header_folders);
+    if (header_file_list_it == header_file_lists.end()) {
+      TraceScope trace_scope("generate", "enumeration");
+
+      std::vector<HeaderDescriptor> header_files;
+      if (!enumerateIncludeFiles(header_files, header_folders)) {
+        return false;
+      }
+
+      header_file_list_it =
+          header_file_lists.insert({header_folders, std::move(header_files)})
+              .first;
+    }
+
+    task.header_files = &header_file_list_it->second;
+  }
+
+  if (task_list.size() == 1U) {
+    const auto &task = task_list.front();
+
+    auto succeeded =
+        generateProfileABILibrary(*task.header_files, profile_manager,
+                                  language_manager, task.options, std::cerr);
+
+    if (use_manifest) {
+      printGenerateSummary(job_list, task_list, {succeeded});
+    }
+
+    return succeeded;
+  }
+
+  // Process the tasks concurrently; the logs are printed once the task has
+  // been completed so that they do not get mixed
+  std::mutex log_mutex;
+  std::atomic_size_t next_task_index{0U};
+  std::vector<bool> task_results(task_list.size(), false);
+
+  auto L_worker = [&]() {
+    while (true) {
+      auto task_index = next_task_index++;
+      if (task_index >= task_list.size()) {
+        break;
+      }
+
+      const auto &task = task_list.at(task_index);
+
+      std::stringstream log;
+      auto succeeded =
+          generateProfileABILibrary(*task.header_files, profile_manager,
+                                    language_manager, task.options, log);
+
+      std::lock_guard<std::mutex> lock(log_mutex);
+      task_results[task_index] = succeeded;
+
+      if (use_manifest) {
+        std::cerr << "Job: " << job_list.at(task.job_index).name << "\n";
+      }
+
+      std::cerr << "Profile: " << task.options.profile_name << "\n\n"
+                << log.str();
+
+      if (!succeeded) {
+        std::cerr << "Failed to generate the ABI library\n";
+      }
+
+      std::cerr << "\n";
+    }
+  };
+
+  auto worker_count =
+      std::min(getJobCount(cmdline_options), task_list.size());
+
+  std::vector<std::thread> worker_list;
+  for (std::size_t i = 0U; i < worker_count; ++i) {
+    worker_list.emplace_back(L_worker);
+  }
+
+  for (auto &worker : worker_list) {
+    worker.join();
+  }
+
+  if (use_manifest) {
+    printGenerateSummary(job_list, task_list, task_results);
+  }
+
+  return std::find(task_results.begin(), task_results.end(), false) ==
+         task_results.end();
+}
+}  // namespace
+
+/// Handler for the 'generate' command
+bool generateCommandHandler(ProfileManagerRef &profile_manager,
+                            const LanguageManager &language_manager,
+                            const CommandLineOptions &cmdline_options) {
+  // The serve command runs many requests in the same process, so nothing
+  // recorded by a previous one must end up in the statistics
+  resetTracing();
+
+  bool tracing_requested =
+      cmdline_options.print_statistics || !cmdline_options.trace_file.empty();
+
+  if (tracing_requested) {
+    enableTracing();
+  }
+
+  bool succeeded = false;
+
+  {
+    TraceScope trace_scope("generate", "generate");
+    succeeded =
+        runGenerateCommand(profile_manager, language_manager, cmdline_options);
+  }
+
+  if (cmdline_options.print_statistics) {
+    printTraceStatistics(std::cerr);
+  }
+
+  if (!cmdline_options.trace_file.empty() &&
+      !saveTraceFile(cmdline_options.trace_file)) {
+    std::cerr << "Failed to save the trace file: " << cmdline_options.trace_file
+              << "\n";
+
+    succeeded = false;
+  }
+
+  resetTracing();
+  return succeeded;
+}
@@ -1,11 +1,37 @@
 #include "generate_utils.h"
+#include "declarationscanner.h"
+#include "directorywalker.h"
+#include "headermap.h"
+#include "modulemap.h"
+#include "precompiledheader.h"
+#include "profilefilesystem.h"
+#include "profilestorage.h"
 #include "std_filesystem.h"
+#include "tracing.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 
 #include <clang/AST/Decl.h>
+#include <clang/AST/DeclGroup.h>
 #include <clang/AST/Mangle.h>
+#include <clang/Basic/Diagnostic.h>
+#include <clang/Basic/TargetInfo.h>
+#include <clang/Lex/HeaderSearch.h>
+#include <clang/Lex/PPCallbacks.h>
 #include <clang/Lex/Preprocessor.h>
 #include <clang/Lex/PreprocessorOptions.h>
 
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Host.h>
+
 namespace {
 #if LLVM_MAJOR_VERSION <= 4
 const auto kClangFrontendInputKindCxx = clang::IK_CXX;
@@ -15,203 +41,1339 @@ const auto kClangFrontendInputKindCxx = clang::InputKind::CXX;
 const auto kClangFrontendInputKindC = clang::InputKind::C;
 #endif
 
-/// The ASTConsumer is used to instantiate the ASTVisitor for each translation
-/// unit
-class ASTConsumer final : public clang::ASTConsumer {
-  /// The source manager, used to obtain the location (SourceLocation) of each
-  /// declaration
-  clang::SourceManager &source_manager;
+/// How many top level declarations are parsed between two checks of the
+/// memory limit; summing the size of the AST allocator slabs is not free
+const std::size_t kMemoryLimitCheckInterval = 256U;
+
+/// The name manglers owned by the ASTConsumer
+using NameManglerRefList = std::vector<std::unique_ptr<clang::MangleContext>>;
+
+/// The ASTConsumer is used to instantiate the ASTVisitor for each translation
+/// unit
+class ASTConsumer final : public clang::ASTConsumer {
+  /// The source manager, used to obtain the location (SourceLocation) of each
+  /// declaration
+  clang::SourceManager &source_manager;
+
+  /// The user ASTVisitor
+  IASTVisitorRef ast_visitor;
+
+  /// The manglers used for C++ symbols, one for each name mangling scheme
+  NameManglerRefList name_manglers;
+
+  /// The AST size above which the parse is stopped; zero means no limit
+  std::uint64_t memory_limit{0U};
+
+  /// Where the memory limit flag is reported; may be null
+  ParseStatistics *statistics{nullptr};
+
+  /// The context of the translation unit being parsed
+  clang::ASTContext *ast_context{nullptr};
+
+  /// How many top level declarations have been parsed so far
+  std::size_t top_level_decl_count{0U};
+
+  /// Returns true (and sets the memory limit flag) if the AST of this parse
+  /// is above the limit. The resident set size is not used, since it is
+  /// shared by every job running in this process
+  bool isMemoryLimitExceeded(const clang::ASTContext &context) {
+    if (memory_limit == 0U || statistics == nullptr) {
+      return false;
+    }
+
+    auto ast_bytes =
+        static_cast<std::uint64_t>(context.getASTAllocatedMemory() +
+                                   context.getSideTableAllocatedMemory());
+
+    if (ast_bytes <= memory_limit) {
+      return false;
+    }
+
+    statistics->memory_limit_exceeded = true;
+    return true;
+  }
+
+  /// Attaches the visitor container sizes to the given trace event
+  void traceContainerSizes(TraceScope &trace_scope) const {
+    if (!isTracingEnabled()) {
+      return;
+    }
+
+    for (const auto &p : ast_visitor->containerSizes()) {
+      trace_scope.addArgument(p.first, static_cast<std::int64_t>(p.second));
+    }
+  }
+
+ public:
+  ASTConsumer(clang::SourceManager &source_manager, IASTVisitorRef ast_visitor,
+              NameManglerRefList name_manglers, std::uint64_t memory_limit,
+              ParseStatistics *statistics)
+      : source_manager(source_manager),
+        ast_visitor(ast_visitor),
+        name_manglers(std::move(name_manglers)),
+        memory_limit(memory_limit),
+        statistics(statistics) {}
+
+  virtual ~ASTConsumer() override = default;
+
+  virtual void Initialize(clang::ASTContext &context) override {
+    ast_context = &context;
+    top_level_decl_count = 0U;
+  }
+
+  /// Stops the parse as soon as the AST goes above the memory limit, so that
+  /// the caller can switch to the sharded analysis before running out of
+  /// memory. Only the parses that run the visitor are limited
+  virtual bool HandleTopLevelDecl(clang::DeclGroupRef decl_group) override {
+    static_cast<void>(decl_group);
+
+    if (!ast_visitor || ast_context == nullptr) {
+      return true;
+    }
+
+    ++top_level_decl_count;
+    if (top_level_decl_count % kMemoryLimitCheckInterval != 0U) {
+      return true;
+    }
+
+    return !isMemoryLimitExceeded(*ast_context);
+  }
+
+  virtual void HandleTranslationUnit(clang::ASTContext &ast_context) override {
+    if (!ast_visitor) {
+      return;
+    }
+
+    NameManglerList name_mangler_list;
+    for (const auto &name_mangler : name_manglers) {
+      name_mangler_list.push_back(name_mangler.get());
+    }
+
+    {
+      TraceScope trace_scope("visitor", "visitor collect");
+
+      ast_visitor->initialize(&ast_context, &source_manager,
+                              name_mangler_list);
+      ast_visitor->TraverseDecl(ast_context.getTranslationUnitDecl());
+
+      traceContainerSizes(trace_scope);
+    }
+
+    // Finalizing the visitor is what allocates the most memory on top of the
+    // AST; stop here if the last declarations pushed it above the limit
+    if (isMemoryLimitExceeded(ast_context)) {
+      return;
+    }
+
+    TraceScope trace_scope("visitor", "visitor finalize");
+    ast_visitor->finalize();
+
+    traceContainerSizes(trace_scope);
+  }
+};
+
+/// The language options, the target information and the predefined macros
+/// shared by all the compiler instances using the same target, language,
+/// language standard and GNU mode. The builtins are not part of this, since
+/// they are registered inside the identifier table owned by each
+/// preprocessor
+struct CompilerConfiguration final {
+  /// The language options
+  clang::LangOptions language_options;
+
+  /// The target information; it is never modified once created
+  llvm::IntrusiveRefCntPtr<clang::TargetInfo> target_information;
+
+  /// The predefined macros buffer; empty until the first preprocessor using
+  /// this configuration has been created
+  std::string predefines;
+};
+
+/// A reference to a CompilerConfiguration object
+using CompilerConfigurationRef = std::shared_ptr<CompilerConfiguration>;
+
+/// Returns the compiler configuration cache for the calling thread. The
+/// cache is not shared across threads because the TargetInfo reference
+/// count is not atomic
+std::unordered_map<std::string, CompilerConfigurationRef> &
+getCompilerConfigurationCache() {
+  static thread_local std::unordered_map<std::string, CompilerConfigurationRef>
+      cache;
+
+  return cache;
+}
+
+/// The preprocessor callbacks used to record the include graph; the
+/// directives of the main file are seen by InclusionDirective, and every
+/// file that is actually entered by FileChanged
+class IncludeGraphRecorder final : public clang::PPCallbacks {
+  /// The source manager, used to find the file containing each directive
+  clang::SourceManager &source_manager;
+
+  /// The header search object, used to find the guarded files
+  clang::HeaderSearch &header_search;
+
+  /// Where the include graph is saved
+  IncludeGraph &include_graph;
+
+  /// Every file that has been included
+  std::unordered_set<const clang::FileEntry *> included_files;
+
+ public:
+  IncludeGraphRecorder(clang::SourceManager &source_manager,
+                       clang::HeaderSearch &header_search,
+                       IncludeGraph &include_graph)
+      : source_manager(source_manager),
+        header_search(header_search),
+        include_graph(include_graph) {}
+
+  virtual ~IncludeGraphRecorder() override = default;
+
+#if LLVM_MAJOR_VERSION >= 7
+  virtual void InclusionDirective(
+      clang::SourceLocation hash_location, const clang::Token &include_token,
+      llvm::StringRef file_name, bool is_angled,
+      clang::CharSourceRange filename_range, const clang::FileEntry *file,
+      llvm::StringRef search_path, llvm::StringRef relative_path,
+      const clang::Module *imported,
+      clang::SrcMgr::CharacteristicKind file_type) override {
+    static_cast<void>(file_type);
+#else
+  virtual void InclusionDirective(
+      clang::SourceLocation hash_location, const clang::Token &include_token,
+      llvm::StringRef file_name, bool is_angled,
+      clang::CharSourceRange filename_range, const clang::FileEntry *file,
+      llvm::StringRef search_path, llvm::StringRef relative_path,
+      const clang::Module *imported) override {
+#endif
+    static_cast<void>(include_token);
+    static_cast<void>(is_angled);
+    static_cast<void>(filename_range);
+    static_cast<void>(search_path);
+    static_cast<void>(relative_path);
+    static_cast<void>(imported);
+
+    IncludeGraph::IncludeDirective directive;
+    directive.file_name = file_name.str();
+
+    if (file != nullptr) {
+      directive.path = file->getName();
+      included_files.insert(file);
+    }
+
+    auto file_id = source_manager.getFileID(hash_location);
+    if (file_id == source_manager.getMainFileID()) {
+      include_graph.main_file_includes.push_back(std::move(directive));
+    }
+  }
+
+  /// Records an edge from the includer to each inclusion; the FileID of the
+  /// includer tells apart the different inclusions of the same file
+  virtual void FileChanged(clang::SourceLocation location,
+                           FileChangeReason reason,
+                           clang::SrcMgr::CharacteristicKind file_type,
+                           clang::FileID previous_file_id) override {
+    static_cast<void>(file_type);
+    static_cast<void>(previous_file_id);
+
+    if (reason != FileChangeReason::EnterFile) {
+      return;
+    }
+
+    auto file_id = source_manager.getFileID(location);
+    const auto file = source_manager.getFileEntryForID(file_id);
+    if (file == nullptr) {
+      return;
+    }
+
+    auto includer_file_id =
+        source_manager.getFileID(source_manager.getIncludeLoc(file_id));
+
+    if (includer_file_id.isInvalid()) {
+      return;
+    }
+
+    auto inclusion = file_id.getHashValue();
+    include_graph.inclusion_paths[inclusion] = file->getName();
+
+    // Directives are always followed by the inclusion they start, if any
+    if (includer_file_id == source_manager.getMainFileID()) {
+      auto &main_file_includes = include_graph.main_file_includes;
+      if (!main_file_includes.empty() &&
+          main_file_includes.back().inclusion == 0U) {
+        main_file_includes.back().inclusion = inclusion;
+      }
+
+      return;
+    }
+
+    include_graph.edges[includer_file_id.getHashValue()].push_back(
+        inclusion);
+  }
+
+  /// The include guards are only known once each file has been lexed
+  virtual void EndOfMainFile() override {
+    for (const auto file : included_files) {
+      if (header_search.isFileMultipleIncludeGuarded(file)) {
+        include_graph.guarded_files.insert(file->getName());
+      }
+    }
+  }
+};
+
+/// Removes the headers that can be reached through more than one path (i.e.:
+/// symbolic links), and the ones with the same contents of a header that
+/// comes before them in the list; returns how many headers have been removed
+std::size_t removeDuplicateHeaders(
+    std::vector<HeaderDescriptor> &header_files) {
+  std::vector<HeaderDescriptor> unique_header_files;
+  std::vector<std::uintmax_t> file_sizes;
+
+  std::unordered_set<std::string> real_path_list;
+  std::unordered_map<std::uintmax_t, std::size_t> file_size_count;
+
+  for (auto &header : header_files) {
+    std::error_code error;
+    auto real_path = stdfs::canonical(header.path, error);
+    if (!error && !real_path_list.insert(real_path.string()).second) {
+      continue;
+    }
+
+    auto file_size = stdfs::file_size(header.path, error);
+    if (error) {
+      file_size = static_cast<std::uintmax_t>(-1);
+    } else {
+      ++file_size_count[file_size];
+    }
+
+    unique_header_files.push_back(std::move(header));
+    file_sizes.push_back(file_size);
+  }
+
+  // Only the files sharing their size with another one have to be hashed
+  std::unordered_set<std::string> content_hash_list;
+  std::vector<HeaderDescriptor> output;
+
+  for (std::size_t i = 0U; i < unique_header_files.size(); ++i) {
+    auto &header = unique_header_files.at(i);
+
+    auto file_size_it = file_size_count.find(file_sizes.at(i));
+    if (file_size_it != file_size_count.end() && file_size_it->second > 1U) {
+      std::ifstream header_file(header.path, std::ios::binary);
+      std::string contents((std::istreambuf_iterator<char>(header_file)),
+                           std::istreambuf_iterator<char>());
+
+      if (header_file.good() || header_file.eof()) {
+        auto content_hash = getContentHash(contents);
+        if (!content_hash_list.insert(content_hash).second) {
+          continue;
+        }
+      }
+    }
+
+    output.push_back(std::move(header));
+  }
+
+  auto duplicate_count = header_files.size() - output.size();
+  header_files = std::move(output);
+
+  return duplicate_count;
+}
+
+/// What prevented a header from being included, according to the first
+/// error reported by the compiler
+struct ProbeBlocker final {
+  /// The supported blocker kinds
+  enum class Kind {
+    /// The error is not understood; the header is probed on every pass
+    Unknown,
+
+    /// An identifier or a type name has not been declared
+    MissingIdentifier,
+
+    /// An included file could not be found
+    MissingFile,
+
+    /// The header redefines something declared by the included headers;
+    /// since headers are never removed from the list, this can't be fixed
+    Conflict
+  };
+
+  /// The blocker kind
+  Kind kind{Kind::Unknown};
+
+  /// The missing identifier or file name
+  std::string name;
+};
+
+/// Returns the text enclosed by the first pair of single quotes found in
+/// the given message, or an empty string
+std::string getQuotedName(const std::string &message) {
+  auto name_start = message.find('\'');
+  if (name_start == std::string::npos) {
+    return std::string();
+  }
+
+  auto name_end = message.find('\'', name_start + 1U);
+  if (name_end == std::string::npos) {
+    return std::string();
+  }
+
+  return message.substr(name_start + 1U, name_end - name_start - 1U);
+}
+
+/// Classifies the given compiler error; the location prefix is ignored
+ProbeBlocker getProbeBlocker(const std::string &compiler_error) {
+  static const std::string kErrorMarker = "error: ";
+
+  static const StringList kMissingIdentifierMessages = {
+      "unknown type name ", "use of undeclared identifier ",
+      "implicit declaration of function ", "call to undeclared function "};
+
+  static const StringList kConflictMessages = {
+      "redefinition of ", "typedef redefinition ", "conflicting types for "};
+
+  ProbeBlocker blocker;
+
+  auto marker_position = compiler_error.find(kErrorMarker);
+  if (marker_position == std::string::npos) {
+    return blocker;
+  }
+
+  auto message = compiler_error.substr(marker_position + kErrorMarker.size());
+
+  auto L_startsWithAnyOf = [&message](const StringList &prefix_list) -> bool {
+    for (const auto &prefix : prefix_list) {
+      if (message.compare(0U, prefix.size(), prefix) == 0) {
+        return true;
+      }
+    }
+
+    return false;
+  };
+
+  if (L_startsWithAnyOf(kConflictMessages)) {
+    blocker.kind = ProbeBlocker::Kind::Conflict;
+
+  } else if (L_startsWithAnyOf(kMissingIdentifierMessages)) {
+    blocker.kind = ProbeBlocker::Kind::MissingIdentifier;
+    blocker.name = getQuotedName(message);
+
+  } else if (message.find("' file not found") != std::string::npos) {
+    blocker.kind = ProbeBlocker::Kind::MissingFile;
+    blocker.name = getQuotedName(message);
+  }
+
+  if (blocker.kind != ProbeBlocker::Kind::Conflict && blocker.name.empty()) {
+    blocker.kind = ProbeBlocker::Kind::Unknown;
+  }
+
+  return blocker;
+}
+
+/// Returns the key used to identify the given header while probing
+const std::string &getHeaderKey(const HeaderDescriptor &header_descriptor) {
+  return header_descriptor.path.empty() ? header_descriptor.name
+                                        : header_descriptor.path;
+}
+
+/// Returns true if both paths point to the same file
+bool isSameFile(const std::string &lhs, const std::string &rhs) {
+  if (lhs == rhs) {
+    return true;
+  }
+
+  // Files served by the profile storages do not exist on disk, and can
+  // only be compared by path
+  bool equivalent = false;
+  return !llvm::sys::fs::equivalent(lhs, rhs, equivalent) && equivalent;
+}
+
+/// Returns the first include directive that resolves to the given header,
+/// using the include search paths of the compiler instance; the other
+/// spellings would either not compile or pull in the same file
+bool getResolvedIncludeDirective(std::string &include_directive,
+                                 CompilerInstance &compiler,
+                                 const HeaderDescriptor &header_descriptor) {
+  include_directive.clear();
+
+  for (const auto &candidate : generateIncludeDirectives(header_descriptor)) {
+    std::string resolved_path;
+    if (!compiler.resolveIncludeDirective(resolved_path, candidate)) {
+      continue;
+    }
+
+    if (header_descriptor.path.empty() ||
+        isSameFile(resolved_path, header_descriptor.path)) {
+      include_directive = candidate;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/// A name defined by one of the headers that have already been included
+struct IncludedDefinition final {
+  /// The include directive of the header defining the name
+  std::string include_directive;
+
+  /// The definition
+  DeclarationIndexEntry entry;
+};
+
+/// A macro defined by one of the headers that have already been included
+struct IncludedMacro final {
+  /// The include directive of the header defining the macro
+  std::string include_directive;
+
+  /// The macro replacement list
+  std::string replacement;
+};
+}  // namespace
+
+SourceCodeLocation getSourceCodeLocation(clang::ASTContext &ast_context,
+                                         clang::SourceManager &source_manager,
+                                         const clang::Decl *declaration) {
+  auto start_location = declaration->getLocStart();
+  auto full_start_location = ast_context.getFullLoc(start_location);
+
+#if LLVM_MAJOR_VERSION > 5
+  static_cast<void>(source_manager);
+  const auto file_entry = full_start_location.getFileEntry();
+#else
+  auto file_id = full_start_location.getFileID();
+  const auto file_entry = source_manager.getFileEntryForID(file_id);
+#endif
+
+  SourceCodeLocation output;
+  if (file_entry != nullptr) {
+    output.file_path = file_entry->getName();
+  }
+
+  if (output.file_path.empty()) {
+    // This is the file we generated in memory for clang
+    output.file_path = "main.cpp";
+  }
+
+  output.line = full_start_location.getSpellingLineNumber();
+  output.column = full_start_location.getSpellingColumnNumber();
+
+  return output;
+}
+
+bool getCompilerInstanceSettings(CompilerInstanceSettings &compiler_settings,
+                                 ProfileManagerRef &profile_manager,
+                                 const LanguageManager &language_manager,
+                                 const CommandLineOptions &cmdline_options) {
+  compiler_settings = {};
+
+  auto prof_mgr_status = profile_manager->get(compiler_settings.profile,
+                                              cmdline_options.profile_name);
+  if (!prof_mgr_status.succeeded()) {
+    std::cerr << prof_mgr_status.toString() << "\n";
+    return false;
+  }
+
+  if (!language_manager.parseLanguageDefinition(
+          compiler_settings.language, compiler_settings.language_standard,
+          cmdline_options.language)) {
+    std::cerr << "Invalid language definition\n";
+    return false;
+  }
+
+  compiler_settings.enable_gnu_extensions =
+      cmdline_options.enable_gnu_extensions;
+
+  if (!getNameManglingSchemes(compiler_settings.name_mangling_schemes,
+                              cmdline_options)) {
+    std::cerr << "Invalid name mangling scheme\n";
+    return false;
+  }
+
+  compiler_settings.additional_include_folders = cmdline_options.header_folders;
+  compiler_settings.base_includes = cmdline_options.base_includes;
+  compiler_settings.use_header_maps = cmdline_options.use_header_maps;
+  compiler_settings.use_modules = cmdline_options.use_modules;
+  compiler_settings.memory_limit =
+      static_cast<std::uint64_t>(cmdline_options.memory_limit) * 1024U * 1024U;
+
+  return true;
+}
+
+bool createCompilerInstance(CompilerInstanceRef &compiler,
+                            ProfileManagerRef &profile_manager,
+                            const LanguageManager &language_manager,
+                            const CommandLineOptions &cmdline_options,
+                            std::ostream &log) {
+  CompilerInstanceSettings compiler_settings;
+  if (!getCompilerInstanceSettings(compiler_settings, profile_manager,
+                                   language_manager, cmdline_options)) {
+    return false;
+  }
+
+  // Precompile the base includes, so that they are not parsed again each
+  // time a header is tested; this is just an optimization, so errors are
+  // not fatal
+  if (!cmdline_options.disable_precompiled_header &&
+      !preparePrecompiledHeader(compiler_settings, false, log)) {
+    log << "Continuing without the precompiled header\n";
+  }
+
+  auto compiler_status = CompilerInstance::create(compiler, compiler_settings);
+  if (!compiler_status.succeeded()) {
+    log << compiler_status.toString() << "\n";
+    return false;
+  }
+
+  return true;
+}
+
+std::string getProfileTargetTriple(const Profile &profile) {
+  if (!profile.target_triple.empty()) {
+    return profile.target_triple;
+  }
+
+  return llvm::sys::getDefaultTargetTriple();
+}
+
+std::size_t getJobCount(const CommandLineOptions &cmdline_options) {
+  if (cmdline_options.job_count != 0U) {
+    return cmdline_options.job_count;
+  }
+
+  auto hardware_thread_count =
+      static_cast<std::size_t>(std::thread::hardware_concurrency());
+
+  return std::max(hardware_thread_count, static_cast<std::size_t>(1U));
+}
+
+bool getNameManglingSchemes(NameManglingSchemeList &name_mangling_schemes,
+                            const CommandLineOptions &cmdline_options) {
+  name_mangling_schemes.clear();
+
+  for (const auto &scheme_name : cmdline_options.name_mangling_schemes) {
+    NameManglingScheme scheme;
+    if (!parseNameManglingScheme(scheme, scheme_name)) {
+      return false;
+    }
+
+    if (std::find(name_mangling_schemes.begin(), name_mangling_schemes.end(),
+                  scheme) == name_mangling_schemes.end()) {
+      name_mangling_schemes.push_back(scheme);
+    }
+  }
+
+  if (cmdline_options.use_visual_cxx_mangling &&
+      std::find(name_mangling_schemes.begin(), name_mangling_schemes.end(),
+                NameManglingScheme::Microsoft) == name_mangling_schemes.end()) {
+    name_mangling_schemes.push_back(NameManglingScheme::Microsoft);
+  }
+
+  if (name_mangling_schemes.empty()) {
+    name_mangling_schemes.push_back(NameManglingScheme::Itanium);
+  }
+
+  return true;
+}
+
+bool parseNameManglingScheme(NameManglingScheme &scheme,
+                             const std::string &name) {
+  if (name == "itanium") {
+    scheme = NameManglingScheme::Itanium;
+    return true;
+
+  } else if (name == "microsoft") {
+    scheme = NameManglingScheme::Microsoft;
+    return true;
+  }
+
+  return false;
+}
+
+std::string getNameManglingSchemeName(NameManglingScheme scheme) {
+  switch (scheme) {
+    case NameManglingScheme::Itanium:
+      return "itanium";
+
+    case NameManglingScheme::Microsoft:
+      return "microsoft";
+  }
+
+  return "unknown";
+}
+
+bool parseCompileOutputFormat(CompileOutputFormat &output_format,
+                              const std::string &name) {
+  if (name == "bitcode") {
+    output_format = CompileOutputFormat::Bitcode;
+    return true;
+
+  } else if (name == "ir") {
+    output_format = CompileOutputFormat::TextualIR;
+    return true;
+
+  } else if (name == "object") {
+    output_format = CompileOutputFormat::Object;
+    return true;
+  }
+
+  return false;
+}
+
+bool enumerateIncludeFiles(std::vector<HeaderDescriptor> &header_files,
+                           const std::string &header_folder) {
+  const static StringList valid_extensions = {".h", ".hh", ".hp", ".hpp",
+                                              ".hxx"};
+
+  StringList file_list;
+  if (!enumerateFolderFiles(file_list, header_folder)) {
+    return false;
+  }
+
+  std::error_code error;
+  auto root_header_folder = stdfs::absolute(header_folder, error);
+  if (error) {
+    return false;
+  }
+
+  for (const auto &relative_path : file_list) {
+    stdfs::path path(relative_path);
+
+    const auto &ext = path.extension().string();
+    if (ext.empty() ||
+        std::find(valid_extensions.begin(), valid_extensions.end(), ext) ==
+            valid_extensions.end()) {
+      continue;
+    }
+
+    HeaderDescriptor header_desc = {};
+    header_desc.name = path.filename();
+    header_desc.path = (root_header_folder / path).lexically_normal().string();
+
+    for (auto parent_path = path.parent_path(); !parent_path.empty();
+         parent_path = parent_path.parent_path()) {
+      auto current_relative_path =
+          parent_path.filename() /
+          (header_desc.possible_prefixes.empty()
+               ? ""
+               : header_desc.possible_prefixes.back());
+      header_desc.possible_prefixes.push_back(current_relative_path.string());
+    }
+
+    header_files.push_back(header_desc);
+  }
+
+  return true;
+}
+
+bool enumerateIncludeFiles(std::vector<HeaderDescriptor> &header_files,
+                           const StringList &header_folders) {
+  header_files = {};
+
+  for (const auto &folder : header_folders) {
+    if (!enumerateIncludeFiles(header_files, folder)) {
+      std::cerr << "Failed to enumerate the include files in the following "
+                   "directory: "
+                << folder << "\n";
+
+      return false;
+    }
+  }
+
+  auto duplicate_count = removeDuplicateHeaders(header_files);
+  if (duplicate_count != 0U) {
+    std::cerr << "Skipping " << duplicate_count
+              << " duplicated header file(s)\n";
+  }
+
+  return true;
+}
+
+StringList generateIncludeDirectives(
+    const HeaderDescriptor &header_descriptor) {
+  StringList result = {header_descriptor.name};
+
+  for (const auto &prefix : header_descriptor.possible_prefixes) {
+    auto include_directive = stdfs::path(prefix) / header_descriptor.name;
+    result.emplace_back(include_directive);
+  }
+
+  return result;
+}
+
+std::string generateSourceBuffer(const StringList &include_list,
+                                 const StringList &base_includes) {
+  std::stringstream buffer;
+  for (const auto &include : base_includes) {
+    buffer << "#include <" << include << ">\n";
+  }
+
+  for (const auto &include : include_list) {
+    buffer << "#include <" << include << ">\n";
+  }
+
+  return buffer.str();
+}
+
+StringList probeIncludeHeaders(CompilerInstance &compiler,
+                               std::vector<HeaderDescriptor> &header_files,
+                               const StringList &base_includes,
+                               std::ostream &log,
+                               HeaderCostReport *cost_report,
+                               bool predict_conflicts) {
+  std::string total_header_count_str = std::to_string(header_files.size());
+  auto header_counter_digits = static_cast<int>(total_header_count_str.size());
+
+  StringList active_include_headers;
+
+  // The bytes loaded by the last successful probe; the cost of a header is
+  // measured against the headers that were already included
+  std::uint64_t active_loaded_bytes = 0U;
+
+  // The headers that failed with a known error, along with what blocked
+  // them. They are skipped until a newly included header provides the
+  // missing name, and headers with conflicts are never probed again
+  std::unordered_map<std::string, ProbeBlocker> blocked_headers;
+
+  // The watched names are the ones missing from the blocked headers; they
+  // are looked up by each successful probe
+  ParseStatistics parse_statistics;
+  bool update_watched_names = false;
+
+  auto L_updateWatchedNames = [&blocked_headers, &parse_statistics]() -> void {
+    std::unordered_set<std::string> identifier_set;
+    std::unordered_set<std::string> file_set;
+
+    for (const auto &p : blocked_headers) {
+      const auto &blocker = p.second;
+
+      if (blocker.kind == ProbeBlocker::Kind::MissingIdentifier) {
+        identifier_set.insert(blocker.name);
+
+      } else if (blocker.kind == ProbeBlocker::Kind::MissingFile) {
+        file_set.insert(blocker.name);
+      }
+    }
+
+    parse_statistics.watched_identifiers.assign(identifier_set.begin(),
+                                                identifier_set.end());
+
+    parse_statistics.watched_files.assign(file_set.begin(), file_set.end());
+  };
+
+  // Unblocks the headers waiting for one of the names found by the last
+  // successful probe
+  auto L_unblockHeaders = [&blocked_headers, &parse_statistics]() -> bool {
+    if (parse_statistics.found_identifiers.empty() &&
+        parse_statistics.found_files.empty()) {
+      return false;
+    }
+
+    std::unordered_set<std::string> found_identifiers(
+        parse_statistics.found_identifiers.begin(),
+        parse_statistics.found_identifiers.end());
+
+    std::unordered_set<std::string> found_files(
+        parse_statistics.found_files.begin(),
+        parse_statistics.found_files.end());
+
+    auto L_isResolved = [&found_identifiers,
+                         &found_files](const ProbeBlocker &blocker) -> bool {
+      if (blocker.kind == ProbeBlocker::Kind::MissingIdentifier) {
+        return found_identifiers.count(blocker.name) != 0U;
+
+      } else if (blocker.kind == ProbeBlocker::Kind::MissingFile) {
+        return found_files.count(blocker.name) != 0U;
+      }
+
+      return false;
+    };
+
+    bool unblocked = false;
+    for (auto it = blocked_headers.begin(); it != blocked_headers.end();) {
+      if (L_isResolved(it->second)) {
+        it = blocked_headers.erase(it);
+        unblocked = true;
+
+      } else {
+        ++it;
+      }
+    }
+
+    return unblocked;
+  };
+
+  // Resolve the include directives up front, so that each header is
+  // compiled at most once per pass; the headers that can't be reached
+  // through the include search paths are never probed
+  std::unordered_map<std::string, std::string> include_directive_map;
+  std::size_t unresolved_header_count = 0U;
+
+  {
+    TraceScope trace_scope("probe", "include resolution");
+
+    for (const auto &header_descriptor : header_files) {
+      const auto &header_key = getHeaderKey(header_descriptor);
+
+      std::string include_directive;
+      if (getResolvedIncludeDirective(include_directive, compiler,
+                                      header_descriptor)) {
+        include_directive_map.insert({header_key, include_directive});
+        continue;
+      }
+
+      ++unresolved_header_count;
+
+      if (cost_report != nullptr) {
+        auto &header_cost = (*cost_report)[header_key];
+        header_cost.name = header_descriptor.name;
+        header_cost.first_error =
+            "No include directive resolves to this header";
+      }
+    }
+  }
+
+  if (unresolved_header_count != 0U) {
+    log << "  " << unresolved_header_count
+        << " header(s) can't be reached through the include search "
+           "paths\n\n";
+  }
+
+  // Index the definitions of each header with the raw lexer, so that the
+  // headers redefining a name provided by an included header can be
+  // rejected without compiling them
+  std::unordered_map<std::string, HeaderDeclarationIndex> declaration_indexes;
+
+  if (predict_conflicts) {
+    TraceScope trace_scope("probe", "declaration scan");
+
+    auto language = compiler.settings().language;
+
+    for (const auto &header_descriptor : header_files) {
+      if (header_descriptor.path.empty()) {
+        continue;
+      }
+
+      HeaderDeclarationIndex declaration_index;
+      if (scanHeaderDeclarations(declaration_index, header_descriptor.path,
+                                 language)) {
+        declaration_indexes.insert(
+            {header_descriptor.path, std::move(declaration_index)});
+      }
+    }
+  }
+
+  std::unordered_map<std::string, IncludedDefinition> included_definitions;
+  std::unordered_map<std::string, IncludedMacro> included_macros;
+  std::unordered_set<std::string> included_guards;
+
+  // The predicted conflicts (keyed by include directive), and the macros
+  // redefined with a different replacement list (these are only warnings)
+  std::map<std::string, std::string> predicted_conflicts;
+  StringList redefined_macros;
+
+  // Headers with a predicted conflict are deferred instead of blocked; once a
+  // pass makes no progress, a confirmation pass probes each of them once for
+  // real so that a false prediction never drops a header
+  std::unordered_set<std::string> deferred_headers;
+  bool confirmation_pass = false;
+
+  // Returns the first included definition that conflicts with the given
+  // header, or nullptr if the header is not known to conflict
+  auto L_predictConflict =
+      [&declaration_indexes, &included_definitions, &included_macros,
+       &included_guards](std::string &name,
+          const std::string &header_key) -> const IncludedDefinition * {
+    auto index_it = declaration_indexes.find(header_key);
+    if (index_it == declaration_indexes.end()) {
+      return nullptr;
+    }
+
+    // The contents of a header whose guard is already defined are skipped,
+    // whether the guard comes from another header's guard or a plain #define
+    const auto &declaration_index = index_it->second;
+    const auto &include_guard = declaration_index.include_guard;
+    if (!include_guard.empty() &&
+        (included_guards.count(include_guard) != 0U ||
+         included_macros.count(include_guard) != 0U)) {
+      return nullptr;
+    }
+
+    for (const auto &p : declaration_index.definitions) {
+      auto definition_it = included_definitions.find(p.first);
+      if (definition_it == included_definitions.end()) {
+        continue;
+      }
+
+      if (isConflictingDefinition(definition_it->second.entry, p.second)) {
+        name = p.first;
+        return &definition_it->second;
+      }
+    }
+
+    return nullptr;
+  };
+
+  // Adds the definitions of a header that has just been included
+  auto L_addDefinitions = [&declaration_indexes, &included_definitions,
+                           &included_macros, &included_guards,
+                           &redefined_macros](
+                              const std::string &header_key,
+                              const std::string &include_directive) -> void {
+    auto index_it = declaration_indexes.find(header_key);
+    if (index_it == declaration_indexes.end()) {
+      return;
+    }
+
+    const auto &declaration_index = index_it->second;
+    if (!declaration_index.include_guard.empty() &&
+        !included_guards.insert(declaration_index.include_guard).second) {
+      return;
+    }
+
+    for (const auto &p : declaration_index.definitions) {
+      included_definitions.insert(
+          {p.first, IncludedDefinition{include_directive, p.second}});
+    }
+
+    for (const auto &p : declaration_index.macros) {
+      auto macro_it = included_macros.find(p.first);
+      if (macro_it == included_macros.end()) {
+        included_macros.insert(
+            {p.first, IncludedMacro{include_directive, p.second}});
+
+        continue;
+      }
+
+      if (macro_it->second.replacement != p.second) {
+        redefined_macros.push_back(include_directive + " redefines macro '" +
+                                   p.first + "' from " +
+                                   macro_it->second.include_directive);
+      }
+    }
+  };
+
+  std::size_t skipped_header_count = 0U;
+
+  for (std::size_t pass = 1U;; ++pass) {
+    TraceScope pass_trace_scope("probe", "probe pass " + std::to_string(pass));
+
+    if (!confirmation_pass) {
+      deferred_headers.clear();
+    }
+
+    auto previous_active_header_count = active_include_headers.size();
+    for (auto header_desc_it = header_files.begin();
+         header_desc_it != header_files.end();) {
+      const auto &header_key = getHeaderKey(*header_desc_it);
+
+      auto include_directive_it = include_directive_map.find(header_key);
+      if (include_directive_it == include_directive_map.end()) {
+        ++header_desc_it;
+        continue;
+      }
+
+      if (blocked_headers.count(header_key) != 0U) {
+        incrementTraceCounter("skipped probes");
+        ++skipped_header_count;
+        ++header_desc_it;
+        continue;
+      }
+
+      const auto &include_directive = include_directive_it->second;
+
+      HeaderCost *header_cost = nullptr;
+      if (cost_report != nullptr) {
+        header_cost = &(*cost_report)[header_key];
+        header_cost->name = header_desc_it->name;
+      }
+
+      if (confirmation_pass) {
+        if (deferred_headers.count(header_key) == 0U) {
+          ++header_desc_it;
+          continue;
+        }
+
+      } else {
+        // The prediction is textual, so the header is only deferred; a real
+        // conflict is confirmed (and blocked) by the confirmation probe
+        std::string conflicting_name;
+        const auto *conflicting_definition =
+            L_predictConflict(conflicting_name, header_key);
+
+        if (conflicting_definition != nullptr) {
+          predicted_conflicts[include_directive] =
+              include_directive + " conflicts with " +
+              conflicting_definition->include_directive + " on '" +
+              conflicting_name + "'";
+
+          deferred_headers.insert(header_key);
+
+          incrementTraceCounter("predicted conflicts");
+          ++header_desc_it;
+          continue;
+        }
+      }
+
+      if (update_watched_names) {
+        L_updateWatchedNames();
+        update_watched_names = false;
+      }
+
+      auto new_include_headers = active_include_headers;
+      new_include_headers.push_back(include_directive);
+
+      auto source_buffer =
+          generateSourceBuffer(new_include_headers, base_includes);
+
+      TraceScope probe_trace_scope("probe", "probe");
+      probe_trace_scope.addArgument("header", include_directive);
+
+      auto probe_start_time = std::chrono::steady_clock::now();
+
+      auto compiler_status = compiler.processAST(
+          source_buffer, IASTVisitorRef(), nullptr, &parse_statistics);
+
+      bool include_succeeded = compiler_status.succeeded();
+
+      std::string first_error;
+      if (!include_succeeded) {
+        first_error = getFirstCompilerError(compiler_status.message());
+      }
+
+      if (header_cost != nullptr) {
+        auto parse_time = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - probe_start_time);
+
+        ++header_cost->probe_count;
+        header_cost->total_parse_time += parse_time.count();
+
+        auto transitive_bytes =
+            parse_statistics.loaded_bytes > active_loaded_bytes
+                ? parse_statistics.loaded_bytes - active_loaded_bytes
+                : 0U;
+
+        if (include_succeeded) {
+          header_cost->include_directive = include_directive;
+          header_cost->transitive_bytes = transitive_bytes;
+
+        } else {
+          ++header_cost->failure_count;
+          header_cost->first_error = first_error;
+
+          header_cost->transitive_bytes =
+              std::max(header_cost->transitive_bytes, transitive_bytes);
+        }
+      }
+
+      probe_trace_scope.addArgument(
+          "succeeded", static_cast<std::int64_t>(include_succeeded));
+
+      incrementTraceCounter(include_succeeded ? "successful probes"
+                                              : "failed probes");
 
-  /// The user ASTVisitor
-  IASTVisitorRef ast_visitor;
+      if (include_succeeded) {
+        if (predicted_conflicts.erase(include_directive) != 0U) {
+          incrementTraceCounter("mispredicted conflicts");
+        }
 
-  /// The mangler used for C++ symbols
-  std::unique_ptr<clang::MangleContext> name_mangler;
+        active_include_headers.push_back(include_directive);
+        active_loaded_bytes = parse_statistics.loaded_bytes;
 
- public:
-  ASTConsumer(clang::SourceManager &source_manager, IASTVisitorRef ast_visitor,
-              std::unique_ptr<clang::MangleContext> name_mangler)
-      : source_manager(source_manager),
-        ast_visitor(ast_visitor),
-        name_mangler(std::move(name_mangler)) {}
+        L_addDefinitions(header_key, include_directive);
 
-  virtual ~ASTConsumer() override = default;
+        log << "  [" << std::setfill('0') << std::setw(header_counter_digits)
+            << active_include_headers.size();
 
-  virtual void HandleTranslationUnit(clang::ASTContext &ast_context) override {
-    if (!ast_visitor) {
-      return;
-    }
+        log << "/" << total_header_count_str << "] " << include_directive
+            << "\n";
 
-    ast_visitor->initialize(&ast_context, &source_manager, name_mangler.get());
-    ast_visitor->TraverseDecl(ast_context.getTranslationUnitDecl());
-    ast_visitor->finalize();
-  }
-};
-}  // namespace
+        if (L_unblockHeaders()) {
+          update_watched_names = true;
+        }
 
-SourceCodeLocation getSourceCodeLocation(clang::ASTContext &ast_context,
-                                         clang::SourceManager &source_manager,
-                                         const clang::Decl *declaration) {
-  auto start_location = declaration->getLocStart();
-  auto full_start_location = ast_context.getFullLoc(start_location);
+        header_desc_it = header_files.erase(header_desc_it);
+        continue;
+      }
 
-#if LLVM_MAJOR_VERSION > 5
-  static_cast<void>(source_manager);
-  const auto file_entry = full_start_location.getFileEntry();
-#else
-  auto file_id = full_start_location.getFileID();
-  const auto file_entry = source_manager.getFileEntryForID(file_id);
-#endif
+      // Headers failing for a reason we don't understand are always probed
+      // again on the next pass
+      auto blocker = getProbeBlocker(first_error);
+      if (blocker.kind != ProbeBlocker::Kind::Unknown) {
+        blocked_headers.insert({header_key, std::move(blocker)});
+        update_watched_names = true;
+      }
 
-  SourceCodeLocation output;
-  if (file_entry != nullptr) {
-    output.file_path = file_entry->getName();
-  }
+      header_desc_it++;
+    }
 
-  if (output.file_path.empty()) {
-    // This is the file we generated in memory for clang
-    output.file_path = "main.cpp";
-  }
+    pass_trace_scope.addArgument(
+        "included", static_cast<std::int64_t>(active_include_headers.size() -
+                                              previous_active_header_count));
 
-  output.line = full_start_location.getSpellingLineNumber();
-  output.column = full_start_location.getSpellingColumnNumber();
+    bool made_progress =
+        previous_active_header_count != active_include_headers.size();
 
-  return output;
-}
+    if (confirmation_pass) {
+      confirmation_pass = false;
+      if (!made_progress) {
+        break;
+      }
 
-bool createCompilerInstance(CompilerInstanceRef &compiler,
-                            ProfileManagerRef &profile_manager,
-                            const LanguageManager &language_manager,
-                            const CommandLineOptions &cmdline_options) {
-  CompilerInstanceSettings compiler_settings;
-  auto prof_mgr_status = profile_manager->get(compiler_settings.profile,
-                                              cmdline_options.profile_name);
-  if (!prof_mgr_status.succeeded()) {
-    std::cerr << prof_mgr_status.toString() << "\n";
-    return false;
-  }
+    } else if (!made_progress) {
+      if (deferred_headers.empty()) {
+        break;
+      }
 
-  if (!language_manager.parseLanguageDefinition(
-          compiler_settings.language, compiler_settings.language_standard,
-          cmdline_options.language)) {
-    std::cerr << "Invalid language definition\n";
-    return false;
+      confirmation_pass = true;
+    }
   }
 
-  compiler_settings.enable_gnu_extensions =
-      cmdline_options.enable_gnu_extensions;
+  if (skipped_header_count != 0U) {
+    log << "\n  Skipped " << skipped_header_count
+        << " header probe(s); none of the newly included headers provided "
+           "what they were missing\n";
+  }
 
-  compiler_settings.use_visual_cxx_mangling =
-      cmdline_options.use_visual_cxx_mangling;
+  if (!predicted_conflicts.empty() || !redefined_macros.empty()) {
+    log << "\nPredicted conflicts\n\n";
 
-  compiler_settings.additional_include_folders = cmdline_options.header_folders;
+    for (const auto &p : predicted_conflicts) {
+      log << "  " << p.second << "\n";
+    }
 
-  auto compiler_status = CompilerInstance::create(compiler, compiler_settings);
-  if (!compiler_status.succeeded()) {
-    std::cerr << compiler_status.toString() << "\n";
-    return false;
+    for (const auto &redefinition : redefined_macros) {
+      log << "  " << redefinition << " (warning only)\n";
+    }
   }
 
-  return true;
+  return active_include_headers;
 }
 
-bool enumerateIncludeFiles(std::vector<HeaderDescriptor> &header_files,
-                           const std::string &header_folder) {
-  const static StringList valid_extensions = {".h", ".hh", ".hp", ".hpp",
-                                              ".hxx"};
-
-  auto root_header_folder = stdfs::absolute(header_folder);
+StringList computeMinimalIncludeList(const StringList &include_list,
+                                     const StringList &base_includes,
+                                     const IncludeGraph &include_graph) {
+  // The main file includes must match the buffer we generated; fall back to
+  // the full list if this is not the case
+  const auto &main_file_includes = include_graph.main_file_includes;
+  if (main_file_includes.size() != base_includes.size() + include_list.size()) {
+    return include_list;
+  }
 
-  try {
-    stdfs::recursive_directory_iterator it(root_header_folder);
-    for (const auto &directory_entry : it) {
-      if (!stdfs::is_regular_file(directory_entry.path())) {
-        continue;
+  // Walk the directives in order, tracking which files have already been
+  // pulled in; a guarded header that has already been reached through one
+  // of the previous directives is a no-op and can be removed. Headers
+  // without a guard are always kept, since including them again may add
+  // declarations (or fail, which is the reason why they were kept while
+  // probing)
+  std::unordered_set<std::string> reachable_files;
+
+  // Only the files pulled in by this specific inclusion are marked, since
+  // another inclusion of the same (unguarded) header may have seen
+  // different macros
+  auto L_markReachable = [&reachable_files,
+                          &include_graph](unsigned root) -> void {
+    std::vector<unsigned> pending_inclusions = {root};
+
+    while (!pending_inclusions.empty()) {
+      auto inclusion = pending_inclusions.back();
+      pending_inclusions.pop_back();
+
+      auto path_it = include_graph.inclusion_paths.find(inclusion);
+      if (path_it != include_graph.inclusion_paths.end()) {
+        reachable_files.insert(path_it->second);
       }
 
-      auto path = directory_entry.path();
-
-      const auto &ext = path.extension().string();
-      if (ext.empty() ||
-          std::find(valid_extensions.begin(), valid_extensions.end(), ext) ==
-              valid_extensions.end()) {
+      auto edge_it = include_graph.edges.find(inclusion);
+      if (edge_it == include_graph.edges.end()) {
         continue;
       }
 
-      HeaderDescriptor header_desc = {};
-      header_desc.name = path.filename();
+      pending_inclusions.insert(pending_inclusions.end(),
+                                edge_it->second.begin(),
+                                edge_it->second.end());
+    }
+  };
 
-      for (auto parent_path = path.parent_path();
-           !parent_path.empty() && parent_path != parent_path.root_path();
-           parent_path = parent_path.parent_path()) {
-        if (parent_path == root_header_folder) {
-          break;
-        }
+  StringList output;
 
-        auto current_relative_path =
-            parent_path.filename() /
-            (header_desc.possible_prefixes.empty()
-                 ? ""
-                 : header_desc.possible_prefixes.back());
-        header_desc.possible_prefixes.push_back(current_relative_path.string());
-      }
+  for (std::size_t i = 0U; i < main_file_includes.size(); ++i) {
+    const auto &directive = main_file_includes.at(i);
 
-      header_files.push_back(header_desc);
+    const auto &resolved_path = directive.path;
+    if (resolved_path.empty()) {
+      return include_list;
     }
 
-    return true;
-
-  } catch (...) {
-    return false;
-  }
-}
-
-bool enumerateIncludeFiles(std::vector<HeaderDescriptor> &header_files,
-                           const StringList &header_folders) {
-  header_files = {};
+    bool is_base_include = i < base_includes.size();
+    bool is_redundant = reachable_files.count(resolved_path) != 0U &&
+                        include_graph.guarded_files.count(resolved_path) != 0U;
 
-  for (const auto &folder : header_folders) {
-    if (!enumerateIncludeFiles(header_files, folder)) {
-      std::cerr << "Failed to enumerate the include files in the following "
-                   "directory: "
-                << folder << "\n";
+    // Guarded files that have already been included are not entered again
+    if (directive.inclusion != 0U) {
+      L_markReachable(directive.inclusion);
+    }
 
-      return false;
+    if (!is_base_include && !is_redundant) {
+      output.push_back(include_list.at(i - base_includes.size()));
     }
   }
 
-  return true;
+  return output;
 }
 
-StringList generateIncludeDirectives(
-    const HeaderDescriptor &header_descriptor) {
-  StringList result = {header_descriptor.name};
+std::vector<IncludeSearchPath> getIncludeSearchPaths(
+    const CompilerInstanceSettings &settings) {
+  std::vector<IncludeSearchPath> search_paths;
 
-  for (const auto &prefix : header_descriptor.possible_prefixes) {
-    auto include_directive = stdfs::path(prefix) / header_descriptor.name;
-    result.emplace_back(include_directive);
+  stdfs::path profile_root(settings.profile.root_path);
+
+  auto path_list_it = settings.profile.internal_isystem.find(settings.language);
+  if (path_list_it != settings.profile.internal_isystem.end()) {
+    const auto &path_list = path_list_it->second;
+
+    for (const auto &path : path_list) {
+      std::string absolute_path = (profile_root / path).string();
+      search_paths.emplace_back(absolute_path,
+                                clang::frontend::IncludeDirGroup::System);
+    }
   }
 
-  return result;
-}
+  path_list_it =
+      settings.profile.internal_externc_isystem.find(settings.language);
+  if (path_list_it != settings.profile.internal_externc_isystem.end()) {
+    const auto &path_list = path_list_it->second;
 
-std::string generateSourceBuffer(const StringList &include_list,
-                                 const StringList &base_includes) {
-  std::stringstream buffer;
-  for (const auto &include : base_includes) {
-    buffer << "#include <" << include << ">\n";
+    for (const auto &path : path_list) {
+      std::string absolute_path = (profile_root / path).string();
+      search_paths.emplace_back(
+          absolute_path, clang::frontend::IncludeDirGroup::ExternCSystem);
+    }
   }
 
-  for (const auto &include : include_list) {
-    buffer << "#include <" << include << ">\n";
+  for (const auto &path : settings.additional_include_folders) {
+    try {
+      auto absolute_path = stdfs::absolute(path);
+
+      search_paths.emplace_back(absolute_path.string(),
+                                clang::frontend::IncludeDirGroup::System);
+    } catch (...) {
+      std::cerr << "Failed to acquire the absolute path for the following "
+                   "include folder: " +
+                       path;
+    }
   }
 
-  return buffer.str();
+  return search_paths;
 }
 
 CompilerInstance::Status createClangCompilerInstance(
     std::unique_ptr<clang::CompilerInstance> &compiler,
-    const CompilerInstanceSettings &settings, IASTVisitorRef ast_visitor) {
+    const CompilerInstanceSettings &settings, IASTVisitorRef ast_visitor,
+    IncludeGraph *include_graph,
+    clang::TranslationUnitKind translation_unit_kind,
+    ParseStatistics *statistics) {
   compiler.reset();
 
   std::unique_ptr<clang::CompilerInstance> obj;
@@ -234,56 +1396,60 @@ CompilerInstance::Status createClangCompilerInstance(
         false, CompilerInstance::StatusCode::InvalidLanguage);
   }
 
-  stdfs::path profile_root(settings.profile.root_path);
+  // The header maps must come first in their include group
+  std::string isystem_header_map;
+  std::string externc_isystem_header_map;
 
-  auto path_list_it = settings.profile.internal_isystem.find(settings.language);
-  if (path_list_it != settings.profile.internal_isystem.end()) {
-    const auto &path_list = path_list_it->second;
+  if (settings.use_header_maps &&
+      !getProfileHeaderMaps(isystem_header_map, externc_isystem_header_map,
+                            settings)) {
+    std::cerr << "Failed to create the header maps; continuing without them\n";
+  }
 
-    for (const auto &path : path_list) {
-      std::string absolute_path = (profile_root / path).string();
-      header_search_options.AddPath(absolute_path,
-                                    clang::frontend::IncludeDirGroup::System,
-                                    false, false);
-    }
+  if (!isystem_header_map.empty()) {
+    header_search_options.AddPath(isystem_header_map,
+                                  clang::frontend::IncludeDirGroup::System,
+                                  false, false);
   }
 
-  path_list_it =
-      settings.profile.internal_externc_isystem.find(settings.language);
-  if (path_list_it != settings.profile.internal_externc_isystem.end()) {
-    const auto &path_list = path_list_it->second;
+  if (!externc_isystem_header_map.empty()) {
+    header_search_options.AddPath(
+        externc_isystem_header_map,
+        clang::frontend::IncludeDirGroup::ExternCSystem, false, false);
+  }
 
-    for (const auto &path : path_list) {
-      std::string absolute_path = (profile_root / path).string();
-      header_search_options.AddPath(
-          absolute_path, clang::frontend::IncludeDirGroup::ExternCSystem, false,
-          false);
-    }
+  for (const auto &search_path : getIncludeSearchPaths(settings)) {
+    header_search_options.AddPath(search_path.first, search_path.second, false,
+                                  false);
   }
 
-  for (const auto &path : settings.additional_include_folders) {
-    try {
-      auto absolute_path = stdfs::absolute(path);
+  // The module map is loaded once the preprocessor has been created; the
+  // modules are built on demand, and kept in the module cache
+  std::string module_map;
+  std::string module_cache_path;
 
-      header_search_options.AddPath(absolute_path.string(),
-                                    clang::frontend::IncludeDirGroup::System,
-                                    false, false);
-    } catch (...) {
-      std::cerr << "Failed to acquire the absolute path for the following "
-                   "include folder: " +
-                       path;
-    }
+  if (settings.use_modules && (!getModuleCachePath(module_cache_path) ||
+                               !getModuleMap(module_map, settings))) {
+    std::cerr << "Failed to create the module map; continuing without "
+                 "modules\n";
+
+    module_map.clear();
+  }
+
+  bool use_modules = !module_map.empty();
+  if (use_modules) {
+    header_search_options.ModuleCachePath = module_cache_path;
+    header_search_options.ImplicitModuleMaps = 0;
+
+    // Every header in the map is a system one; make sure that the modules
+    // are rebuilt when the headers change
+    header_search_options.ModulesValidateSystemHeaders = 1;
   }
 
-  clang::LangOptions &language_options = obj->getLangOpts();
   clang::InputKind input_kind;
   clang::LangStandard::Kind language_standard;
 
   if (settings.language == Language::CXX) {
-    language_options.CPlusPlus = 1;
-    language_options.RTTI = 1;
-    language_options.CXXExceptions = 1;
-
     input_kind = kClangFrontendInputKindCxx;
 
     switch (settings.language_standard) {
@@ -305,10 +1471,6 @@ CompilerInstance::Status createClangCompilerInstance(
     }
 
   } else {
-    language_options.CPlusPlus = 0;
-    language_options.RTTI = 0;
-    language_options.CXXExceptions = 0;
-
     input_kind = kClangFrontendInputKindC;
 
     switch (settings.language_standard) {
@@ -334,59 +1496,240 @@ CompilerInstance::Status createClangCompilerInstance(
     }
   }
 
-  language_options.GNUMode = settings.enable_gnu_extensions ? 1 : 0;
-  language_options.GNUKeywords = 1;
-  language_options.Bool = 1;
+  obj->createDiagnostics();
 
-  auto &invocation = obj->getInvocation();
-  invocation.setLangDefaults(language_options, input_kind,
-                             llvm::Triple(llvm::sys::getDefaultTargetTriple()),
-                             obj->getPreprocessorOpts(), language_standard);
+  // The language options, the target and the predefined macros only depend
+  // on this configuration, and are computed once
+  auto target_triple = getProfileTargetTriple(settings.profile);
 
-  std::shared_ptr<clang::TargetOptions> target_options =
-      std::make_shared<clang::TargetOptions>();
+  std::stringstream configuration_key;
+  configuration_key << target_triple << "/" << settings.language << "/"
+                    << settings.language_standard << "/"
+                    << settings.enable_gnu_extensions << "/" << use_modules;
 
-  target_options->Triple = llvm::sys::getDefaultTargetTriple();
+  auto &configuration_cache = getCompilerConfigurationCache();
+  auto &configuration = configuration_cache[configuration_key.str()];
 
-  obj->createDiagnostics();
+  if (!configuration) {
+    auto new_configuration = std::make_shared<CompilerConfiguration>();
+
+    auto &language_options = new_configuration->language_options;
+    if (settings.language == Language::CXX) {
+      language_options.CPlusPlus = 1;
+      language_options.RTTI = 1;
+      language_options.CXXExceptions = 1;
+
+    } else {
+      language_options.CPlusPlus = 0;
+      language_options.RTTI = 0;
+      language_options.CXXExceptions = 0;
+    }
+
+    language_options.GNUMode = settings.enable_gnu_extensions ? 1 : 0;
+    language_options.GNUKeywords = 1;
+    language_options.Bool = 1;
+
+    language_options.Modules = use_modules ? 1 : 0;
+    language_options.ImplicitModules = use_modules ? 1 : 0;
+
+    auto &invocation = obj->getInvocation();
+    invocation.setLangDefaults(language_options, input_kind,
+                               llvm::Triple(target_triple),
+                               obj->getPreprocessorOpts(), language_standard);
 
-  clang::TargetInfo *target_information = clang::TargetInfo::CreateTargetInfo(
-      obj->getDiagnostics(), target_options);
+    std::shared_ptr<clang::TargetOptions> target_options =
+        std::make_shared<clang::TargetOptions>();
 
-  obj->setTarget(target_information);
+    target_options->Triple = target_triple;
 
+    new_configuration->target_information = clang::TargetInfo::CreateTargetInfo(
+        obj->getDiagnostics(), target_options);
+
+    if (!new_configuration->target_information) {
+      configuration_cache.erase(configuration_key.str());
+
+      return CompilerInstance::Status(
+          false, CompilerInstance::StatusCode::InvalidTarget,
+          "Unsupported target: " + target_triple);
+    }
+
+    configuration = new_configuration;
+  }
+
+  // Make sure that clang agrees with the profile on the type sizes and
+  // alignments
+  if (!settings.profile.data_layout.empty()) {
+#if LLVM_MAJOR_VERSION >= 11
+    std::string data_layout =
+        configuration->target_information->getDataLayoutString();
+#else
+    std::string data_layout = configuration->target_information->getDataLayout()
+                                  .getStringRepresentation();
+#endif
+
+    if (data_layout != settings.profile.data_layout) {
+      return CompilerInstance::Status(
+          false, CompilerInstance::StatusCode::InvalidTarget,
+          "The data layout for the " + target_triple + " target (" +
+              data_layout + ") does not match the profile one (" +
+              settings.profile.data_layout + ")");
+    }
+  }
+
+  clang::LangOptions &language_options = obj->getLangOpts();
+  language_options = configuration->language_options;
+
+  obj->setTarget(configuration->target_information.get());
+
+  // Modules are built by a separate compiler instance, which recreates the
+  // target from the invocation
+  if (use_modules) {
+    obj->getTargetOpts().Triple = target_triple;
+  }
+
+  // Mount the packed profile headers (if any) on top of the real file system
+  FileSystemRef file_system;
+  if (!getProfileFileSystem(file_system, settings.profile)) {
+    return CompilerInstance::Status(
+        false, CompilerInstance::StatusCode::FileSystemError,
+        "Failed to open the profile archive");
+  }
+
+#if LLVM_MAJOR_VERSION >= 8
+  obj->createFileManager(file_system);
+#else
+  obj->setVirtualFileSystem(file_system);
   obj->createFileManager();
+#endif
+
   obj->createSourceManager(obj->getFileManager());
 
-  obj->createPreprocessor(clang::TU_Complete);
-  obj->getPreprocessorOpts().UsePredefines = false;
+  // Reuse the predefined macros generated by the first instance that used
+  // this configuration. The compiler instances that build the modules copy
+  // the preprocessor options, and must generate their own predefines; they
+  // are never reused when modules are enabled
+  bool reuse_predefines = !use_modules && !configuration->predefines.empty();
+  if (reuse_predefines) {
+    obj->getPreprocessorOpts().UsePredefines = false;
+  }
+
+  obj->createPreprocessor(translation_unit_kind);
+  if (!use_modules) {
+    obj->getPreprocessorOpts().UsePredefines = false;
+  }
+
+  if (reuse_predefines) {
+    obj->getPreprocessor().setPredefines(configuration->predefines);
+  } else {
+    configuration->predefines = obj->getPreprocessor().getPredefines();
+  }
 
   auto &preprocessor = obj->getPreprocessor();
   preprocessor.getBuiltinInfo().initializeBuiltins(
       preprocessor.getIdentifierTable(), language_options);
 
+  if (use_modules) {
+#if LLVM_MAJOR_VERSION >= 10
+    auto module_map_entry_or_error = obj->getFileManager().getFile(module_map);
+
+    const clang::FileEntry *module_map_entry =
+        module_map_entry_or_error ? module_map_entry_or_error.get() : nullptr;
+#else
+    const auto *module_map_entry = obj->getFileManager().getFile(module_map);
+#endif
+
+    if (module_map_entry == nullptr ||
+        preprocessor.getHeaderSearchInfo().loadModuleMapFile(module_map_entry,
+                                                             true)) {
+      return CompilerInstance::Status(
+          false, CompilerInstance::StatusCode::FileSystemError,
+          "Failed to load the module map: " + module_map);
+    }
+  }
+
   auto &source_manager = obj->getSourceManager();
 
+  if (include_graph != nullptr) {
+    preprocessor.addPPCallbacks(llvm::make_unique<IncludeGraphRecorder>(
+        source_manager, preprocessor.getHeaderSearchInfo(), *include_graph));
+  }
+
   obj->createASTContext();
 
-  std::unique_ptr<clang::MangleContext> name_mangler;
-  if (settings.use_visual_cxx_mangling) {
-    name_mangler.reset(clang::MicrosoftMangleContext::create(
-        obj->getASTContext(), obj->getDiagnostics()));
-  } else {
-    name_mangler.reset(clang::ItaniumMangleContext::create(
-        obj->getASTContext(), obj->getDiagnostics()));
+  // Load the precompiled base includes; errors are reported through the
+  // status object, so that they do not end up on the console
+  if (!settings.precompiled_header.empty()) {
+    auto &diagnostics = obj->getDiagnostics();
+    auto diagnostic_consumer = diagnostics.takeClient();
+
+    clang::IgnoringDiagConsumer ignoring_diagnostic_consumer;
+    diagnostics.setClient(&ignoring_diagnostic_consumer, false);
+
+    obj->getPreprocessorOpts().ImplicitPCHInclude = settings.precompiled_header;
+
+#if LLVM_MAJOR_VERSION >= 13
+    obj->createPCHExternalASTSource(settings.precompiled_header,
+                                    clang::DisableValidationForModuleKind::None,
+                                    false, nullptr, false);
+#else
+    obj->createPCHExternalASTSource(settings.precompiled_header, false, false,
+                                    nullptr, false);
+#endif
+
+    diagnostics.setClient(diagnostic_consumer.release(), true);
+
+    if (diagnostics.hasErrorOccurred()) {
+      return CompilerInstance::Status(
+          false, CompilerInstance::StatusCode::PrecompiledHeaderError,
+          "Failed to load the precompiled header: " +
+              settings.precompiled_header);
+    }
   }
 
-  if (!name_mangler) {
-    return CompilerInstance::Status(
-        false, CompilerInstance::StatusCode::MemoryAllocationFailure);
+  // Create one name mangler for each requested scheme; they all share the
+  // same ASTContext, so the source is only parsed once
+  NameManglerRefList name_manglers;
+
+  for (const auto &name_mangling_scheme : settings.name_mangling_schemes) {
+    std::unique_ptr<clang::MangleContext> name_mangler;
+
+    switch (name_mangling_scheme) {
+      case NameManglingScheme::Microsoft: {
+        name_mangler.reset(clang::MicrosoftMangleContext::create(
+            obj->getASTContext(), obj->getDiagnostics()));
+        break;
+      }
+
+      case NameManglingScheme::Itanium: {
+        name_mangler.reset(clang::ItaniumMangleContext::create(
+            obj->getASTContext(), obj->getDiagnostics()));
+        break;
+      }
+    }
+
+    if (!name_mangler) {
+      return CompilerInstance::Status(
+          false, CompilerInstance::StatusCode::MemoryAllocationFailure);
+    }
+
+    name_manglers.push_back(std::move(name_mangler));
   }
 
   obj->setASTConsumer(llvm::make_unique<ASTConsumer>(
-      source_manager, ast_visitor, std::move(name_mangler)));
-
-  name_mangler.release();
+      source_manager, ast_visitor, std::move(name_manglers),
+      settings.memory_limit, statistics));
+
+  // The module reader must be attached to the ASTContext before the parse
+  // starts, so that the Sema object created by ParseAST can see the
+  // declarations imported from the modules. This is already the case when
+  // a precompiled header has been loaded
+  if (use_modules) {
+#if LLVM_MAJOR_VERSION >= 10
+    obj->createASTReader();
+#else
+    obj->createModuleManager();
+#endif
+  }
 
   compiler = std::move(obj);
   obj.release();
@@ -19,9 +19,14 @@
 #include "cmdline.h"
 #include "compilerinstance.h"
 #include "generate_command.h"
+#include "headercostreport.h"
 #include "types.h"
 
 #include <clang/AST/RecursiveASTVisitor.h>
+#include <clang/Lex/HeaderSearchOptions.h>
+
+/// The output formats supported by the 'compile' command
+enum class CompileOutputFormat { Bitcode, TextualIR, Object };
 
 /// Returns the source code location for the given declaration
 SourceCodeLocation getSourceCodeLocation(clang::ASTContext &ast_context,
@@ -32,18 +37,52 @@ SourceCodeLocation getSourceCodeLocation(clang::ASTContext &ast_context,
 /// otherwise) a function pointer
 bool containsFunctionPointer(const clang::FunctionDecl *func_decl);
 
+/// Initializes the compiler instance settings according to the command line
+/// options
+bool getCompilerInstanceSettings(CompilerInstanceSettings &compiler_settings,
+                                 ProfileManagerRef &profile_manager,
+                                 const LanguageManager &language_manager,
+                                 const CommandLineOptions &cmdline_options);
+
 /// Creates a new compiler instance object configured according to the command
-/// line options
+/// line options; the precompiled header messages are written to the log
 bool createCompilerInstance(CompilerInstanceRef &compiler,
                             ProfileManagerRef &profile_manager,
                             const LanguageManager &language_manager,
+                            const CommandLineOptions &cmdline_options,
+                            std::ostream &log);
+
+/// Returns the target triple described by the given profile, or the default
+/// target of the host if the profile does not specify one
+std::string getProfileTargetTriple(const Profile &profile);
+
+/// Returns how many jobs can be run concurrently, as requested on the command
+/// line; defaults to the number of hardware threads
+std::size_t getJobCount(const CommandLineOptions &cmdline_options);
+
+/// Returns the name mangling schemes requested on the command line; defaults
+/// to the Itanium scheme when nothing has been specified
+bool getNameManglingSchemes(NameManglingSchemeList &name_mangling_schemes,
                             const CommandLineOptions &cmdline_options);
 
+/// Parses the given name mangling scheme name (either itanium or microsoft)
+bool parseNameManglingScheme(NameManglingScheme &scheme,
+                             const std::string &name);
+
+/// Returns the name of the given name mangling scheme
+std::string getNameManglingSchemeName(NameManglingScheme scheme);
+
+/// Parses the given compile output format name (bitcode, ir or object)
+bool parseCompileOutputFormat(CompileOutputFormat &output_format,
+                              const std::string &name);
+
 /// Recursively enumerates all the include files found in the given folder
 bool enumerateIncludeFiles(std::vector<HeaderDescriptor> &header_files,
                            const std::string &header_folder);
 
-/// Recursively enumerates all the include files found in the given folder list
+/// Recursively enumerates all the include files found in the given folder
+/// list; headers reachable through more than one path, or with the same
+/// contents of a previous one, are only reported once
 bool enumerateIncludeFiles(std::vector<HeaderDescriptor> &header_files,
                            const StringList &header_folders);
 
@@ -56,6 +95,22 @@ StringList generateIncludeDirectives(const HeaderDescriptor &header_descriptor);
 std::string generateSourceBuffer(const StringList &include_list,
                                  const StringList &base_includes);
 
+/// Attempts to include as many of the given headers as possible, using the
+/// first include directive that resolves to each header; stops when no new
+/// header can be added to the list. The headers that have been included are
+/// removed from header_files, and the working include directives are returned
+/// in order. Each successful directive is written to the log. When a cost
+/// report is passed, it is filled with the parse cost of each header. If
+/// conflicts are predicted, the headers redefining a name that an included
+/// header already defines are deferred, and only probed once no other header
+/// can be added
+StringList probeIncludeHeaders(CompilerInstance &compiler,
+                               std::vector<HeaderDescriptor> &header_files,
+                               const StringList &base_includes,
+                               std::ostream &log,
+                               HeaderCostReport *cost_report = nullptr,
+                               bool predict_conflicts = true);
+
 /// This AST function callback is used to filter and collect functions that
 /// are suitable for the ABI library
 bool astFunctionCallback(clang::Decl *declaration,
@@ -64,8 +119,31 @@ bool astFunctionCallback(clang::Decl *declaration,
                          void *user_defined,
                          clang::MangleContext *name_mangler);
 
-/// Creates a clang CompilerInstance object
+/// Removes the guarded headers that are already included (directly or
+/// otherwise) by the ones that precede them in the source buffer; the include
+/// graph must have been recorded while parsing the buffer generated with
+/// generateSourceBuffer
+StringList computeMinimalIncludeList(const StringList &include_list,
+                                     const StringList &base_includes,
+                                     const IncludeGraph &include_graph);
+
+/// An include folder, along with the group it belongs to
+using IncludeSearchPath =
+    std::pair<std::string, clang::frontend::IncludeDirGroup>;
+
+/// Returns the include folders used by the compiler instances created with
+/// the given settings, in search order. The header maps are not listed,
+/// since they only index the files found in these folders
+std::vector<IncludeSearchPath> getIncludeSearchPaths(
+    const CompilerInstanceSettings &settings);
+
+/// Creates a clang CompilerInstance object; the translation unit kind is
+/// only changed when building precompiled headers. The statistics object
+/// receives the memory limit flag set by the AST consumer
 CompilerInstance::Status createClangCompilerInstance(
     std::unique_ptr<clang::CompilerInstance> &compiler,
     const CompilerInstanceSettings &settings,
-    IASTVisitorRef ast_visitor = IASTVisitorRef());
+    IASTVisitorRef ast_visitor = IASTVisitorRef(),
+    IncludeGraph *include_graph = nullptr,
+    clang::TranslationUnitKind translation_unit_kind = clang::TU_Complete,
+    ParseStatistics *statistics = nullptr);
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "headercostreport.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+
+#include <json11.hpp>
+
+namespace {
+/// A report entry; the header path is paired with its cost
+using HeaderCostEntry = HeaderCostReport::value_type;
+
+/// Returns the report entries, starting from the most expensive header
+std::vector<const HeaderCostEntry *> getSortedEntries(
+    const HeaderCostReport &report) {
+  std::vector<const HeaderCostEntry *> entry_list;
+  entry_list.reserve(report.size());
+
+  for (const auto &entry : report) {
+    entry_list.push_back(&entry);
+  }
+
+  std::stable_sort(
+      entry_list.begin(), entry_list.end(),
+      [](const HeaderCostEntry *lhs, const HeaderCostEntry *rhs) -> bool {
+        return lhs->second.total_parse_time > rhs->second.total_parse_time;
+      });
+
+  return entry_list;
+}
+
+/// Returns the average parse time of the given header, in microseconds
+std::int64_t getAverageParseTime(const HeaderCost &cost) {
+  if (cost.probe_count == 0U) {
+    return 0;
+  }
+
+  return cost.total_parse_time / static_cast<std::int64_t>(cost.probe_count);
+}
+}  // namespace
+
+std::string getFirstCompilerError(const std::string &compiler_output) {
+  static const std::string kErrorMarker = "error: ";
+
+  std::size_t line_start = 0U;
+  while (line_start < compiler_output.size()) {
+    auto line_end = compiler_output.find('\n', line_start);
+    if (line_end == std::string::npos) {
+      line_end = compiler_output.size();
+    }
+
+    auto line = compiler_output.substr(line_start, line_end - line_start);
+    line_start = line_end + 1U;
+
+    // Keep the location, since it tells which header failed to compile
+    if (line.find(kErrorMarker) != std::string::npos) {
+      return line;
+    }
+  }
+
+  return std::string();
+}
+
+bool saveHeaderCostReport(const std::string &path,
+                          const HeaderCostReport &report) {
+  std::ofstream report_file(path);
+
+  report_file << std::setw(12) << "total (ms)" << std::setw(12) << "avg (ms)"
+              << std::setw(8) << "probes" << std::setw(10) << "failures"
+              << std::setw(14) << "bytes"
+              << "  header\n";
+
+  report_file << std::fixed << std::setprecision(2);
+
+  for (const auto entry : getSortedEntries(report)) {
+    const auto &cost = entry->second;
+
+    report_file << std::setw(12)
+                << static_cast<double>(cost.total_parse_time) / 1000.0
+                << std::setw(12)
+                << static_cast<double>(getAverageParseTime(cost)) / 1000.0
+                << std::setw(8) << cost.probe_count << std::setw(10)
+                << cost.failure_count << std::setw(14) << cost.transitive_bytes
+                << "  " << entry->first << "\n";
+
+    if (cost.include_directive.empty() && !cost.first_error.empty()) {
+      report_file << std::setw(56) << ""
+                  << "  -> " << cost.first_error << "\n";
+    }
+  }
+
+  return static_cast<bool>(report_file);
+}
+
+bool saveHeaderCostReportAsJSON(const std::string &path,
+                                const HeaderCostReport &report) {
+  json11::Json::array header_list;
+
+  for (const auto entry : getSortedEntries(report)) {
+    const auto &cost = entry->second;
+
+    header_list.push_back(json11::Json::object{
+        {"path", entry->first},
+        {"name", cost.name},
+        {"include-directive", cost.include_directive},
+        {"included", !cost.include_directive.empty()},
+        {"probes", static_cast<double>(cost.probe_count)},
+        {"failures", static_cast<double>(cost.failure_count)},
+        {"total-parse-time-us", static_cast<double>(cost.total_parse_time)},
+        {"average-parse-time-us",
+         static_cast<double>(getAverageParseTime(cost))},
+        {"first-error", cost.first_error},
+        {"transitive-bytes", static_cast<double>(cost.transitive_bytes)}});
+  }
+
+  json11::Json output = json11::Json::object{{"headers", header_list}};
+
+  std::ofstream report_file(path);
+  report_file << output.dump() << "\n";
+
+  return static_cast<bool>(report_file);
+}
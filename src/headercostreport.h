@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+/// The parse cost of a single header, collected while probing
+struct HeaderCost final {
+  /// The header name, relative to its header folder
+  std::string name;
+
+  /// The include directive that has been accepted; empty if the header
+  /// could not be included
+  std::string include_directive;
+
+  /// How many include directives have been compiled
+  std::size_t probe_count{0U};
+
+  /// How many of the compiled directives have failed
+  std::size_t failure_count{0U};
+
+  /// The time spent compiling the directives, in microseconds
+  std::int64_t total_parse_time{0};
+
+  /// The first error reported by the last failed directive
+  std::string first_error;
+
+  /// The amount of bytes pulled in transitively, compared to the headers
+  /// that were already included; for the headers that could not be
+  /// included, this is the largest amount seen across the attempts
+  std::uint64_t transitive_bytes{0U};
+};
+
+/// The parse cost of each probed header, indexed by header path
+using HeaderCostReport = std::map<std::string, HeaderCost>;
+
+/// Returns the first error message found in the given compiler output, or
+/// an empty string if there is none
+std::string getFirstCompilerError(const std::string &compiler_output);
+
+/// Saves the report as a text table, sorted by cumulative parse time
+bool saveHeaderCostReport(const std::string &path,
+                          const HeaderCostReport &report);
+
+/// Saves the report as a JSON file, sorted by cumulative parse time
+bool saveHeaderCostReportAsJSON(const std::string &path,
+                                const HeaderCostReport &report);
@@ -0,0 +1,412 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "headermap.h"
+#include "fileutils.h"
+#include "precompiledheader.h"
+#include "profilestorage.h"
+#include "std_filesystem.h"
+
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Support/Endian.h>
+
+namespace {
+/// The header map magic ('hmap')
+const std::uint32_t kHeaderMapMagic = 0x686D6170U;
+
+/// The header map version
+const std::uint16_t kHeaderMapVersion = 1U;
+
+/// Size of the header map header
+const std::uint32_t kHeaderMapHeaderSize = 24U;
+
+/// Size of a single bucket
+const std::uint32_t kHeaderMapBucketSize = 12U;
+
+/// The maximum folder depth, used to avoid symbolic link loops
+const int kMaxSearchDepth = 32;
+
+/// A single bucket in the header map hash table
+struct HeaderMapBucket final {
+  /// The string table offset of the key; zero if the bucket is empty
+  std::uint32_t key{0U};
+
+  /// The string table offset of the value prefix (the folder)
+  std::uint32_t prefix{0U};
+
+  /// The string table offset of the value suffix (the file name)
+  std::uint32_t suffix{0U};
+};
+
+/// The hash function used by clang for the header map keys
+std::uint32_t getHeaderMapHash(const std::string &key) {
+  std::uint32_t hash = 0U;
+  for (auto c : key) {
+    hash += static_cast<std::uint32_t>(
+                static_cast<unsigned char>(llvm::toLower(c))) *
+            13U;
+  }
+
+  return hash;
+}
+
+/// Appends a little endian integer to the given buffer
+template <typename T>
+void appendInteger(std::string &buffer, T value) {
+  char data[sizeof(T)];
+  llvm::support::endian::write<T, llvm::support::little,
+                               llvm::support::unaligned>(data, value);
+  buffer.append(data, sizeof(data));
+}
+
+/// Describes where an include name has been found
+struct HeaderLocation final {
+  /// How many search folders contain this name
+  std::size_t folder_count{0U};
+
+  /// The include name, as found on disk
+  std::string name;
+
+  /// The absolute path of the first match
+  std::string path;
+
+  /// True if the first match is inside an internal-externc-isystem folder
+  bool externc{false};
+};
+
+/// Maps the lower case include names to their location
+using HeaderLocationMap = std::unordered_map<std::string, HeaderLocation>;
+
+/// Adds all the files inside the given search folder to the location map
+void scanSearchFolder(HeaderLocationMap &location_map,
+                      const stdfs::path &folder, bool externc) {
+  std::error_code error;
+  if (!stdfs::is_directory(folder, error)) {
+    return;
+  }
+
+  // Names are case insensitive inside header maps; the ones that only
+  // differ by case can't be told apart, and are never mapped
+  std::unordered_map<std::string, std::pair<std::string, std::string>>
+      folder_names;
+
+  std::unordered_set<std::string> colliding_names;
+
+  try {
+    stdfs::recursive_directory_iterator it(
+        folder, stdfs::directory_options::follow_directory_symlink);
+
+    for (; it != stdfs::recursive_directory_iterator(); it.increment(error)) {
+      if (error) {
+        break;
+      }
+
+      if (it.depth() >= kMaxSearchDepth) {
+        it.disable_recursion_pending();
+      }
+
+      const auto &path = it->path();
+      if (!stdfs::is_regular_file(path, error)) {
+        continue;
+      }
+
+      auto name = path.lexically_relative(folder).generic_string();
+      auto lower_case_name = llvm::StringRef(name).lower();
+
+      if (!folder_names.insert({lower_case_name, {name, path.string()}})
+               .second) {
+        colliding_names.insert(lower_case_name);
+      }
+    }
+
+  } catch (...) {
+    // Leave the partial results in; names that have not been found
+    // here will not be marked as unique if they appear elsewhere, but this
+    // folder is still searched as usual after the header map
+  }
+
+  for (const auto &p : folder_names) {
+    auto &location = location_map[p.first];
+    if (location.folder_count == 0U) {
+      location.name = p.second.first;
+      location.path = p.second.second;
+      location.externc = externc;
+    }
+
+    location.folder_count += colliding_names.count(p.first) != 0U ? 2U : 1U;
+  }
+}
+
+/// Builds the header map entries for the given settings
+void buildProfileHeaderMapEntries(HeaderMapEntries &isystem_entries,
+                                  HeaderMapEntries &externc_isystem_entries,
+                                  const CompilerInstanceSettings &settings) {
+  isystem_entries = {};
+  externc_isystem_entries = {};
+
+  stdfs::path profile_root(settings.profile.root_path);
+  HeaderLocationMap location_map;
+
+  auto path_list_it = settings.profile.internal_isystem.find(settings.language);
+  if (path_list_it != settings.profile.internal_isystem.end()) {
+    for (const auto &path : path_list_it->second) {
+      scanSearchFolder(location_map, profile_root / path, false);
+    }
+  }
+
+  path_list_it =
+      settings.profile.internal_externc_isystem.find(settings.language);
+  if (path_list_it != settings.profile.internal_externc_isystem.end()) {
+    for (const auto &path : path_list_it->second) {
+      scanSearchFolder(location_map, profile_root / path, true);
+    }
+  }
+
+  // The additional folders are searched after the internal-isystem ones but
+  // before the internal-externc-isystem ones; they are never mapped, but the
+  // names they contain must not be mapped either
+  for (const auto &path : settings.additional_include_folders) {
+    HeaderLocationMap additional_location_map;
+
+    std::error_code error;
+    scanSearchFolder(additional_location_map, stdfs::absolute(path, error),
+                     false);
+
+    for (const auto &p : additional_location_map) {
+      location_map[p.first].folder_count += 2U;
+    }
+  }
+
+  for (const auto &p : location_map) {
+    const auto &location = p.second;
+    if (location.folder_count != 1U) {
+      continue;
+    }
+
+    auto &entries =
+        location.externc ? externc_isystem_entries : isystem_entries;
+    entries.insert({location.name, location.path});
+  }
+}
+
+/// Returns where the header maps for the given settings should be saved
+bool getProfileHeaderMapPaths(std::string &isystem_header_map,
+                              std::string &externc_isystem_header_map,
+                              const CompilerInstanceSettings &settings) {
+  std::string cache_folder;
+  if (!getCacheFolderPath(cache_folder)) {
+    return false;
+  }
+
+  std::stringstream key;
+  key << settings.profile.name << "\n"
+      << settings.profile.root_path << "\n"
+      << settings.language << "\n";
+
+  for (const auto &folder : settings.additional_include_folders) {
+    std::error_code error;
+    key << "-I" << stdfs::absolute(folder, error).string() << "\n";
+  }
+
+  auto base_path =
+      stdfs::path(cache_folder) / "hmap" / getContentHash(key.str());
+
+  isystem_header_map = base_path.string() + "-isystem.hmap";
+  externc_isystem_header_map = base_path.string() + "-externc-isystem.hmap";
+
+  return true;
+}
+
+/// The header maps that have been written by this process, keyed by the
+/// internal-isystem header map path
+struct HeaderMapCache final {
+  /// Guards the rest of the structure
+  std::mutex mutex;
+
+  /// The internal-isystem and internal-externc-isystem header maps; either
+  /// path is empty when there was nothing to map
+  std::map<std::string, std::pair<std::string, std::string>> header_maps;
+};
+
+/// Returns the header map cache
+HeaderMapCache &getHeaderMapCache() {
+  static HeaderMapCache cache;
+  return cache;
+}
+}  // namespace
+
+bool writeHeaderMap(const std::string &path, const HeaderMapEntries &entries) {
+  // Keep the load factor low, since the hash function is rather weak
+  std::uint32_t bucket_count = 16U;
+  while (bucket_count < entries.size() * 4U) {
+    bucket_count *= 2U;
+  }
+
+  // The first string table byte is reserved, since a zero key offset marks
+  // the empty buckets
+  std::string string_table(1U, '\0');
+  std::unordered_map<std::string, std::uint32_t> string_offsets;
+
+  auto L_addString = [&string_table, &string_offsets](
+                         const std::string &str) -> std::uint32_t {
+    auto it = string_offsets.find(str);
+    if (it != string_offsets.end()) {
+      return it->second;
+    }
+
+    auto offset = static_cast<std::uint32_t>(string_table.size());
+    string_table.append(str);
+    string_table.push_back('\0');
+
+    string_offsets.insert({str, offset});
+    return offset;
+  };
+
+  std::vector<HeaderMapBucket> bucket_list(bucket_count);
+  std::uint32_t max_value_length = 0U;
+
+  for (const auto &p : entries) {
+    const auto &key = p.first;
+    stdfs::path value(p.second);
+
+    auto prefix = value.parent_path().string() + "/";
+    auto suffix = value.filename().string();
+
+    max_value_length = std::max(
+        max_value_length,
+        static_cast<std::uint32_t>(prefix.size() + suffix.size()));
+
+    HeaderMapBucket bucket;
+    bucket.key = L_addString(key);
+    bucket.prefix = L_addString(prefix);
+    bucket.suffix = L_addString(suffix);
+
+    // Linear probing, as done by clang
+    auto index = getHeaderMapHash(key);
+    while (bucket_list.at(index & (bucket_count - 1U)).key != 0U) {
+      ++index;
+    }
+
+    bucket_list.at(index & (bucket_count - 1U)) = bucket;
+  }
+
+  auto strings_offset =
+      kHeaderMapHeaderSize + bucket_count * kHeaderMapBucketSize;
+
+  std::string buffer;
+  appendInteger<std::uint32_t>(buffer, kHeaderMapMagic);
+  appendInteger<std::uint16_t>(buffer, kHeaderMapVersion);
+  appendInteger<std::uint16_t>(buffer, 0U);
+  appendInteger<std::uint32_t>(buffer, strings_offset);
+  appendInteger<std::uint32_t>(buffer,
+                               static_cast<std::uint32_t>(entries.size()));
+  appendInteger<std::uint32_t>(buffer, bucket_count);
+  appendInteger<std::uint32_t>(buffer, max_value_length);
+
+  for (const auto &bucket : bucket_list) {
+    appendInteger<std::uint32_t>(buffer, bucket.key);
+    appendInteger<std::uint32_t>(buffer, bucket.prefix);
+    appendInteger<std::uint32_t>(buffer, bucket.suffix);
+  }
+
+  buffer.append(string_table);
+
+  // Write the file through a unique temporary one, since other abigen
+  // instances may be reading or writing it
+  std::error_code error;
+  stdfs::create_directories(stdfs::path(path).parent_path(), error);
+
+  return writeFileAtomically(path, buffer);
+}
+
+bool getProfileHeaderMaps(std::string &isystem_header_map,
+                          std::string &externc_isystem_header_map,
+                          const CompilerInstanceSettings &settings) {
+
+  isystem_header_map.clear();
+  externc_isystem_header_map.clear();
+
+  // Packed and stored profiles are already served from memory, and can not
+  // be enumerated
+  if (!settings.profile.archive_path.empty() ||
+      !settings.profile.manifest_path.empty()) {
+    return true;
+  }
+
+  std::string isystem_path;
+  std::string externc_isystem_path;
+  if (!getProfileHeaderMapPaths(isystem_path, externc_isystem_path,
+                                settings)) {
+    return false;
+  }
+
+  auto &cache = getHeaderMapCache();
+  auto &header_map_cache = cache.header_maps;
+
+  std::lock_guard<std::mutex> lock(cache.mutex);
+
+  // The folders are only scanned again after resetHeaderMapCache, so that the
+  // jobs of the same request all see the same maps
+  auto it = header_map_cache.find(isystem_path);
+  if (it == header_map_cache.end()) {
+    HeaderMapEntries isystem_entries;
+    HeaderMapEntries externc_isystem_entries;
+    buildProfileHeaderMapEntries(isystem_entries, externc_isystem_entries,
+                                 settings);
+
+    std::pair<std::string, std::string> header_maps;
+
+    if (!isystem_entries.empty()) {
+      if (!writeHeaderMap(isystem_path, isystem_entries)) {
+        std::cerr << "Failed to write the header map: " << isystem_path
+                  << "\n";
+        return false;
+      }
+
+      header_maps.first = isystem_path;
+    }
+
+    if (!externc_isystem_entries.empty()) {
+      if (!writeHeaderMap(externc_isystem_path, externc_isystem_entries)) {
+        std::cerr << "Failed to write the header map: "
+                  << externc_isystem_path << "\n";
+        return false;
+      }
+
+      header_maps.second = externc_isystem_path;
+    }
+
+    it = header_map_cache.insert({isystem_path, header_maps}).first;
+  }
+
+  isystem_header_map = it->second.first;
+  externc_isystem_header_map = it->second.second;
+
+  return true;
+}
+
+void resetHeaderMapCache() {
+  auto &cache = getHeaderMapCache();
+
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  cache.header_maps.clear();
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "compilerinstance.h"
+
+#include <map>
+#include <string>
+
+/// Maps each include name (i.e.: sys/types.h) to the absolute path of the
+/// file it resolves to
+using HeaderMapEntries = std::map<std::string, std::string>;
+
+/// Writes a clang header map (.hmap) file containing the given entries
+bool writeHeaderMap(const std::string &path, const HeaderMapEntries &entries);
+
+/// Returns the header maps for the profile search paths used by the given
+/// settings: one for the internal-isystem folders and one for the
+/// internal-externc-isystem ones, so that the headers keep their include
+/// group characteristics. Only the names that can be found in a single
+/// search folder are mapped; this keeps #include_next and the search order
+/// working as usual for all the other ones. The maps are built once (until
+/// resetHeaderMapCache is called) and saved in the cache folder; the paths
+/// are left empty when there is nothing to map (i.e.: packed or stored
+/// profiles)
+bool getProfileHeaderMaps(std::string &isystem_header_map,
+                          std::string &externc_isystem_header_map,
+                          const CompilerInstanceSettings &settings);
+
+/// Forgets the header maps returned so far, so that the next call to
+/// getProfileHeaderMaps scans the folders again; used by long-running
+/// processes, where the headers may change between two requests
+void resetHeaderMapCache();
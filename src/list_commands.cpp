@@ -32,6 +32,11 @@ bool listProfilesCommandHandler(ProfileManagerRef &profile_manager,
           std::cout << "  Name: " << profile.name << "\n";
           std::cout << "    Root path: " << profile.root_path << "\n";
           std::cout << "    Resource directory: " << profile.resource_dir
+                    << "\n";
+
+          std::cout << "    Target triple: "
+                    << (profile.target_triple.empty() ? "(host)"
+                                                      : profile.target_triple)
                     << "\n\n";
 
           std::cout << "    externc-isystem\n";
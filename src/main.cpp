@@ -21,6 +21,18 @@
 int main(int argc, char *argv[], char *envp[]) {
   static_cast<void>(envp);
 
+  // Client mode: the command is executed by a running abigen server
+  if (argc >= 3 && std::string(argv[1]) == "--connect") {
+    StringList arguments(argv + 3, argv + argc);
+
+    int exit_code;
+    if (!sendServerRequest(exit_code, argv[2], arguments)) {
+      return 1;
+    }
+
+    return exit_code;
+  }
+
   ProfileManagerRef profile_manager;
   auto status = ProfileManager::create(profile_manager);
   if (!status.succeeded()) {
@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "memoryusage.h"
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+std::uint64_t getPeakResidentSetSize() {
+#ifdef _WIN32
+  return 0U;
+
+#else
+  struct rusage resource_usage {};
+  if (getrusage(RUSAGE_SELF, &resource_usage) != 0) {
+    return 0U;
+  }
+
+  auto peak_resident_set_size =
+      static_cast<std::uint64_t>(resource_usage.ru_maxrss);
+
+#ifdef __APPLE__
+  // macOS reports bytes, while the other platforms report kilobytes
+  return peak_resident_set_size;
+#else
+  return peak_resident_set_size * 1024U;
+#endif
+#endif
+}
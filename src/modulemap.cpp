@@ -0,0 +1,288 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "modulemap.h"
+#include "declarationscanner.h"
+#include "directorywalker.h"
+#include "fileutils.h"
+#include "precompiledheader.h"
+#include "profilestorage.h"
+#include "std_filesystem.h"
+
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <unordered_set>
+
+namespace {
+/// A folder whose headers are exported as modules
+struct ModuleSearchFolder final {
+  /// The absolute folder path
+  stdfs::path path;
+
+  /// True for the internal-externc-isystem folders
+  bool externc{false};
+};
+
+/// Returns the folders to export, in search order
+std::vector<ModuleSearchFolder> getModuleSearchFolders(
+    const CompilerInstanceSettings &settings) {
+  std::vector<ModuleSearchFolder> folder_list;
+
+  // Packed and stored profiles are served from memory, and can not be
+  // enumerated
+  bool enumerate_profile = settings.profile.archive_path.empty() &&
+                           settings.profile.manifest_path.empty();
+
+  stdfs::path profile_root(settings.profile.root_path);
+
+  auto path_list_it = settings.profile.internal_isystem.find(settings.language);
+  if (enumerate_profile &&
+      path_list_it != settings.profile.internal_isystem.end()) {
+    for (const auto &path : path_list_it->second) {
+      folder_list.push_back({profile_root / path, false});
+    }
+  }
+
+  for (const auto &path : settings.additional_include_folders) {
+    std::error_code error;
+    auto absolute_path = stdfs::absolute(path, error);
+    if (!error) {
+      folder_list.push_back({absolute_path, false});
+    }
+  }
+
+  path_list_it =
+      settings.profile.internal_externc_isystem.find(settings.language);
+  if (enumerate_profile &&
+      path_list_it != settings.profile.internal_externc_isystem.end()) {
+    for (const auto &path : path_list_it->second) {
+      folder_list.push_back({profile_root / path, true});
+    }
+  }
+
+  return folder_list;
+}
+
+/// Turns the given relative path into a valid module name
+std::string getModuleName(const std::string &relative_path) {
+  std::string name = "abigen_";
+
+  for (auto c : relative_path) {
+    name.push_back(std::isalnum(static_cast<unsigned char>(c)) != 0 ? c : '_');
+  }
+
+  return name;
+}
+
+/// Builds the module map entries for the given settings
+void buildModuleMapEntries(ModuleMapEntryList &entries,
+                           const CompilerInstanceSettings &settings) {
+  entries = {};
+
+  std::unordered_set<std::string> visited_headers;
+  std::unordered_set<std::string> module_names;
+
+  for (const auto &folder : getModuleSearchFolders(settings)) {
+    std::error_code error;
+    if (!stdfs::is_directory(folder.path, error)) {
+      continue;
+    }
+
+    StringList file_list;
+    if (!enumerateFolderFiles(file_list, folder.path.string())) {
+      std::cerr << "Failed to enumerate the headers for the module map: "
+                << folder.path.string() << "\n";
+      continue;
+    }
+
+    for (const auto &relative_path : file_list) {
+      auto header_path = (folder.path / relative_path).lexically_normal();
+
+      // The module map lexer does not support escape sequences
+      auto header_path_str = header_path.string();
+      if (header_path_str.find('"') != std::string::npos ||
+          !visited_headers.insert(header_path_str).second) {
+        continue;
+      }
+
+      // Headers without a guard are usually meant to be included more than
+      // once (i.e.: with different __need_* macros), and stay textual
+      HeaderDeclarationIndex declaration_index;
+      if (!scanHeaderDeclarations(declaration_index, header_path_str,
+                                  settings.language) ||
+          (declaration_index.include_guard.empty() &&
+           !declaration_index.pragma_once)) {
+        continue;
+      }
+
+      ModuleMapEntry entry;
+      entry.name = getModuleName(relative_path);
+      entry.header_path = header_path_str;
+      entry.externc = folder.externc;
+
+      // The same relative path can be found in more than one folder
+      for (std::size_t i = 2U; !module_names.insert(entry.name).second; ++i) {
+        entry.name = getModuleName(relative_path) + "_" + std::to_string(i);
+      }
+
+      entries.push_back(std::move(entry));
+    }
+  }
+}
+
+/// Returns where the module map for the given settings should be saved
+bool getModuleMapPath(std::string &path,
+                      const CompilerInstanceSettings &settings) {
+  std::string cache_folder;
+  if (!getCacheFolderPath(cache_folder)) {
+    return false;
+  }
+
+  std::stringstream key;
+  key << settings.profile.name << "\n"
+      << settings.profile.root_path << "\n"
+      << settings.profile.archive_path << "\n"
+      << settings.profile.manifest_path << "\n"
+      << settings.language << "\n";
+
+  for (const auto &folder : settings.additional_include_folders) {
+    std::error_code error;
+    key << "-I" << stdfs::absolute(folder, error).string() << "\n";
+  }
+
+  auto file_name = getContentHash(key.str()) + ".modulemap";
+  path = (stdfs::path(cache_folder) / "modulemap" / file_name).string();
+
+  return true;
+}
+
+/// The module maps that have been written by this process
+struct ModuleMapCache final {
+  /// Guards the rest of the structure
+  std::mutex mutex;
+
+  /// Maps each module map path to whether it could be written
+  std::map<std::string, bool> module_maps;
+};
+
+/// Returns the module map cache
+ModuleMapCache &getModuleMapCache() {
+  static ModuleMapCache cache;
+  return cache;
+}
+}  // namespace
+
+bool writeModuleMap(const std::string &path,
+                    const ModuleMapEntryList &entries) {
+  std::stringstream buffer;
+  buffer << "// Generated by abigen\n";
+
+  for (const auto &entry : entries) {
+    buffer << "\nmodule " << entry.name << " [system]";
+    if (entry.externc) {
+      buffer << " [extern_c]";
+    }
+
+    buffer << " {\n"
+           << "  header \"" << entry.header_path << "\"\n"
+           << "  export *\n"
+           << "}\n";
+  }
+
+  auto contents = buffer.str();
+
+  // Rewriting the file would change its modification time, and clang would
+  // then rebuild every module that has been defined by it
+  {
+    std::ifstream input_file(path, std::ios::binary);
+    if (input_file) {
+      std::stringstream current_contents;
+      current_contents << input_file.rdbuf();
+
+      if (current_contents.str() == contents) {
+        return true;
+      }
+    }
+  }
+
+  // Write the file through a temporary one, since other abigen instances may
+  // be reading it
+  std::error_code error;
+  stdfs::create_directories(stdfs::path(path).parent_path(), error);
+
+  return writeFileAtomically(path, contents);
+}
+
+bool getModuleCachePath(std::string &path) {
+  path.clear();
+
+  std::string cache_folder;
+  if (!getCacheFolderPath(cache_folder)) {
+    return false;
+  }
+
+  path = (stdfs::path(cache_folder) / "modules").string();
+  return true;
+}
+
+bool getModuleMap(std::string &module_map_path,
+                  const CompilerInstanceSettings &settings) {
+  module_map_path.clear();
+
+  std::string path;
+  if (!getModuleMapPath(path, settings)) {
+    return false;
+  }
+
+  auto &cache = getModuleMapCache();
+  auto &module_map_cache = cache.module_maps;
+
+  std::lock_guard<std::mutex> lock(cache.mutex);
+
+  // The folders are only scanned again after resetModuleMapCache; the map is
+  // not rewritten when its contents do not change, so the modules that have
+  // already been built stay valid
+  auto it = module_map_cache.find(path);
+  if (it == module_map_cache.end()) {
+    ModuleMapEntryList entries;
+    buildModuleMapEntries(entries, settings);
+
+    bool succeeded = writeModuleMap(path, entries);
+    if (!succeeded) {
+      std::cerr << "Failed to write the module map: " << path << "\n";
+    }
+
+    it = module_map_cache.insert({path, succeeded}).first;
+  }
+
+  if (!it->second) {
+    return false;
+  }
+
+  module_map_path = path;
+  return true;
+}
+
+void resetModuleMapCache() {
+  auto &cache = getModuleMapCache();
+
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  cache.module_maps.clear();
+}
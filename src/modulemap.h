@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "compilerinstance.h"
+
+#include <string>
+#include <vector>
+
+/// A module exporting a single header
+struct ModuleMapEntry final {
+  /// The module name
+  std::string name;
+
+  /// The absolute path of the header
+  std::string header_path;
+
+  /// True if the header is found in an internal-externc-isystem folder, and
+  /// its declarations must have C language linkage
+  bool externc{false};
+};
+
+/// A list of module map entries
+using ModuleMapEntryList = std::vector<ModuleMapEntry>;
+
+/// Writes a clang module map declaring one system module for each of the
+/// given entries. The file is left untouched if its contents would not
+/// change, so that the modules built from it are not invalidated
+bool writeModuleMap(const std::string &path,
+                    const ModuleMapEntryList &entries);
+
+/// Returns the folder where clang keeps the modules built by abigen
+bool getModuleCachePath(std::string &path);
+
+/// Returns the module map for the headers found in the profile search paths
+/// and in the additional include folders used by the given settings. Each
+/// header that is protected by an include guard (or by #pragma once) gets
+/// its own module, so that a header that fails to compile does not prevent
+/// the other ones from being imported; all the other headers are included
+/// textually. The map is built once (until resetModuleMapCache is called)
+/// and saved in the cache folder; packed or stored profiles only contribute
+/// their additional include folders
+bool getModuleMap(std::string &module_map_path,
+                  const CompilerInstanceSettings &settings);
+
+/// Forgets the module maps returned so far, so that the next call to
+/// getModuleMap scans the folders again
+void resetModuleMapCache();
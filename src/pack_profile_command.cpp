@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cmdline.h"
+#include "profilearchive.h"
+#include "std_filesystem.h"
+
+/// Handler for the 'pack_profile' command
+bool packProfileCommandHandler(ProfileManagerRef &profile_manager,
+                               const LanguageManager &language_manager,
+                               const CommandLineOptions &cmdline_options) {
+  static_cast<void>(language_manager);
+
+  Profile profile;
+  auto prof_mgr_status =
+      profile_manager->get(profile, cmdline_options.profile_name);
+  if (!prof_mgr_status.succeeded()) {
+    std::cerr << prof_mgr_status.toString() << "\n";
+    return false;
+  }
+
+  auto output_path = cmdline_options.output;
+  if (output_path.empty()) {
+    output_path = (stdfs::path(profile.root_path) /
+                   ProfileArchive::kDefaultFileName)
+                      .string();
+  }
+
+  std::cerr << "Packing " << profile.root_path << " to " << output_path
+            << "\n";
+
+  auto status = ProfileArchive::pack(profile.root_path, output_path,
+                                     cmdline_options.compress_profile_archive);
+  if (!status.succeeded()) {
+    std::cerr << status.message() << "\n";
+    return false;
+  }
+
+  // Make sure the archive can be opened
+  ProfileArchiveRef archive;
+  status = ProfileArchive::create(archive, output_path);
+  if (!status.succeeded()) {
+    std::cerr << status.message() << "\n";
+    return false;
+  }
+
+  return true;
+}
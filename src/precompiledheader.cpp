@@ -0,0 +1,245 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "precompiledheader.h"
+#include "fileutils.h"
+#include "generate_utils.h"
+#include "profilestorage.h"
+#include "std_filesystem.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include <clang/Frontend/TextDiagnosticPrinter.h>
+#include <clang/Lex/Preprocessor.h>
+#include <clang/Parse/ParseAST.h>
+#include <clang/Serialization/ASTWriter.h>
+
+#if LLVM_MAJOR_VERSION >= 9
+#include <clang/Serialization/PCHContainerOperations.h>
+#else
+#include <clang/Frontend/PCHContainerOperations.h>
+#endif
+
+bool getCacheFolderPath(std::string &path) {
+  path.clear();
+
+  auto cache_home = std::getenv("XDG_CACHE_HOME");
+  if (cache_home != nullptr && *cache_home != '\0') {
+    path = (stdfs::path(cache_home) / "abigen").string();
+    return true;
+  }
+
+  auto home = std::getenv("HOME");
+  if (home != nullptr && *home != '\0') {
+    path = (stdfs::path(home) / ".cache" / "abigen").string();
+    return true;
+  }
+
+  return false;
+}
+
+bool getPrecompiledHeaderPath(std::string &path,
+                              const CompilerInstanceSettings &settings) {
+  path.clear();
+
+  std::string cache_folder;
+  if (!getCacheFolderPath(cache_folder)) {
+    return false;
+  }
+
+  // Everything that can change the contents of the precompiled header is
+  // part of the key; clang will also validate the file when loading it
+  std::stringstream key;
+  key << LLVM_MAJOR_VERSION << "." << LLVM_MINOR_VERSION << "\n"
+      << getProfileTargetTriple(settings.profile) << "\n"
+      << settings.profile.name << "\n"
+      << settings.profile.root_path << "\n"
+      << settings.profile.archive_path << "\n"
+      << settings.profile.manifest_path << "\n"
+      << settings.language << "\n"
+      << settings.language_standard << "\n"
+      << settings.enable_gnu_extensions << "\n"
+      << settings.use_modules << "\n";
+
+  for (const auto &folder : settings.additional_include_folders) {
+    std::error_code error;
+    key << "-I" << stdfs::absolute(folder, error).string() << "\n";
+  }
+
+  for (const auto &include : settings.base_includes) {
+    key << "-include" << include << "\n";
+  }
+
+  auto file_name = getContentHash(key.str()) + ".pch";
+  path = (stdfs::path(cache_folder) / "pch" / file_name).string();
+
+  return true;
+}
+
+CompilerInstance::Status buildPrecompiledHeader(
+    const CompilerInstanceSettings &settings, const std::string &output_path) {
+  // The base includes are parsed as a translation unit prefix; the
+  // precompiled header must never be used to build itself
+  auto prefix_settings = settings;
+  prefix_settings.precompiled_header.clear();
+
+  std::unique_ptr<clang::CompilerInstance> compiler;
+  auto status =
+      createClangCompilerInstance(compiler, prefix_settings, IASTVisitorRef(),
+                                  nullptr, clang::TU_Prefix);
+
+  if (!status.succeeded()) {
+    return status;
+  }
+
+  auto buffer = std::make_shared<clang::PCHBuffer>();
+
+#if LLVM_MAJOR_VERSION >= 9
+  compiler->setASTConsumer(llvm::make_unique<clang::PCHGenerator>(
+      compiler->getPreprocessor(), compiler->getModuleCache(), output_path, "",
+      buffer, llvm::ArrayRef<std::shared_ptr<clang::ModuleFileExtension>>()));
+#else
+  compiler->setASTConsumer(llvm::make_unique<clang::PCHGenerator>(
+      compiler->getPreprocessor(), output_path, "", buffer,
+      llvm::ArrayRef<std::shared_ptr<clang::ModuleFileExtension>>()));
+#endif
+
+  auto source_buffer = generateSourceBuffer({}, settings.base_includes);
+
+  auto &source_manager = compiler->getSourceManager();
+
+  clang::FileID file_id =
+      source_manager.createFileID(llvm::MemoryBuffer::getMemBuffer(
+          llvm::StringRef(source_buffer), llvm::StringRef("main.cpp")));
+
+  source_manager.setMainFileID(file_id);
+
+  std::string clang_output_buffer;
+  llvm::raw_string_ostream clang_output_stream(clang_output_buffer);
+
+  clang::DiagnosticsEngine &diagnostics_engine = compiler->getDiagnostics();
+
+  clang::TextDiagnosticPrinter diagnostic_consumer(
+      clang_output_stream, &diagnostics_engine.getDiagnosticOptions());
+
+  diagnostics_engine.setClient(&diagnostic_consumer, false);
+
+  clang::Preprocessor &preprocessor = compiler->getPreprocessor();
+
+  diagnostic_consumer.BeginSourceFile(compiler->getLangOpts(), &preprocessor);
+
+  clang::ParseAST(preprocessor, &compiler->getASTConsumer(),
+                  compiler->getASTContext(), false, clang::TU_Prefix);
+
+  diagnostic_consumer.EndSourceFile();
+
+  if (diagnostic_consumer.getNumErrors() != 0 || !buffer->IsComplete) {
+    clang_output_stream.flush();
+
+    return CompilerInstance::Status(
+        false, CompilerInstance::StatusCode::CompilationError,
+        clang_output_buffer);
+  }
+
+  // Write the file through a temporary one, so that other abigen instances
+  // never see a partially written precompiled header
+  std::error_code error;
+  stdfs::create_directories(stdfs::path(output_path).parent_path(), error);
+
+  std::string temp_output_path;
+  if (!createTemporaryFile(temp_output_path, output_path)) {
+    return CompilerInstance::Status(
+        false, CompilerInstance::StatusCode::PrecompiledHeaderError,
+        "Failed to create the precompiled header: " + output_path);
+  }
+
+  {
+    std::ofstream output_file(temp_output_path, std::ios::binary);
+    output_file.write(buffer->Data.data(),
+                      static_cast<std::streamsize>(buffer->Data.size()));
+
+    if (!output_file) {
+      output_file.close();
+      stdfs::remove(temp_output_path, error);
+
+      return CompilerInstance::Status(
+          false, CompilerInstance::StatusCode::PrecompiledHeaderError,
+          "Failed to write the precompiled header: " + temp_output_path);
+    }
+  }
+
+  stdfs::rename(temp_output_path, output_path, error);
+  if (error) {
+    stdfs::remove(temp_output_path, error);
+
+    return CompilerInstance::Status(
+        false, CompilerInstance::StatusCode::PrecompiledHeaderError,
+        "Failed to write the precompiled header: " + output_path);
+  }
+
+  return CompilerInstance::Status(true);
+}
+
+bool preparePrecompiledHeader(CompilerInstanceSettings &settings,
+                              bool force_rebuild, std::ostream &log) {
+  settings.precompiled_header.clear();
+  if (settings.base_includes.empty()) {
+    return true;
+  }
+
+  std::string precompiled_header_path;
+  if (!getPrecompiledHeaderPath(precompiled_header_path, settings)) {
+    log << "Failed to locate the cache folder\n";
+    return false;
+  }
+
+  // Make sure the cached file can still be loaded; clang rejects it if the
+  // profile headers have changed since it has been built
+  auto L_canBeLoaded = [&settings, &precompiled_header_path]() -> bool {
+    auto test_settings = settings;
+    test_settings.precompiled_header = precompiled_header_path;
+
+    std::unique_ptr<clang::CompilerInstance> compiler;
+    auto status = createClangCompilerInstance(compiler, test_settings);
+    return status.succeeded();
+  };
+
+  std::error_code error;
+  if (!force_rebuild && stdfs::exists(precompiled_header_path, error) &&
+      L_canBeLoaded()) {
+    settings.precompiled_header = precompiled_header_path;
+    return true;
+  }
+
+  log << "Precompiling the base includes to " << precompiled_header_path
+      << "\n";
+
+  auto status = buildPrecompiledHeader(settings, precompiled_header_path);
+  if (!status.succeeded()) {
+    log << status.toString() << "\n";
+    return false;
+  }
+
+  if (!L_canBeLoaded()) {
+    log << "The precompiled header could not be loaded\n";
+    return false;
+  }
+
+  settings.precompiled_header = precompiled_header_path;
+  return true;
+}
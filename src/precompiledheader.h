@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "compilerinstance.h"
+
+#include <ostream>
+#include <string>
+
+/// Returns the folder where abigen keeps its cached files; this is either
+/// $XDG_CACHE_HOME/abigen or ~/.cache/abigen
+bool getCacheFolderPath(std::string &path);
+
+/// Returns where the precompiled header for the given settings should be
+/// saved; the file name is derived from the profile, the language settings,
+/// the include folders and the base includes
+bool getPrecompiledHeaderPath(std::string &path,
+                              const CompilerInstanceSettings &settings);
+
+/// Precompiles the base includes found in the given settings, saving the
+/// result to the specified path
+CompilerInstance::Status buildPrecompiledHeader(
+    const CompilerInstanceSettings &settings, const std::string &output_path);
+
+/// Makes sure the precompiled header for the given settings exists and can
+/// be loaded, (re)building it if necessary; on success, the path is saved in
+/// the settings object. Nothing is done if there are no base includes. The
+/// progress and the errors are written to the given log
+bool preparePrecompiledHeader(CompilerInstanceSettings &settings,
+                              bool force_rebuild, std::ostream &log);
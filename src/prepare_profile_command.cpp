@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cmdline.h"
+#include "generate_utils.h"
+#include "precompiledheader.h"
+
+/// Handler for the 'prepare_profile' command
+bool prepareProfileCommandHandler(ProfileManagerRef &profile_manager,
+                                  const LanguageManager &language_manager,
+                                  const CommandLineOptions &cmdline_options) {
+  CompilerInstanceSettings compiler_settings;
+  if (!getCompilerInstanceSettings(compiler_settings, profile_manager,
+                                   language_manager, cmdline_options)) {
+    return false;
+  }
+
+  if (!preparePrecompiledHeader(compiler_settings, true, std::cerr)) {
+    return false;
+  }
+
+  std::cout << compiler_settings.precompiled_header << "\n";
+  return true;
+}
@@ -0,0 +1,420 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "profilearchive.h"
+#include "fileutils.h"
+#include "std_filesystem.h"
+#include "types.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Support/Compression.h>
+#include <llvm/Support/Endian.h>
+#include <llvm/Support/Error.h>
+
+namespace {
+/// The archive magic
+const char kArchiveMagic[8] = {'A', 'B', 'I', 'G', 'E', 'N', 'P', 'K'};
+
+/// The current archive version
+const std::uint32_t kArchiveVersion = 1U;
+
+/// Size of the archive header
+const std::uint64_t kHeaderSize = 32U;
+
+/// Size of a single table of contents entry
+const std::uint64_t kTableEntrySize = 40U;
+
+/// A single file inside the archive
+struct ArchiveEntry final {
+  /// Entry flags
+  std::uint32_t flags{0U};
+
+  /// Where the data is located, relative to the start of the archive
+  std::uint64_t data_offset{0U};
+
+  /// How many bytes are stored in the archive
+  std::uint64_t stored_size{0U};
+
+  /// The file size, once uncompressed
+  std::uint64_t original_size{0U};
+
+  /// The entry index, used to generate unique ids
+  std::uint64_t index{0U};
+};
+
+/// Rounds up the given offset to the next 8 byte boundary
+std::uint64_t alignOffset(std::uint64_t offset) {
+  return (offset + 7U) & ~static_cast<std::uint64_t>(7U);
+}
+
+/// Writes a little endian 32-bit integer to the given stream
+void writeUint32(std::ostream &stream, std::uint32_t value) {
+  char buffer[4];
+  llvm::support::endian::write32le(buffer, value);
+  stream.write(buffer, sizeof(buffer));
+}
+
+/// Writes a little endian 64-bit integer to the given stream
+void writeUint64(std::ostream &stream, std::uint64_t value) {
+  char buffer[8];
+  llvm::support::endian::write64le(buffer, value);
+  stream.write(buffer, sizeof(buffer));
+}
+}  // namespace
+
+const std::string ProfileArchive::kDefaultFileName = "profile.pack";
+
+/// Private class data
+struct ProfileArchive::PrivateData final {
+  /// The archive path
+  std::string path;
+
+  /// The memory mapped archive
+  std::unique_ptr<llvm::MemoryBuffer> archive_buffer;
+
+  /// The table of contents
+  llvm::StringMap<ArchiveEntry> file_map;
+
+  /// All the folders, implicitly defined by the file paths
+  llvm::StringMap<std::uint64_t> directory_map;
+};
+
+ProfileArchive::ProfileArchive(const std::string &path) : d(new PrivateData) {
+  d->path = path;
+
+  auto buffer_or_error =
+      llvm::MemoryBuffer::getFile(path, -1, false /* RequiresNullTerminator */);
+
+  if (!buffer_or_error) {
+    throw Status(false, StatusCode::IOError,
+                 "Failed to open the profile archive: " + path);
+  }
+
+  d->archive_buffer = std::move(buffer_or_error.get());
+
+  auto archive_data = d->archive_buffer->getBufferStart();
+  auto archive_size =
+      static_cast<std::uint64_t>(d->archive_buffer->getBufferSize());
+
+  if (archive_size < kHeaderSize ||
+      std::memcmp(archive_data, kArchiveMagic, sizeof(kArchiveMagic)) != 0) {
+    throw Status(false, StatusCode::InvalidArchive,
+                 "Not a profile archive: " + path);
+  }
+
+  auto version = llvm::support::endian::read32le(archive_data + 8U);
+  if (version != kArchiveVersion) {
+    throw Status(false, StatusCode::InvalidArchive,
+                 "Unsupported profile archive version: " + path);
+  }
+
+  auto entry_count = llvm::support::endian::read32le(archive_data + 12U);
+  auto string_table_offset =
+      llvm::support::endian::read64le(archive_data + 16U);
+  auto string_table_size = llvm::support::endian::read64le(archive_data + 24U);
+
+  auto table_end = kHeaderSize + entry_count * kTableEntrySize;
+  if (table_end > archive_size || string_table_offset < table_end ||
+      string_table_offset > archive_size ||
+      string_table_size > archive_size - string_table_offset) {
+    throw Status(false, StatusCode::InvalidArchive,
+                 "The profile archive is corrupted: " + path);
+  }
+
+  llvm::StringRef string_table(archive_data + string_table_offset,
+                               string_table_size);
+
+  d->directory_map.insert({"", entry_count + 1U});
+
+  for (std::uint32_t i = 0U; i < entry_count; ++i) {
+    auto entry_data = archive_data + kHeaderSize + i * kTableEntrySize;
+
+    auto path_offset = llvm::support::endian::read64le(entry_data);
+    auto path_length = llvm::support::endian::read32le(entry_data + 8U);
+
+    ArchiveEntry entry = {};
+    entry.flags = llvm::support::endian::read32le(entry_data + 12U);
+    entry.data_offset = llvm::support::endian::read64le(entry_data + 16U);
+    entry.stored_size = llvm::support::endian::read64le(entry_data + 24U);
+    entry.original_size = llvm::support::endian::read64le(entry_data + 32U);
+    entry.index = i + 1U;
+
+    // Make sure the data (and its null terminator) is inside the archive
+    if (path_offset > string_table_size ||
+        path_length > string_table_size - path_offset ||
+        entry.data_offset > archive_size ||
+        entry.stored_size >= archive_size - entry.data_offset) {
+      throw Status(false, StatusCode::InvalidArchive,
+                   "The profile archive is corrupted: " + path);
+    }
+
+    // Uncompressed entries are mapped as is, and clang relies on the null
+    // terminator to stop lexing
+    if ((entry.flags & ZlibCompressed) == 0U &&
+        archive_data[entry.data_offset + entry.stored_size] != '\0') {
+      throw Status(false, StatusCode::InvalidArchive,
+                   "The profile archive is corrupted: " + path);
+    }
+
+    auto entry_path = string_table.substr(path_offset, path_length);
+    d->file_map.insert({entry_path, entry});
+
+    // Register all the parent folders
+    for (auto separator = entry_path.rfind('/');
+         separator != llvm::StringRef::npos;
+         separator = entry_path.rfind('/')) {
+      entry_path = entry_path.substr(0, separator);
+
+      auto directory_id = entry_count + 1U + d->directory_map.size();
+      if (!d->directory_map.insert({entry_path, directory_id}).second) {
+        break;
+      }
+    }
+  }
+}
+
+ProfileArchive::Status ProfileArchive::create(ProfileArchiveRef &obj,
+                                              const std::string &path) {
+  obj.reset();
+
+  try {
+    auto ptr = new ProfileArchive(path);
+    obj.reset(ptr);
+
+    return Status(true);
+
+  } catch (const std::bad_alloc &) {
+    return Status(false, StatusCode::MemoryAllocationFailure);
+
+  } catch (const Status &status) {
+    return status;
+  }
+}
+
+ProfileArchive::Status ProfileArchive::pack(const std::string &profile_root,
+                                            const std::string &output_path,
+                                            bool compress) {
+  if (compress && !llvm::zlib::isAvailable()) {
+    return Status(false, StatusCode::CompressionError,
+                  "zlib support is not available");
+  }
+
+  auto root_path = stdfs::absolute(profile_root);
+
+  StringList file_list;
+  if (!enumerateProfileFiles(file_list, profile_root)) {
+    return Status(false, StatusCode::IOError,
+                  "Failed to enumerate the profile files");
+  }
+
+  // Never pack the output file, in case it is saved inside the profile
+  auto absolute_output_path = stdfs::absolute(output_path);
+
+  file_list.erase(
+      std::remove_if(file_list.begin(), file_list.end(),
+                     [&](const std::string &path) -> bool {
+                       return root_path / path == absolute_output_path;
+                     }),
+      file_list.end());
+
+  // Build the string table
+  std::string string_table;
+  std::vector<std::uint64_t> path_offsets;
+
+  for (const auto &path : file_list) {
+    path_offsets.push_back(string_table.size());
+    string_table += path;
+  }
+
+  auto string_table_offset =
+      kHeaderSize + file_list.size() * kTableEntrySize;
+
+  // The archive is written to a temporary file, and only renamed over the
+  // output path once it is complete
+  std::string temporary_path;
+  if (!createTemporaryFile(temporary_path, output_path)) {
+    return Status(false, StatusCode::IOError,
+                  "Failed to create the profile archive: " + output_path);
+  }
+
+  // Write the file data first, since the stored sizes are only known once
+  // the files have been compressed
+  std::fstream output_file(temporary_path, std::ios::binary | std::ios::in |
+                                               std::ios::out | std::ios::trunc);
+
+  auto L_discardOutput = [&output_file, &temporary_path]() -> void {
+    output_file.close();
+
+    std::error_code error;
+    stdfs::remove(temporary_path, error);
+  };
+
+  if (!output_file) {
+    L_discardOutput();
+    return Status(false, StatusCode::IOError,
+                  "Failed to create the profile archive: " + output_path);
+  }
+
+  std::vector<ArchiveEntry> entry_list;
+  auto data_offset = alignOffset(string_table_offset + string_table.size());
+
+  for (const auto &path : file_list) {
+    std::ifstream input_file((root_path / path).string(), std::ios::binary);
+    std::string file_contents((std::istreambuf_iterator<char>(input_file)),
+                              std::istreambuf_iterator<char>());
+
+    if (!input_file.eof() && !input_file.good()) {
+      L_discardOutput();
+      return Status(false, StatusCode::IOError,
+                    "Failed to read the following file: " + path);
+    }
+
+    ArchiveEntry entry = {};
+    entry.data_offset = data_offset;
+    entry.original_size = file_contents.size();
+
+    llvm::SmallVector<char, 0> compressed_contents;
+    llvm::StringRef stored_contents = file_contents;
+
+    if (compress && !file_contents.empty()) {
+      auto error = llvm::zlib::compress(file_contents, compressed_contents);
+      if (error) {
+        llvm::consumeError(std::move(error));
+        L_discardOutput();
+        return Status(false, StatusCode::CompressionError,
+                      "Failed to compress the following file: " + path);
+      }
+
+      // Only keep the compressed data if it is actually smaller
+      if (compressed_contents.size() < file_contents.size()) {
+        entry.flags |= ZlibCompressed;
+        stored_contents = llvm::StringRef(compressed_contents.data(),
+                                          compressed_contents.size());
+      }
+    }
+
+    entry.stored_size = stored_contents.size();
+
+    output_file.seekp(static_cast<std::streamoff>(data_offset));
+    output_file.write(stored_contents.data(),
+                      static_cast<std::streamsize>(stored_contents.size()));
+    output_file.put('\0');
+
+    data_offset = alignOffset(data_offset + entry.stored_size + 1U);
+    entry_list.push_back(entry);
+  }
+
+  // Write the header, the table of contents and the string table
+  output_file.seekp(0);
+  output_file.write(kArchiveMagic, sizeof(kArchiveMagic));
+  writeUint32(output_file, kArchiveVersion);
+  writeUint32(output_file, static_cast<std::uint32_t>(entry_list.size()));
+  writeUint64(output_file, string_table_offset);
+  writeUint64(output_file, string_table.size());
+
+  for (std::size_t i = 0U; i < entry_list.size(); ++i) {
+    const auto &entry = entry_list.at(i);
+    auto path_size = static_cast<std::uint32_t>(file_list.at(i).size());
+
+    writeUint64(output_file, path_offsets.at(i));
+    writeUint32(output_file, path_size);
+    writeUint32(output_file, entry.flags);
+    writeUint64(output_file, entry.data_offset);
+    writeUint64(output_file, entry.stored_size);
+    writeUint64(output_file, entry.original_size);
+  }
+
+  output_file.write(string_table.data(),
+                    static_cast<std::streamsize>(string_table.size()));
+
+  output_file.flush();
+  if (!output_file) {
+    L_discardOutput();
+    return Status(false, StatusCode::IOError,
+                  "Failed to write the profile archive: " + output_path);
+  }
+
+  output_file.close();
+
+  std::error_code error;
+  stdfs::rename(temporary_path, output_path, error);
+  if (error) {
+    stdfs::remove(temporary_path, error);
+    return Status(false, StatusCode::IOError,
+                  "Failed to write the profile archive: " + output_path);
+  }
+
+  return Status(true);
+}
+
+ProfileArchive::~ProfileArchive() {}
+
+bool ProfileArchive::lookup(ProfileStorageEntry &entry,
+                            llvm::StringRef relative_path) const {
+  entry = {};
+
+  auto file_it = d->file_map.find(relative_path);
+  if (file_it != d->file_map.end()) {
+    entry.size = file_it->second.original_size;
+    entry.id = file_it->second.index;
+    return true;
+  }
+
+  auto directory_it = d->directory_map.find(relative_path);
+  if (directory_it != d->directory_map.end()) {
+    entry.is_directory = true;
+    entry.id = directory_it->second;
+    return true;
+  }
+
+  return false;
+}
+
+std::unique_ptr<llvm::MemoryBuffer> ProfileArchive::getFile(
+    llvm::StringRef relative_path, llvm::StringRef buffer_name) const {
+  auto file_it = d->file_map.find(relative_path);
+  if (file_it == d->file_map.end()) {
+    return nullptr;
+  }
+
+  const auto &entry = file_it->second;
+  llvm::StringRef stored_contents(
+      d->archive_buffer->getBufferStart() + entry.data_offset,
+      entry.stored_size);
+
+  if ((entry.flags & ZlibCompressed) == 0U) {
+    // The data is followed by a null byte, so the mapping can be used as is
+    return llvm::MemoryBuffer::getMemBuffer(stored_contents, buffer_name,
+                                            true /* RequiresNullTerminator */);
+  }
+
+  llvm::SmallVector<char, 0> file_contents;
+  auto error = llvm::zlib::uncompress(stored_contents, file_contents,
+                                      entry.original_size);
+  if (error) {
+    llvm::consumeError(std::move(error));
+    return nullptr;
+  }
+
+  return llvm::MemoryBuffer::getMemBufferCopy(
+      llvm::StringRef(file_contents.data(), file_contents.size()),
+      buffer_name);
+}
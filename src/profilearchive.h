@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "istatus.h"
+#include "profilestorage.h"
+
+#include <string>
+
+class ProfileArchive;
+
+/// A reference to a ProfileArchive object
+using ProfileArchiveRef = std::shared_ptr<ProfileArchive>;
+
+/// A packed profile: a single file containing all the profile headers, with
+/// a table of contents that is loaded in a hash table when the archive is
+/// opened. The file is memory mapped, and uncompressed entries are served
+/// directly from the mapping.
+///
+///   Header (32 bytes)
+///     char     magic[8]             "ABIGENPK"
+///     uint32_t version
+///     uint32_t entry_count
+///     uint64_t string_table_offset
+///     uint64_t string_table_size
+///
+///   Table of contents (entry_count * 40 bytes)
+///     uint64_t path_offset          Relative to the string table
+///     uint32_t path_length
+///     uint32_t flags                See ProfileArchive::EntryFlags
+///     uint64_t data_offset          Absolute
+///     uint64_t stored_size
+///     uint64_t original_size
+///
+///   String table, followed by the file data. Each file is followed by a
+///   null byte that is not included in its size.
+///
+/// All the integers are stored in little endian byte order.
+class ProfileArchive final : public IProfileStorage {
+  struct PrivateData;
+
+  /// Private class data
+  std::unique_ptr<PrivateData> d;
+
+  /// Private constructor; use ::create() instead
+  ProfileArchive(const std::string &path);
+
+ public:
+  /// Status code, used with ProfileArchive::Status
+  enum class StatusCode {
+    MemoryAllocationFailure,
+    IOError,
+    InvalidArchive,
+    CompressionError,
+    Unknown
+  };
+
+  /// Status object
+  using Status = IStatus<StatusCode>;
+
+  /// Entry flags
+  enum EntryFlags : std::uint32_t { ZlibCompressed = 1U };
+
+  /// The default archive name, inside the profile root folder
+  static const std::string kDefaultFileName;
+
+  /// Opens the given profile archive
+  static Status create(ProfileArchiveRef &obj, const std::string &path);
+
+  /// Packs all the files inside the given profile root folder (except for
+  /// the profile.json file and the archive itself)
+  static Status pack(const std::string &profile_root,
+                     const std::string &output_path, bool compress);
+
+  /// Destructor
+  virtual ~ProfileArchive();
+
+  /// Looks up the given path; returns false if it does not exist
+  virtual bool lookup(ProfileStorageEntry &entry,
+                      llvm::StringRef relative_path) const override;
+
+  /// Returns the contents of the given file
+  virtual std::unique_ptr<llvm::MemoryBuffer> getFile(
+      llvm::StringRef relative_path,
+      llvm::StringRef buffer_name) const override;
+
+  /// Disable the copy constructor
+  ProfileArchive(const ProfileArchive &other) = delete;
+
+  /// Disable the assignment operator
+  ProfileArchive &operator=(const ProfileArchive &other) = delete;
+};
@@ -0,0 +1,294 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "profilefilesystem.h"
+#include "profilearchive.h"
+#include "profilestore.h"
+
+#include <iostream>
+#include <map>
+#include <mutex>
+
+#include <llvm/ADT/Hashing.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+
+namespace {
+/// A file opened from a profile storage
+class ProfileFile final : public vfs::File {
+  /// The storage containing the file
+  ProfileStorageRef storage;
+
+  /// The file path, relative to the storage root
+  std::string relative_path;
+
+  /// The file status
+  vfs::Status file_status;
+
+ public:
+  ProfileFile(ProfileStorageRef storage, const std::string &relative_path,
+              const vfs::Status &file_status)
+      : storage(storage),
+        relative_path(relative_path),
+        file_status(file_status) {}
+
+  virtual ~ProfileFile() override = default;
+
+  virtual llvm::ErrorOr<vfs::Status> status() override { return file_status; }
+
+  virtual llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> getBuffer(
+      const llvm::Twine &name, int64_t file_size, bool requires_null_terminator,
+      bool is_volatile) override {
+    static_cast<void>(file_size);
+    static_cast<void>(requires_null_terminator);
+    static_cast<void>(is_volatile);
+
+    auto buffer = storage->getFile(relative_path, name.str());
+    if (!buffer) {
+      return std::make_error_code(std::errc::io_error);
+    }
+
+    return llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>>(
+        std::move(buffer));
+  }
+
+  virtual std::error_code close() override { return std::error_code(); }
+};
+
+/// The file systems created so far, shared by all the compiler instances
+struct FileSystemCache final {
+  /// Guards the rest of the structure
+  std::mutex mutex;
+
+  /// Maps each archive or manifest path to its file system
+  std::map<std::string, FileSystemRef> file_systems;
+};
+
+/// Returns the file system cache
+FileSystemCache &getFileSystemCache() {
+  static FileSystemCache cache;
+  return cache;
+}
+}  // namespace
+
+/// Private class data
+struct ProfileFileSystem::PrivateData final {
+  /// Where the storage is mounted
+  std::string mount_point;
+
+  /// The storage containing the profile files
+  ProfileStorageRef storage;
+
+  /// The file system used for the paths outside of the mount point
+  FileSystemRef underlying_file_system;
+
+  /// The device id used for the unique ids of the files
+  std::uint64_t device_id{0U};
+
+  /// The current working directory
+  std::string working_directory;
+
+  /// Makes the given path absolute and normalized; returns true (along with
+  /// the path relative to the storage root) if it is below the mount point
+  bool getRelativePath(llvm::SmallString<256> &absolute_path,
+                       llvm::StringRef &relative_path,
+                       const llvm::Twine &path) const {
+    absolute_path.clear();
+    path.toVector(absolute_path);
+
+    if (!llvm::sys::path::is_absolute(absolute_path)) {
+      llvm::SmallString<256> path_suffix(absolute_path);
+      absolute_path = working_directory;
+      llvm::sys::path::append(absolute_path, path_suffix);
+    }
+
+    llvm::sys::path::remove_dots(absolute_path, true);
+
+    llvm::StringRef absolute_path_ref = absolute_path;
+    if (!absolute_path_ref.startswith(mount_point)) {
+      return false;
+    }
+
+    relative_path = absolute_path_ref.substr(mount_point.size());
+    if (relative_path.empty()) {
+      return true;
+    }
+
+    if (relative_path.front() != '/') {
+      return false;
+    }
+
+    relative_path = relative_path.substr(1);
+    return true;
+  }
+};
+
+ProfileFileSystem::ProfileFileSystem(const std::string &mount_point,
+                                     ProfileStorageRef storage,
+                                     FileSystemRef underlying_file_system)
+    : d(new PrivateData) {
+  llvm::SmallString<256> normalized_mount_point(mount_point);
+  llvm::sys::fs::make_absolute(normalized_mount_point);
+  llvm::sys::path::remove_dots(normalized_mount_point, true);
+
+  d->mount_point = normalized_mount_point.str();
+  d->storage = storage;
+  d->underlying_file_system = underlying_file_system;
+  d->device_id = static_cast<std::uint64_t>(llvm::hash_value(d->mount_point));
+
+  llvm::SmallString<256> working_directory;
+  if (!llvm::sys::fs::current_path(working_directory)) {
+    d->working_directory = working_directory.str();
+  }
+}
+
+ProfileFileSystem::~ProfileFileSystem() {}
+
+llvm::ErrorOr<vfs::Status> ProfileFileSystem::status(const llvm::Twine &path) {
+  // The storage is authoritative below the mount point, so a miss never
+  // reaches the real file system
+  llvm::SmallString<256> absolute_path;
+  llvm::StringRef relative_path;
+  if (!d->getRelativePath(absolute_path, relative_path, path)) {
+    return d->underlying_file_system->status(path);
+  }
+
+  ProfileStorageEntry entry;
+  if (!d->storage->lookup(entry, relative_path)) {
+    return std::make_error_code(std::errc::no_such_file_or_directory);
+  }
+
+  auto file_type = entry.is_directory ? llvm::sys::fs::file_type::directory_file
+                                      : llvm::sys::fs::file_type::regular_file;
+
+  auto permissions = entry.is_directory
+                         ? static_cast<llvm::sys::fs::perms>(
+                               llvm::sys::fs::all_read | llvm::sys::fs::all_exe)
+                         : llvm::sys::fs::all_read;
+
+  return vfs::Status(absolute_path.str(),
+                     llvm::sys::fs::UniqueID(d->device_id, entry.id),
+                     llvm::sys::TimePoint<>(), 0U, 0U, entry.size, file_type,
+                     permissions);
+}
+
+llvm::ErrorOr<std::unique_ptr<vfs::File>> ProfileFileSystem::openFileForRead(
+    const llvm::Twine &path) {
+  llvm::SmallString<256> absolute_path;
+  llvm::StringRef relative_path;
+  if (!d->getRelativePath(absolute_path, relative_path, path)) {
+    return d->underlying_file_system->openFileForRead(path);
+  }
+
+  auto status_or_error = status(absolute_path);
+  if (!status_or_error) {
+    return status_or_error.getError();
+  }
+
+  const auto &file_status = status_or_error.get();
+  if (file_status.isDirectory()) {
+    return std::make_error_code(std::errc::is_a_directory);
+  }
+
+  return std::unique_ptr<vfs::File>(
+      new ProfileFile(d->storage, relative_path.str(), file_status));
+}
+
+vfs::directory_iterator ProfileFileSystem::dir_begin(const llvm::Twine &dir,
+                                                     std::error_code &error) {
+  llvm::SmallString<256> absolute_path;
+  llvm::StringRef relative_path;
+  if (!d->getRelativePath(absolute_path, relative_path, dir)) {
+    return d->underlying_file_system->dir_begin(dir, error);
+  }
+
+  error = std::make_error_code(std::errc::no_such_file_or_directory);
+  return vfs::directory_iterator();
+}
+
+llvm::ErrorOr<std::string> ProfileFileSystem::getCurrentWorkingDirectory()
+    const {
+  return d->working_directory;
+}
+
+std::error_code ProfileFileSystem::setCurrentWorkingDirectory(
+    const llvm::Twine &path) {
+  d->working_directory = path.str();
+  return d->underlying_file_system->setCurrentWorkingDirectory(path);
+}
+
+bool getProfileFileSystem(FileSystemRef &file_system, const Profile &profile) {
+  file_system = vfs::getRealFileSystem();
+
+  // Packed archives take precedence over the header store
+  const auto &storage_path = !profile.archive_path.empty()
+                                 ? profile.archive_path
+                                 : profile.manifest_path;
+
+  if (storage_path.empty()) {
+    return true;
+  }
+
+  auto &cache = getFileSystemCache();
+  auto &file_system_cache = cache.file_systems;
+
+  std::lock_guard<std::mutex> lock(cache.mutex);
+
+  auto it = file_system_cache.find(storage_path);
+  if (it != file_system_cache.end()) {
+    file_system = it->second;
+    return true;
+  }
+
+  ProfileStorageRef storage;
+
+  if (!profile.archive_path.empty()) {
+    ProfileArchiveRef archive;
+    auto status = ProfileArchive::create(archive, profile.archive_path);
+    if (!status.succeeded()) {
+      std::cerr << status.message() << "\n";
+      return false;
+    }
+
+    storage = archive;
+
+  } else {
+    ProfileStoreRef store;
+    auto status =
+        ProfileStore::create(store, profile.manifest_path, profile.store_root);
+    if (!status.succeeded()) {
+      std::cerr << status.message() << "\n";
+      return false;
+    }
+
+    storage = store;
+  }
+
+  file_system = new ProfileFileSystem(profile.root_path, storage,
+                                      vfs::getRealFileSystem());
+
+  file_system_cache.insert({storage_path, file_system});
+
+  return true;
+}
+
+void resetProfileFileSystemCache() {
+  auto &cache = getFileSystemCache();
+
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  cache.file_systems.clear();
+}
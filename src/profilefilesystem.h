@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "profilemanager.h"
+#include "profilestorage.h"
+
+// clang-format off
+#if LLVM_MAJOR_VERSION >= 8
+  #include <llvm/Support/VirtualFileSystem.h>
+  namespace vfs = llvm::vfs;
+#else
+  #include <clang/Basic/VirtualFileSystem.h>
+  namespace vfs = clang::vfs;
+#endif
+// clang-format on
+
+/// A reference to a virtual file system object
+using FileSystemRef = llvm::IntrusiveRefCntPtr<vfs::FileSystem>;
+
+/// A read-only file system that exposes the contents of a profile storage
+/// under the given mount point (usually the profile root folder). The
+/// storage is authoritative below the mount point, so a missing header costs
+/// a single hash lookup; all the other paths are forwarded to the underlying
+/// file system
+class ProfileFileSystem final : public vfs::FileSystem {
+  struct PrivateData;
+
+  /// Private class data
+  std::unique_ptr<PrivateData> d;
+
+ public:
+  /// Constructor
+  ProfileFileSystem(const std::string &mount_point, ProfileStorageRef storage,
+                    FileSystemRef underlying_file_system);
+
+  /// Destructor
+  virtual ~ProfileFileSystem() override;
+
+  /// Returns the status of the given file or folder
+  virtual llvm::ErrorOr<vfs::Status> status(const llvm::Twine &path) override;
+
+  /// Opens the given file
+  virtual llvm::ErrorOr<std::unique_ptr<vfs::File>> openFileForRead(
+      const llvm::Twine &path) override;
+
+  /// Folder enumeration is only supported outside of the mount point
+  virtual vfs::directory_iterator dir_begin(const llvm::Twine &dir,
+                                            std::error_code &error) override;
+
+  /// Returns the current working directory
+  virtual llvm::ErrorOr<std::string> getCurrentWorkingDirectory()
+      const override;
+
+  /// Sets the current working directory, used to resolve relative paths
+  virtual std::error_code setCurrentWorkingDirectory(
+      const llvm::Twine &path) override;
+};
+
+/// Returns the file system that should be used when parsing with the given
+/// profile; this is the real file system, with the packed profile headers or
+/// the stored ones (if any) mounted on top of the profile root folder. File
+/// systems are cached, and shared across all the compiler instances
+bool getProfileFileSystem(FileSystemRef &file_system, const Profile &profile);
+
+/// Forgets the file systems returned so far, so that the archives and the
+/// manifests are opened again by the next call to getProfileFileSystem; used
+/// by long-running processes, where a profile may be packed or stored again
+/// between two requests
+void resetProfileFileSystemCache();
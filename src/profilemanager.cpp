@@ -15,9 +15,17 @@
  */
 
 #include "profilemanager.h"
+#include "fileutils.h"
+#include "profilearchive.h"
+#include "profilestore.h"
 #include "std_filesystem.h"
 
 #include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <unordered_set>
 
 #include <json11.hpp>
 
@@ -43,8 +51,15 @@ bool getProfilesRootPath(std::string &path) {
   return false;
 }
 
+/// Returns the path of the header store, shared by all the profiles found
+/// in the given profiles root folder
+std::string getStoreRootPath(const std::string &profiles_root) {
+  return (stdfs::path(profiles_root).parent_path() / "store").string();
+}
+
 /// Loads the profile located at the given path
-bool loadProfile(Profile &profile, const stdfs::path &path) {
+bool loadProfile(Profile &profile, const stdfs::path &path,
+                 const std::string &store_root) {
   profile = {};
 
   std::ifstream profile_file(path.string());
@@ -59,6 +74,20 @@ bool loadProfile(Profile &profile, const stdfs::path &path) {
 
   profile.root_path = path.parent_path();
 
+  auto archive_path = path.parent_path() / ProfileArchive::kDefaultFileName;
+
+  std::error_code error;
+  if (stdfs::is_regular_file(archive_path, error)) {
+    profile.archive_path = archive_path.string();
+  }
+
+  profile.store_root = store_root;
+
+  auto manifest_path = path.parent_path() / ProfileStore::kManifestFileName;
+  if (stdfs::is_regular_file(manifest_path, error)) {
+    profile.manifest_path = manifest_path.string();
+  }
+
   if (!json["name"].is_string()) {
     return false;
   }
@@ -71,6 +100,23 @@ bool loadProfile(Profile &profile, const stdfs::path &path) {
 
   profile.resource_dir = json["resource-dir"].string_value();
 
+  // The target settings are optional, and default to the host target
+  if (!json["target-triple"].is_null()) {
+    if (!json["target-triple"].is_string()) {
+      return false;
+    }
+
+    profile.target_triple = json["target-triple"].string_value();
+  }
+
+  if (!json["data-layout"].is_null()) {
+    if (!json["data-layout"].is_string()) {
+      return false;
+    }
+
+    profile.data_layout = json["data-layout"].string_value();
+  }
+
   if (!json["c"].is_object()) {
     return false;
   }
@@ -137,38 +183,162 @@ bool loadProfile(Profile &profile, const stdfs::path &path) {
   return true;
 }
 
-/// Enumerates all the profiles found in the specified data directory
-bool enumerateProfiles(std::unordered_map<std::string, Profile> &profile_list,
-                       const std::string &profile_root_folder) {
-  profile_list = {};
+/// The name of the profile index file, located in the profiles root folder
+const std::string kProfileIndexFileName = "profiles.json";
 
-  try {
-    std::unordered_map<std::string, Profile> output;
+/// The maximum folder depth at which profiles are searched when the profile
+/// index is missing (i.e.: <distribution>/<version>/profile.json)
+const std::size_t kMaxProfileSearchDepth = 4U;
 
-    stdfs::recursive_directory_iterator it(profile_root_folder);
-    for (const auto &p : it) {
-      if (!stdfs::is_regular_file(p.path()) ||
-          p.path().filename().string() != "profile.json") {
-        continue;
-      }
+/// Maps each profile name to the path of its profile.json file
+using ProfileIndex = std::map<std::string, std::string>;
+
+/// Loads the profile index file from the specified data directory
+bool loadProfileIndex(ProfileIndex &profile_index,
+                      const std::string &profile_root_folder) {
+  profile_index = {};
+
+  auto index_path = stdfs::path(profile_root_folder) / kProfileIndexFileName;
+
+  std::ifstream index_file(index_path.string());
+  if (!index_file) {
+    return false;
+  }
+
+  std::string json_index((std::istreambuf_iterator<char>(index_file)),
+                         std::istreambuf_iterator<char>());
+
+  std::string error_messages;
+  const auto json = json11::Json::parse(json_index, error_messages);
+  if (!json["profiles"].is_array()) {
+    return false;
+  }
+
+  ProfileIndex output;
+
+  for (const auto &item : json["profiles"].array_items()) {
+    if (!item["name"].is_string() || !item["path"].is_string()) {
+      return false;
+    }
+
+    auto profile_path =
+        stdfs::path(profile_root_folder) / item["path"].string_value();
+
+    if (!output.insert({item["name"].string_value(), profile_path.string()})
+             .second) {
+      return false;
+    }
+  }
+
+  profile_index = std::move(output);
+  return true;
+}
+
+/// Saves the profile index to the specified data directory
+bool saveProfileIndex(const ProfileIndex &profile_index,
+                      const std::string &profile_root_folder) {
+  auto index_path = stdfs::path(profile_root_folder) / kProfileIndexFileName;
+
+  std::stringstream buffer;
+  buffer << "{\n  \"profiles\": [";
+
+  for (auto it = profile_index.begin(); it != profile_index.end(); ++it) {
+    auto relative_path = stdfs::path(it->second)
+                             .lexically_relative(profile_root_folder)
+                             .generic_string();
+
+    buffer << (it == profile_index.begin() ? "\n" : ",\n\n");
+    buffer << "    {\n"
+           << "      \"name\": " << json11::Json(it->first).dump() << ",\n"
+           << "      \"path\": " << json11::Json(relative_path).dump() << "\n"
+           << "    }";
+  }
+
+  buffer << "\n  ]\n}\n";
+
+  // Other processes may be enumerating the profiles at the same time
+  return writeFileAtomically(index_path.string(), buffer.str());
+}
+
+/// Searches the specified data directory for profile.json files, skipping
+/// the ones that are already known; this never descends into a folder that
+/// contains a profile (i.e. the profile headers). Profiles whose name is
+/// already taken are skipped with a warning
+void scanProfiles(ProfileIndex &profile_index, const stdfs::path &folder,
+                  std::size_t depth,
+                  const std::unordered_set<std::string> &known_profile_paths) {
+  auto profile_path = folder / "profile.json";
+
+  std::error_code error;
+  if (stdfs::is_regular_file(profile_path, error)) {
+    if (known_profile_paths.count(
+            profile_path.lexically_normal().string()) != 0U) {
+      return;
+    }
 
-      auto current_path = p.path();
+    Profile profile;
+    if (!loadProfile(profile, profile_path, std::string())) {
+      return;
+    }
+
+    auto insert_status =
+        profile_index.insert({profile.name, profile_path.string()});
+
+    if (!insert_status.second) {
+      std::cerr << "Warning: the profile at " << profile_path.string()
+                << " has been skipped, since its name (" << profile.name
+                << ") is already used by " << insert_status.first->second
+                << "\n";
+    }
+
+    return;
+  }
+
+  if (depth >= kMaxProfileSearchDepth) {
+    return;
+  }
 
-      Profile profile;
-      if (!loadProfile(profile, current_path)) {
+  for (const auto &p : stdfs::directory_iterator(folder)) {
+    if (!stdfs::is_directory(p.path(), error)) {
+      continue;
+    }
+
+    scanProfiles(profile_index, p.path(), depth + 1U, known_profile_paths);
+  }
+}
+
+/// Enumerates all the profiles found in the specified data directory, using
+/// the profile index whenever possible; the profiles themselves are loaded
+/// on demand
+bool enumerateProfiles(ProfileIndex &profile_index,
+                       const std::string &profile_root_folder) {
+  profile_index = {};
+
+  // The index is shipped with the profiles, so it may not list the folders
+  // that have been added (or removed) by hand. The removed ones are dropped,
+  // and the tree is still scanned for new profiles; only the folders of the
+  // indexed profiles (where most of the files are) are skipped
+  ProfileIndex output;
+  std::unordered_set<std::string> known_profile_paths;
+
+  if (loadProfileIndex(output, profile_root_folder)) {
+    for (auto it = output.begin(); it != output.end();) {
+      std::error_code error;
+      if (!stdfs::is_regular_file(it->second, error)) {
+        it = output.erase(it);
         continue;
       }
 
-      if (profile_list.find(profile.name) != profile_list.end()) {
-        return false;
-      }
+      known_profile_paths.insert(
+          stdfs::path(it->second).lexically_normal().string());
 
-      output.insert({profile.name, profile});
+      ++it;
     }
+  }
 
-    profile_list = std::move(output);
-    output.clear();
-
+  try {
+    scanProfiles(output, profile_root_folder, 0U, known_profile_paths);
+    profile_index = std::move(output);
     return true;
 
   } catch (...) {
@@ -184,9 +354,17 @@ struct ProfileManager::PrivateData final {
   // default to the system-wide one if it is not found
   std::string profiles_root;
 
-  /// This is the list of discovered profiles, built scanning the
-  /// `profiles_root` folder
+  /// The profile index, mapping each profile name to its profile.json file
+  ProfileIndex profile_index;
+
+  /// The profiles that have been loaded so far
   ProfileMap profile_descriptors;
+
+  /// Set to true once every profile in the index has been loaded
+  bool all_profiles_loaded{false};
+
+  /// Guards the profile cache
+  std::mutex profile_cache_mutex;
 };
 
 ProfileManager::ProfileManager() : d(new PrivateData) {
@@ -195,12 +373,12 @@ ProfileManager::ProfileManager() : d(new PrivateData) {
                  "Failed to locate a suitable profile root folder");
   }
 
-  if (!enumerateProfiles(d->profile_descriptors, d->profiles_root)) {
+  if (!enumerateProfiles(d->profile_index, d->profiles_root)) {
     throw Status(false, StatusCode::ProfileEnumerationError,
                  "Failed to locate a suitable profile root folder");
   }
 
-  if (d->profile_descriptors.empty()) {
+  if (d->profile_index.empty()) {
     throw Status(false, StatusCode::ProfilesMissing,
                  "No profile could be found");
   }
@@ -228,16 +406,108 @@ ProfileManager::~ProfileManager() {}
 
 ProfileManager::Status ProfileManager::get(Profile &profile,
                                            const std::string &name) const {
+  std::lock_guard<std::mutex> lock(d->profile_cache_mutex);
+
   auto it = d->profile_descriptors.find(name);
-  if (it == d->profile_descriptors.end()) {
+  if (it != d->profile_descriptors.end()) {
+    profile = it->second;
+    return Status(true);
+  }
+
+  auto index_it = d->profile_index.find(name);
+  if (index_it == d->profile_index.end()) {
     return Status(false, StatusCode::ProfileNotFound,
                   "The specified profile does not exists");
   }
 
-  profile = it->second;
+  const auto &profile_path = index_it->second;
+
+  Profile new_profile;
+  if (!loadProfile(new_profile, profile_path,
+                   getStoreRootPath(d->profiles_root)) ||
+      new_profile.name != name) {
+    return Status(false, StatusCode::InvalidProfile,
+                  "The following profile could not be loaded: " +
+                      profile_path);
+  }
+
+  d->profile_descriptors.insert({name, new_profile});
+
+  profile = new_profile;
+  return Status(true);
+}
+
+ProfileManager::Status ProfileManager::registerProfile(
+    const std::string &profile_path) {
+  std::error_code error;
+  auto absolute_profile_path = stdfs::absolute(profile_path, error);
+  auto absolute_profiles_root = stdfs::absolute(d->profiles_root, error);
+
+  auto relative_path =
+      absolute_profile_path.lexically_relative(absolute_profiles_root);
+
+  if (relative_path.empty() || *relative_path.begin() == "..") {
+    return Status(false, StatusCode::InvalidProfile,
+                  "The profile is not inside the profiles root folder: " +
+                      profile_path);
+  }
+
+  Profile profile;
+  if (!loadProfile(profile, absolute_profile_path,
+                   getStoreRootPath(d->profiles_root))) {
+    return Status(false, StatusCode::InvalidProfile,
+                  "The following profile could not be loaded: " +
+                      profile_path);
+  }
+
+  std::lock_guard<std::mutex> lock(d->profile_cache_mutex);
+
+  auto profile_index = d->profile_index;
+  profile_index[profile.name] =
+      (stdfs::path(d->profiles_root) / relative_path).string();
+
+  if (!saveProfileIndex(profile_index, d->profiles_root)) {
+    return Status(false, StatusCode::ProfileEnumerationError,
+                  "Failed to update the profile index");
+  }
+
+  d->profile_index = std::move(profile_index);
+  d->profile_descriptors.erase(profile.name);
+  d->all_profiles_loaded = false;
+
   return Status(true);
 }
 
-const ProfileMap &ProfileManager::profileMap() const {
+const std::string &ProfileManager::profilesRoot() const {
+  return d->profiles_root;
+}
+
+ProfileMap ProfileManager::profileMap() const {
+  // The index may be replaced by registerProfile, so the names are copied
+  // while holding the lock
+  StringList profile_names;
+
+  {
+    std::lock_guard<std::mutex> lock(d->profile_cache_mutex);
+    if (d->all_profiles_loaded) {
+      return d->profile_descriptors;
+    }
+
+    for (const auto &p : d->profile_index) {
+      profile_names.push_back(p.first);
+    }
+  }
+
+  for (const auto &name : profile_names) {
+    Profile profile;
+    auto status = get(profile, name);
+    if (!status.succeeded()) {
+      std::cerr << status.message() << "\n";
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(d->profile_cache_mutex);
+  d->all_profiles_loaded = true;
+
   return d->profile_descriptors;
 }
@@ -20,6 +20,7 @@
 #include "languagemanager.h"
 #include "types.h"
 
+#include <map>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -38,11 +39,31 @@ struct Profile final {
   /// The location for the clang resource directory
   std::string resource_dir;
 
-  /// Default isystem parameters
-  std::unordered_map<Language, StringList> internal_isystem;
+  /// The target triple described by this profile; when empty, the default
+  /// target of the host is used
+  std::string target_triple;
+
+  /// The expected data layout for the target; when not empty, it is
+  /// compared against the one selected by clang for the target triple
+  std::string data_layout;
+
+  /// If not empty, the profile headers are read from this packed archive
+  /// (see ProfileArchive) instead of the profile root folder
+  std::string archive_path;
+
+  /// The content-addressed header store shared by all the profiles
+  std::string store_root;
+
+  /// If not empty (and there is no archive), the profile headers are read
+  /// from the header store through this manifest (see ProfileStore)
+  std::string manifest_path;
+
+  /// Default isystem parameters; ordered, so that the generated files do not
+  /// depend on the hash map iteration order
+  std::map<Language, StringList> internal_isystem;
 
   /// Default externc_isystem parameters
-  std::unordered_map<Language, StringList> internal_externc_isystem;
+  std::map<Language, StringList> internal_externc_isystem;
 };
 
 /// A profile map
@@ -69,6 +90,7 @@ class ProfileManager final {
     ProfileEnumerationError,
     ProfilesMissing,
     ProfileNotFound,
+    InvalidProfile,
     Unknown
   };
 
@@ -81,10 +103,17 @@ class ProfileManager final {
   /// Destructor
   ~ProfileManager();
 
-  /// Returns the specified profile
+  /// Returns the specified profile; profiles are loaded on first use
   Status get(Profile &profile, const std::string &name) const;
 
-  /// Enumerates each profile
+  /// Adds the profile.json file at the given path to the profile index; the
+  /// profile must be located inside the profiles root folder
+  Status registerProfile(const std::string &profile_path);
+
+  /// Returns the folder containing the profiles
+  const std::string &profilesRoot() const;
+
+  /// Enumerates each profile; this loads every profile in the index
   template <typename T>
   void enumerate(bool (*callback)(const Profile &profile, T user_defined),
                  T user_defined) const;
@@ -96,8 +125,9 @@ class ProfileManager final {
   ProfileManager &operator=(const ProfileManager &other) = delete;
 
  private:
-  /// Private accessor used by the ProfileManager::enumerate method
-  const ProfileMap &profileMap() const;
+  /// Private accessor used by the ProfileManager::enumerate method; returns a
+  /// copy, since other threads may load new profiles in the meantime
+  ProfileMap profileMap() const;
 };
 
 template <typename T>
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "profilestorage.h"
+#include "profilearchive.h"
+#include "profilestore.h"
+#include "std_filesystem.h"
+
+#include <algorithm>
+
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Support/SHA1.h>
+
+std::string getContentHash(llvm::StringRef contents) {
+  llvm::SHA1 hasher;
+  hasher.update(contents);
+
+  // The digest is returned as a StringRef until LLVM 15, and as an array
+  // of bytes afterwards
+  auto digest = hasher.final();
+  return llvm::toHex(
+      llvm::StringRef(reinterpret_cast<const char *>(digest.data()),
+                      digest.size()),
+      true);
+}
+
+bool enumerateProfileFiles(StringList &file_list,
+                           const std::string &profile_root) {
+  file_list = {};
+
+  auto root_path = stdfs::absolute(profile_root);
+  StringList output;
+
+  try {
+    for (const auto &directory_entry :
+         stdfs::recursive_directory_iterator(root_path)) {
+      const auto &path = directory_entry.path();
+      if (!stdfs::is_regular_file(path)) {
+        continue;
+      }
+
+      auto relative_path = path.lexically_relative(root_path).generic_string();
+      if (relative_path == "profile.json" ||
+          relative_path == ProfileArchive::kDefaultFileName ||
+          relative_path == ProfileStore::kManifestFileName) {
+        continue;
+      }
+
+      output.push_back(relative_path);
+    }
+
+  } catch (...) {
+    return false;
+  }
+
+  std::sort(output.begin(), output.end());
+
+  file_list = std::move(output);
+  return true;
+}
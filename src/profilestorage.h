@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "types.h"
+
+#include <cstdint>
+#include <memory>
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+/// Describes a single file or folder inside a profile storage
+struct ProfileStorageEntry final {
+  /// True if this entry is a folder
+  bool is_directory{false};
+
+  /// The file size; always zero for folders
+  std::uint64_t size{0U};
+
+  /// A number that uniquely identifies this entry inside the storage
+  std::uint64_t id{0U};
+};
+
+class IProfileStorage;
+
+/// A reference to an IProfileStorage object
+using ProfileStorageRef = std::shared_ptr<IProfileStorage>;
+
+/// The base class for the profile header storages (i.e.: packed archives);
+/// paths are always relative to the profile root and use forward slashes
+class IProfileStorage {
+ public:
+  /// Destructor
+  virtual ~IProfileStorage() = default;
+
+  /// Looks up the given path; returns false if it does not exist
+  virtual bool lookup(ProfileStorageEntry &entry,
+                      llvm::StringRef relative_path) const = 0;
+
+  /// Returns the contents of the given file, or nullptr if the file does not
+  /// exist or could not be read. The buffer is always null terminated
+  virtual std::unique_ptr<llvm::MemoryBuffer> getFile(
+      llvm::StringRef relative_path, llvm::StringRef buffer_name) const = 0;
+};
+
+/// Enumerates the header files inside the given profile root folder, skipping
+/// the profile settings and storage files. Paths are relative to the profile
+/// root, use forward slashes and are sorted so that the output is
+/// reproducible
+bool enumerateProfileFiles(StringList &file_list,
+                           const std::string &profile_root);
+
+/// Returns the SHA1 hash of the given buffer, as a lower case hex string
+std::string getContentHash(llvm::StringRef contents);
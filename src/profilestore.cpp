@@ -0,0 +1,292 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "profilestore.h"
+#include "fileutils.h"
+#include "std_filesystem.h"
+
+#include <fstream>
+#include <map>
+#include <sstream>
+
+#include <llvm/ADT/StringMap.h>
+
+namespace {
+/// The length of a SHA1 hash, in hex digits
+const std::size_t kHashLength = 40U;
+
+/// A single file inside the manifest
+struct ManifestEntry final {
+  /// The SHA1 hash of the file contents
+  std::string hash;
+
+  /// The file size
+  std::uint64_t size{0U};
+
+  /// The entry index, used to generate unique ids
+  std::uint64_t index{0U};
+};
+
+/// Returns the path of the blob with the given hash
+stdfs::path getBlobPath(const std::string &store_root,
+                        const std::string &hash) {
+  return stdfs::path(store_root) / "objects" / hash.substr(0U, 2U) /
+         hash.substr(2U);
+}
+}  // namespace
+
+const std::string ProfileStore::kManifestFileName = "profile.manifest";
+
+/// Private class data
+struct ProfileStore::PrivateData final {
+  /// The store root folder
+  std::string store_root;
+
+  /// The manifest entries
+  llvm::StringMap<ManifestEntry> file_map;
+
+  /// All the folders, implicitly defined by the file paths
+  llvm::StringMap<std::uint64_t> directory_map;
+};
+
+ProfileStore::ProfileStore(const std::string &manifest_path,
+                           const std::string &store_root)
+    : d(new PrivateData) {
+  d->store_root = store_root;
+
+  auto buffer_or_error = llvm::MemoryBuffer::getFile(manifest_path);
+  if (!buffer_or_error) {
+    throw Status(false, StatusCode::IOError,
+                 "Failed to open the profile manifest: " + manifest_path);
+  }
+
+  auto manifest = buffer_or_error.get()->getBuffer();
+
+  llvm::SmallVector<llvm::StringRef, 0> line_list;
+  manifest.split(line_list, '\n', -1, false);
+
+  d->directory_map.insert({"", line_list.size() + 1U});
+
+  for (std::size_t i = 0U; i < line_list.size(); ++i) {
+    llvm::StringRef line = line_list[i];
+
+    llvm::StringRef hash;
+    llvm::StringRef size;
+    llvm::StringRef entry_path;
+
+    std::tie(hash, line) = line.split(' ');
+    std::tie(size, entry_path) = line.split(' ');
+
+    ManifestEntry entry = {};
+    entry.hash = hash.str();
+    entry.index = i + 1U;
+
+    if (hash.size() != kHashLength ||
+        hash.find_first_not_of("0123456789abcdef") != llvm::StringRef::npos ||
+        size.getAsInteger(10, entry.size) || entry_path.empty()) {
+      throw Status(false, StatusCode::InvalidManifest,
+                   "The profile manifest is corrupted: " + manifest_path);
+    }
+
+    d->file_map.insert({entry_path, entry});
+
+    // Register all the parent folders
+    for (auto separator = entry_path.rfind('/');
+         separator != llvm::StringRef::npos;
+         separator = entry_path.rfind('/')) {
+      entry_path = entry_path.substr(0, separator);
+
+      auto directory_id = line_list.size() + 1U + d->directory_map.size();
+      if (!d->directory_map.insert({entry_path, directory_id}).second) {
+        break;
+      }
+    }
+  }
+}
+
+ProfileStore::Status ProfileStore::create(ProfileStoreRef &obj,
+                                          const std::string &manifest_path,
+                                          const std::string &store_root) {
+  obj.reset();
+
+  try {
+    auto ptr = new ProfileStore(manifest_path, store_root);
+    obj.reset(ptr);
+
+    return Status(true);
+
+  } catch (const std::bad_alloc &) {
+    return Status(false, StatusCode::MemoryAllocationFailure);
+
+  } catch (const Status &status) {
+    return status;
+  }
+}
+
+ProfileStore::Status ProfileStore::add(const std::string &profile_root,
+                                       const std::string &store_root,
+                                       const std::string &manifest_path,
+                                       std::size_t &new_blob_count,
+                                       std::uint64_t &new_blob_size) {
+  new_blob_count = 0U;
+  new_blob_size = 0U;
+
+  StringList file_list;
+  if (!enumerateProfileFiles(file_list, profile_root)) {
+    return Status(false, StatusCode::IOError,
+                  "Failed to enumerate the profile files");
+  }
+
+  // Start from the existing manifest, if any; the profile folder may have
+  // been stripped of the headers that have already been stored
+  std::map<std::string, ManifestEntry> manifest_entries;
+
+  std::error_code error;
+  if (stdfs::exists(manifest_path, error)) {
+    ProfileStoreRef current_store;
+    auto status = create(current_store, manifest_path, store_root);
+    if (!status.succeeded()) {
+      return status;
+    }
+
+    for (const auto &p : current_store->d->file_map) {
+      const auto &entry = p.second;
+
+      if (!stdfs::exists(getBlobPath(store_root, entry.hash), error)) {
+        return Status(false, StatusCode::IOError,
+                      "The following header is listed in the profile "
+                      "manifest but is missing from the store: " +
+                          p.first().str());
+      }
+
+      manifest_entries.insert({p.first().str(), entry});
+    }
+  }
+
+  for (const auto &path : file_list) {
+    auto source_path = stdfs::path(profile_root) / path;
+
+    std::ifstream input_file(source_path.string(), std::ios::binary);
+    std::string file_contents((std::istreambuf_iterator<char>(input_file)),
+                              std::istreambuf_iterator<char>());
+
+    if (!input_file.eof() && !input_file.good()) {
+      return Status(false, StatusCode::IOError,
+                    "Failed to read the following file: " + path);
+    }
+
+    auto hash = getContentHash(file_contents);
+
+    ManifestEntry manifest_entry = {};
+    manifest_entry.hash = hash;
+    manifest_entry.size = file_contents.size();
+    manifest_entries[path] = manifest_entry;
+
+    // Blobs are immutable, so there is nothing to do if it already exists
+    auto blob_path = getBlobPath(store_root, hash);
+
+    if (stdfs::exists(blob_path, error)) {
+      continue;
+    }
+
+    // Write the blob through a temporary file, so that a partially written
+    // blob is never visible
+    stdfs::create_directories(blob_path.parent_path(), error);
+
+    if (!writeFileAtomically(blob_path.string(), file_contents)) {
+      return Status(false, StatusCode::IOError,
+                    "Failed to write the following blob: " +
+                        blob_path.string());
+    }
+
+    ++new_blob_count;
+    new_blob_size += file_contents.size();
+  }
+
+  std::stringstream manifest;
+  for (const auto &p : manifest_entries) {
+    manifest << p.second.hash << " " << p.second.size << " " << p.first
+             << "\n";
+  }
+
+  if (!writeFileAtomically(manifest_path, manifest.str())) {
+    return Status(false, StatusCode::IOError,
+                  "Failed to write the profile manifest: " + manifest_path);
+  }
+
+  return Status(true);
+}
+
+ProfileStore::~ProfileStore() {}
+
+StringList ProfileStore::fileList() const {
+  StringList file_list;
+  for (const auto &p : d->file_map) {
+    file_list.push_back(p.first().str());
+  }
+
+  return file_list;
+}
+
+bool ProfileStore::lookup(ProfileStorageEntry &entry,
+                          llvm::StringRef relative_path) const {
+  entry = {};
+
+  auto file_it = d->file_map.find(relative_path);
+  if (file_it != d->file_map.end()) {
+    entry.size = file_it->second.size;
+    entry.id = file_it->second.index;
+    return true;
+  }
+
+  auto directory_it = d->directory_map.find(relative_path);
+  if (directory_it != d->directory_map.end()) {
+    entry.is_directory = true;
+    entry.id = directory_it->second;
+    return true;
+  }
+
+  return false;
+}
+
+std::unique_ptr<llvm::MemoryBuffer> ProfileStore::getFile(
+    llvm::StringRef relative_path, llvm::StringRef buffer_name) const {
+  auto file_it = d->file_map.find(relative_path);
+  if (file_it == d->file_map.end()) {
+    return nullptr;
+  }
+
+  const auto &entry = file_it->second;
+  auto blob_path = getBlobPath(d->store_root, entry.hash);
+
+  // Large blobs are memory mapped, so all the profiles sharing them also
+  // share the same pages
+  auto buffer_or_error = llvm::MemoryBuffer::getFile(blob_path.string());
+  if (!buffer_or_error) {
+    return nullptr;
+  }
+
+  // The buffer keeps the blob path as its name, since the file contents are
+  // identical for every profile that uses it
+  static_cast<void>(buffer_name);
+
+  auto blob_buffer = std::move(buffer_or_error.get());
+  if (blob_buffer->getBufferSize() != entry.size) {
+    return nullptr;
+  }
+
+  return blob_buffer;
+}
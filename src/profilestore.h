@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "istatus.h"
+#include "profilestorage.h"
+
+#include <string>
+
+class ProfileStore;
+
+/// A reference to a ProfileStore object
+using ProfileStoreRef = std::shared_ptr<ProfileStore>;
+
+/// A content-addressed header store, shared by all the profiles. Each file is
+/// saved once, named after the SHA1 hash of its contents:
+///
+///   <store root>/objects/<first two hash digits>/<remaining hash digits>
+///
+/// A profile then only contains a manifest (profile.manifest, next to the
+/// profile.json file) mapping each header path to its blob. Profiles that
+/// share the same headers also share the same files on disk (and in the
+/// page cache). The manifest is a text file with one line per header:
+///
+///   <sha1> <size> <relative path>
+class ProfileStore final : public IProfileStorage {
+  struct PrivateData;
+
+  /// Private class data
+  std::unique_ptr<PrivateData> d;
+
+  /// Private constructor; use ::create() instead
+  ProfileStore(const std::string &manifest_path, const std::string &store_root);
+
+ public:
+  /// Status code, used with ProfileStore::Status
+  enum class StatusCode {
+    MemoryAllocationFailure,
+    IOError,
+    InvalidManifest,
+    Unknown
+  };
+
+  /// Status object
+  using Status = IStatus<StatusCode>;
+
+  /// The default manifest name, inside the profile root folder
+  static const std::string kManifestFileName;
+
+  /// Opens the given profile manifest
+  static Status create(ProfileStoreRef &obj, const std::string &manifest_path,
+                       const std::string &store_root);
+
+  /// Adds all the files inside the given profile root folder to the store,
+  /// then writes the profile manifest. If a manifest already exists, it is
+  /// merged with the files found on disk (which take precedence), so that
+  /// the headers removed after a previous run are not lost. The
+  /// new_blob_count and new_blob_size parameters receive how many files (and
+  /// bytes) were not already stored
+  static Status add(const std::string &profile_root,
+                    const std::string &store_root,
+                    const std::string &manifest_path,
+                    std::size_t &new_blob_count, std::uint64_t &new_blob_size);
+
+  /// Destructor
+  virtual ~ProfileStore();
+
+  /// Returns the path of every file listed in the manifest
+  StringList fileList() const;
+
+  /// Looks up the given path; returns false if it does not exist
+  virtual bool lookup(ProfileStorageEntry &entry,
+                      llvm::StringRef relative_path) const override;
+
+  /// Returns the contents of the given file
+  virtual std::unique_ptr<llvm::MemoryBuffer> getFile(
+      llvm::StringRef relative_path,
+      llvm::StringRef buffer_name) const override;
+
+  /// Disable the copy constructor
+  ProfileStore(const ProfileStore &other) = delete;
+
+  /// Disable the assignment operator
+  ProfileStore &operator=(const ProfileStore &other) = delete;
+};
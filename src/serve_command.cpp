@@ -0,0 +1,445 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cmdline.h"
+#include "headermap.h"
+#include "modulemap.h"
+#include "profilefilesystem.h"
+#include "std_filesystem.h"
+#include "tracing.h"
+
+#include <iostream>
+#include <sstream>
+
+#include <json11.hpp>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+#ifndef _WIN32
+/// Requests larger than this are rejected
+const std::size_t kMaxRequestSize = 1024U * 1024U;
+
+/// How long (in seconds) the server waits for a client to send its request
+/// or to read the response; requests are served one at a time, so a stalled
+/// client would otherwise block every other caller
+const long kClientSocketTimeout = 30;
+
+/// Redirects std::cout and std::cerr to string buffers for the lifetime of
+/// the object
+class OutputCapture final {
+  /// The original std::cout buffer
+  std::streambuf *cout_buffer{nullptr};
+
+  /// The original std::cerr buffer
+  std::streambuf *cerr_buffer{nullptr};
+
+ public:
+  /// The captured std::cout output
+  std::stringstream output;
+
+  /// The captured std::cerr output
+  std::stringstream errors;
+
+  /// Constructor
+  OutputCapture() {
+    std::cout.flush();
+    std::cerr.flush();
+
+    cout_buffer = std::cout.rdbuf(output.rdbuf());
+    cerr_buffer = std::cerr.rdbuf(errors.rdbuf());
+  }
+
+  /// Destructor
+  ~OutputCapture() {
+    std::cout.rdbuf(cout_buffer);
+    std::cerr.rdbuf(cerr_buffer);
+  }
+
+  /// Disable the copy constructor
+  OutputCapture(const OutputCapture &other) = delete;
+
+  /// Disable the assignment operator
+  OutputCapture &operator=(const OutputCapture &other) = delete;
+};
+
+/// Initializes the given UNIX socket address
+bool getSocketAddress(sockaddr_un &address, const std::string &socket_path) {
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+
+  if (socket_path.empty() || socket_path.size() >= sizeof(address.sun_path)) {
+    return false;
+  }
+
+  std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1U);
+  return true;
+}
+
+/// Makes the reads and the writes on the given socket fail once the client
+/// has been idle for kClientSocketTimeout seconds
+bool setClientSocketTimeouts(int socket_fd) {
+  timeval timeout = {};
+  timeout.tv_sec = kClientSocketTimeout;
+
+  return setsockopt(socket_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout,
+                    sizeof(timeout)) == 0 &&
+         setsockopt(socket_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout,
+                    sizeof(timeout)) == 0;
+}
+
+/// Reads a single newline-terminated message from the given socket; fails
+/// if the message is larger than the given size, or if the socket times out
+bool readMessage(std::string &message, int socket_fd,
+                 std::size_t max_size = kMaxRequestSize) {
+  message.clear();
+
+  char buffer[4096];
+  while (true) {
+    auto size = ::read(socket_fd, buffer, sizeof(buffer));
+    if (size < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      return false;
+    }
+
+    if (size == 0) {
+      return false;
+    }
+
+    message.append(buffer, static_cast<std::size_t>(size));
+
+    auto terminator = message.find('\n');
+    if (terminator != std::string::npos) {
+      message.resize(terminator);
+      return true;
+    }
+
+    if (message.size() > max_size) {
+      return false;
+    }
+  }
+}
+
+/// Writes the given message to the socket, followed by a newline
+bool writeMessage(int socket_fd, std::string message) {
+  message.push_back('\n');
+
+  std::size_t offset = 0U;
+  while (offset < message.size()) {
+    auto size =
+        ::write(socket_fd, message.data() + offset, message.size() - offset);
+
+    if (size < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      return false;
+    }
+
+    offset += static_cast<std::size_t>(size);
+  }
+
+  return true;
+}
+
+/// Runs the command line contained in the given request, using the same
+/// parser and command handlers of the abigen executable
+json11::Json handleServerRequest(ProfileManagerRef &profile_manager,
+                                 const std::string &request_buffer) {
+  auto L_makeResponse = [](int exit_code, const std::string &output,
+                           const std::string &errors) -> json11::Json {
+    return json11::Json::object{
+        {"exit-code", exit_code}, {"stdout", output}, {"stderr", errors}};
+  };
+
+  std::string error_messages;
+  auto request = json11::Json::parse(request_buffer, error_messages);
+  if (!request["arguments"].is_array() ||
+      !request["working-directory"].is_string()) {
+    return L_makeResponse(1, "", "Invalid request\n");
+  }
+
+  std::vector<std::string> arguments = {"abigen"};
+  for (const auto &item : request["arguments"].array_items()) {
+    if (!item.is_string()) {
+      return L_makeResponse(1, "", "Invalid request\n");
+    }
+
+    arguments.push_back(item.string_value());
+  }
+
+  // Relative paths in the command line are resolved against the working
+  // directory of the client
+  std::error_code error;
+  auto server_working_directory = stdfs::current_path(error);
+  if (error) {
+    return L_makeResponse(1, "", "Failed to acquire the working directory\n");
+  }
+
+  stdfs::current_path(request["working-directory"].string_value(), error);
+  if (error) {
+    return L_makeResponse(1, "", "Invalid working directory\n");
+  }
+
+  int exit_code = 1;
+  std::string output;
+  std::string errors;
+
+  {
+    OutputCapture output_capture;
+
+    LanguageManager language_manager;
+
+    CLI::App cmdline_parser{"McSema ABI library generator"};
+    CommandLineOptions cmdline_options;
+
+    CommandMap command_map;
+    initializeCommandLineParser(cmdline_parser, cmdline_options,
+                                profile_manager, language_manager,
+                                command_map);
+
+    std::vector<char *> argv;
+    for (auto &argument : arguments) {
+      argv.push_back(&argument[0]);
+    }
+
+    try {
+      cmdline_parser.parse(static_cast<int>(argv.size()), argv.data());
+
+      for (const auto &p : command_map) {
+        const auto &subcommand = p.first;
+        const auto &callback = p.second;
+
+        if (!cmdline_parser.got_subcommand(subcommand)) {
+          continue;
+        }
+
+        if (callback == serveCommandHandler) {
+          std::cerr << "The serve command can't be used by clients\n";
+          break;
+        }
+
+        // Each request starts from a clean trace, whatever the command; the
+        // header and module maps are rebuilt and the packed or stored
+        // profiles are opened again, since the headers may have been
+        // changed since the previous request
+        resetTracing();
+        resetHeaderMapCache();
+        resetModuleMapCache();
+        resetProfileFileSystemCache();
+
+        auto succeeded =
+            callback(profile_manager, language_manager, cmdline_options);
+
+        resetTracing();
+
+        exit_code = succeeded ? 0 : 1;
+        break;
+      }
+
+    } catch (const CLI::ParseError &e) {
+      exit_code = cmdline_parser.exit(e);
+    }
+
+    std::cout.flush();
+    std::cerr.flush();
+
+    output = output_capture.output.str();
+    errors = output_capture.errors.str();
+  }
+
+  stdfs::current_path(server_working_directory, error);
+  return L_makeResponse(exit_code, output, errors);
+}
+#endif
+}  // namespace
+
+/// Handler for the 'serve' command
+bool serveCommandHandler(ProfileManagerRef &profile_manager,
+                         const LanguageManager &language_manager,
+                         const CommandLineOptions &cmdline_options) {
+  static_cast<void>(language_manager);
+
+#ifdef _WIN32
+  static_cast<void>(profile_manager);
+  static_cast<void>(cmdline_options);
+
+  std::cerr << "The serve command is not supported on this platform\n";
+  return false;
+
+#else
+  sockaddr_un address;
+  if (!getSocketAddress(address, cmdline_options.socket_path)) {
+    std::cerr << "Invalid socket path: " << cmdline_options.socket_path
+              << "\n";
+    return false;
+  }
+
+  // Remove the socket left behind by a previous server
+  struct stat socket_status = {};
+  if (lstat(cmdline_options.socket_path.c_str(), &socket_status) == 0 &&
+      S_ISSOCK(socket_status.st_mode)) {
+    unlink(cmdline_options.socket_path.c_str());
+  }
+
+  auto server_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (server_socket == -1) {
+    std::cerr << "Failed to create the server socket\n";
+    return false;
+  }
+
+  if (bind(server_socket, reinterpret_cast<const sockaddr *>(&address),
+           sizeof(address)) != 0 ||
+      listen(server_socket, SOMAXCONN) != 0) {
+    std::cerr << "Failed to listen on " << cmdline_options.socket_path << ": "
+              << std::strerror(errno) << "\n";
+
+    close(server_socket);
+    return false;
+  }
+
+  std::signal(SIGPIPE, SIG_IGN);
+
+  std::cerr << "Listening on " << cmdline_options.socket_path << "\n";
+
+  // Requests are served one at a time, since the output capture and the
+  // working directory are shared by the whole process; the commands still
+  // use all the requested jobs internally
+  while (true) {
+    auto client_socket = accept(server_socket, nullptr, nullptr);
+    if (client_socket == -1) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+
+      std::cerr << "Failed to accept the client connection: "
+                << std::strerror(errno) << "\n";
+      break;
+    }
+
+    if (!setClientSocketTimeouts(client_socket)) {
+      std::cerr << "Failed to configure the client connection: "
+                << std::strerror(errno) << "\n";
+
+      close(client_socket);
+      continue;
+    }
+
+    std::string request;
+    if (readMessage(request, client_socket)) {
+      auto response = handleServerRequest(profile_manager, request);
+      if (!writeMessage(client_socket, response.dump())) {
+        std::cerr << "Failed to send the response to the client\n";
+      }
+    }
+
+    close(client_socket);
+  }
+
+  close(server_socket);
+  unlink(cmdline_options.socket_path.c_str());
+
+  return false;
+#endif
+}
+
+bool sendServerRequest(int &exit_code, const std::string &socket_path,
+                       const StringList &arguments) {
+  exit_code = 1;
+
+#ifdef _WIN32
+  static_cast<void>(socket_path);
+  static_cast<void>(arguments);
+
+  std::cerr << "The abigen server is not supported on this platform\n";
+  return false;
+
+#else
+  sockaddr_un address;
+  if (!getSocketAddress(address, socket_path)) {
+    std::cerr << "Invalid socket path: " << socket_path << "\n";
+    return false;
+  }
+
+  std::error_code error;
+  auto working_directory = stdfs::current_path(error);
+  if (error) {
+    std::cerr << "Failed to acquire the working directory\n";
+    return false;
+  }
+
+  auto client_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (client_socket == -1) {
+    std::cerr << "Failed to create the client socket\n";
+    return false;
+  }
+
+  if (connect(client_socket, reinterpret_cast<const sockaddr *>(&address),
+              sizeof(address)) != 0) {
+    std::cerr << "Failed to connect to the abigen server at " << socket_path
+              << ": " << std::strerror(errno) << "\n";
+
+    close(client_socket);
+    return false;
+  }
+
+  std::signal(SIGPIPE, SIG_IGN);
+
+  json11::Json request = json11::Json::object{
+      {"arguments", arguments},
+      {"working-directory", working_directory.string()}};
+
+  std::string response_buffer;
+  auto succeeded = writeMessage(client_socket, request.dump()) &&
+                   readMessage(response_buffer, client_socket,
+                               response_buffer.max_size());
+
+  close(client_socket);
+
+  if (!succeeded) {
+    std::cerr << "The abigen server did not reply\n";
+    return false;
+  }
+
+  std::string error_messages;
+  auto response = json11::Json::parse(response_buffer, error_messages);
+  if (!response["exit-code"].is_number() || !response["stdout"].is_string() ||
+      !response["stderr"].is_string()) {
+    std::cerr << "Invalid response from the abigen server\n";
+    return false;
+  }
+
+  std::cout << response["stdout"].string_value();
+  std::cerr << response["stderr"].string_value();
+
+  exit_code = response["exit-code"].int_value();
+  return true;
+#endif
+}
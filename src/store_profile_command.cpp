@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cmdline.h"
+#include "profilestore.h"
+#include "std_filesystem.h"
+
+#include <algorithm>
+
+namespace {
+/// Removes the stored headers from the profile folder, along with the
+/// folders that are left empty
+bool removeStoredHeaders(const std::string &profile_root,
+                         const StringList &file_list) {
+  std::error_code error;
+
+  for (const auto &path : file_list) {
+    stdfs::remove(stdfs::path(profile_root) / path, error);
+    if (error) {
+      std::cerr << "Failed to remove the following file: " << path << "\n";
+      return false;
+    }
+  }
+
+  StringList folder_list;
+
+  try {
+    for (const auto &directory_entry :
+         stdfs::recursive_directory_iterator(profile_root)) {
+      if (stdfs::is_directory(directory_entry.path())) {
+        folder_list.push_back(directory_entry.path().string());
+      }
+    }
+
+  } catch (...) {
+    std::cerr << "Failed to enumerate the profile folders\n";
+    return false;
+  }
+
+  // Start from the innermost folders
+  std::sort(folder_list.rbegin(), folder_list.rend());
+
+  for (const auto &folder : folder_list) {
+    if (stdfs::is_empty(folder, error)) {
+      stdfs::remove(folder, error);
+    }
+  }
+
+  return true;
+}
+}  // namespace
+
+/// Handler for the 'store_profile' command
+bool storeProfileCommandHandler(ProfileManagerRef &profile_manager,
+                                const LanguageManager &language_manager,
+                                const CommandLineOptions &cmdline_options) {
+  static_cast<void>(language_manager);
+
+  Profile profile;
+  auto prof_mgr_status =
+      profile_manager->get(profile, cmdline_options.profile_name);
+  if (!prof_mgr_status.succeeded()) {
+    std::cerr << prof_mgr_status.toString() << "\n";
+    return false;
+  }
+
+  if (!profile.archive_path.empty()) {
+    std::cerr << "Warning: the profile archive takes precedence over the "
+                 "header store: "
+              << profile.archive_path << "\n";
+  }
+
+  auto manifest_path =
+      (stdfs::path(profile.root_path) / ProfileStore::kManifestFileName)
+          .string();
+
+  std::cerr << "Storing " << profile.root_path << " into "
+            << profile.store_root << "\n";
+
+  std::size_t new_blob_count = 0U;
+  std::uint64_t new_blob_size = 0U;
+
+  auto status = ProfileStore::add(profile.root_path, profile.store_root,
+                                  manifest_path, new_blob_count,
+                                  new_blob_size);
+  if (!status.succeeded()) {
+    std::cerr << status.message() << "\n";
+    return false;
+  }
+
+  // Make sure the manifest can be opened
+  ProfileStoreRef store;
+  status = ProfileStore::create(store, manifest_path, profile.store_root);
+  if (!status.succeeded()) {
+    std::cerr << status.message() << "\n";
+    return false;
+  }
+
+  auto file_list = store->fileList();
+
+  std::cerr << "Stored " << file_list.size() << " files (" << new_blob_count
+            << " new blobs, " << new_blob_size << " bytes)\n";
+
+  if (cmdline_options.remove_stored_headers &&
+      !removeStoredHeaders(profile.root_path, file_list)) {
+    return false;
+  }
+
+  return true;
+}
@@ -0,0 +1,304 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tracing.h"
+#include "memoryusage.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <json11.hpp>
+
+namespace {
+/// A single complete event
+struct TraceEvent final {
+  /// The event category
+  std::string category;
+
+  /// The event name
+  std::string name;
+
+  /// Start time, in microseconds since the tracing has been enabled
+  std::int64_t start_time{0};
+
+  /// Duration, in microseconds
+  std::int64_t duration{0};
+
+  /// The track (one for each thread)
+  std::size_t thread_index{0U};
+
+  /// The peak resident set size of the process when the event has ended
+  std::uint64_t peak_resident_set_size{0U};
+
+  /// Event arguments
+  json11::Json::object arguments;
+};
+
+/// The recorded events and counters
+struct TraceState final {
+  /// True if tracing has been enabled
+  std::atomic_bool enabled{false};
+
+  /// Guards the rest of the structure
+  std::mutex mutex;
+
+  /// When tracing has been enabled
+  std::chrono::steady_clock::time_point start_time;
+
+  /// Maps each thread to its track number
+  std::unordered_map<std::thread::id, std::size_t> thread_index_map;
+
+  /// The recorded events
+  std::vector<TraceEvent> event_list;
+
+  /// The counters
+  std::map<std::string, std::int64_t> counter_map;
+};
+
+/// Returns the trace state
+TraceState &getTraceState() {
+  static TraceState state;
+  return state;
+}
+
+/// Returns the microseconds elapsed since tracing has been enabled
+std::int64_t getTraceTimestamp(std::chrono::steady_clock::time_point time) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             time - getTraceState().start_time)
+      .count();
+}
+}  // namespace
+
+/// Private class data
+struct TraceScope::PrivateData final {
+  /// The event being recorded
+  TraceEvent event;
+
+  /// When the event has started
+  std::chrono::steady_clock::time_point start_time;
+};
+
+void enableTracing() {
+  auto &state = getTraceState();
+
+  std::lock_guard<std::mutex> lock(state.mutex);
+  if (state.enabled) {
+    return;
+  }
+
+  state.start_time = std::chrono::steady_clock::now();
+  state.enabled = true;
+}
+
+void resetTracing() {
+  auto &state = getTraceState();
+
+  std::lock_guard<std::mutex> lock(state.mutex);
+  state.enabled = false;
+
+  state.thread_index_map.clear();
+  state.event_list.clear();
+  state.counter_map.clear();
+}
+
+bool isTracingEnabled() { return getTraceState().enabled; }
+
+TraceScope::TraceScope(const char *category, const std::string &name) {
+  if (!isTracingEnabled()) {
+    return;
+  }
+
+  d.reset(new PrivateData);
+  d->event.category = category;
+  d->event.name = name;
+  d->start_time = std::chrono::steady_clock::now();
+}
+
+TraceScope::~TraceScope() {
+  if (!d) {
+    return;
+  }
+
+  auto end_time = std::chrono::steady_clock::now();
+
+  d->event.peak_resident_set_size = getPeakResidentSetSize();
+  addArgument("peak rss",
+              static_cast<std::int64_t>(d->event.peak_resident_set_size));
+
+  auto &state = getTraceState();
+  std::lock_guard<std::mutex> lock(state.mutex);
+
+  auto thread_index_it = state.thread_index_map
+                             .insert({std::this_thread::get_id(),
+                                      state.thread_index_map.size()})
+                             .first;
+
+  d->event.thread_index = thread_index_it->second;
+  d->event.start_time = getTraceTimestamp(d->start_time);
+  d->event.duration = std::chrono::duration_cast<std::chrono::microseconds>(
+                          end_time - d->start_time)
+                          .count();
+
+  state.event_list.push_back(std::move(d->event));
+}
+
+void TraceScope::addArgument(const std::string &name, std::int64_t value) {
+  if (d) {
+    // json11 stores numbers as doubles
+    d->event.arguments[name] = static_cast<double>(value);
+  }
+}
+
+void TraceScope::addArgument(const std::string &name,
+                             const std::string &value) {
+  if (d) {
+    d->event.arguments[name] = value;
+  }
+}
+
+void incrementTraceCounter(const std::string &name, std::int64_t value) {
+  if (!isTracingEnabled()) {
+    return;
+  }
+
+  auto &state = getTraceState();
+
+  std::lock_guard<std::mutex> lock(state.mutex);
+  state.counter_map[name] += value;
+}
+
+bool saveTraceFile(const std::string &path) {
+  auto &state = getTraceState();
+  std::lock_guard<std::mutex> lock(state.mutex);
+
+  json11::Json::array trace_event_list;
+  std::int64_t end_time = 0;
+
+  for (const auto &event : state.event_list) {
+    trace_event_list.push_back(json11::Json::object{
+        {"cat", event.category},
+        {"name", event.name},
+        {"ph", "X"},
+        {"ts", static_cast<double>(event.start_time)},
+        {"dur", static_cast<double>(event.duration)},
+        {"pid", 1},
+        {"tid", static_cast<int>(event.thread_index)},
+        {"args", event.arguments}});
+
+    end_time = std::max(end_time, event.start_time + event.duration);
+  }
+
+  // The counters are reported with their final value
+  for (const auto &p : state.counter_map) {
+    trace_event_list.push_back(json11::Json::object{
+        {"name", p.first},
+        {"ph", "C"},
+        {"ts", static_cast<double>(end_time)},
+        {"pid", 1},
+        {"args",
+         json11::Json::object{{"value", static_cast<double>(p.second)}}}});
+  }
+
+  json11::Json trace = json11::Json::object{
+      {"traceEvents", trace_event_list}, {"displayTimeUnit", "ms"}};
+
+  std::ofstream trace_file(path);
+  trace_file << trace.dump() << "\n";
+
+  return static_cast<bool>(trace_file);
+}
+
+void printTraceStatistics(std::ostream &stream) {
+  struct EventStatistics final {
+    std::size_t count{0U};
+    std::int64_t total_duration{0};
+    std::int64_t max_duration{0};
+    std::uint64_t peak_resident_set_size{0U};
+  };
+
+  auto &state = getTraceState();
+  std::lock_guard<std::mutex> lock(state.mutex);
+
+  std::map<std::string, EventStatistics> statistics_map;
+  for (const auto &event : state.event_list) {
+    auto &statistics = statistics_map[event.name];
+
+    ++statistics.count;
+    statistics.total_duration += event.duration;
+    statistics.max_duration = std::max(statistics.max_duration, event.duration);
+    statistics.peak_resident_set_size =
+        std::max(statistics.peak_resident_set_size,
+                 event.peak_resident_set_size);
+  }
+
+  auto previous_flags = stream.flags();
+  auto previous_precision = stream.precision();
+
+  auto L_milliseconds = [](double microseconds) -> double {
+    return microseconds / 1000.0;
+  };
+
+  auto L_megabytes = [](std::uint64_t bytes) -> double {
+    return static_cast<double>(bytes) / (1024.0 * 1024.0);
+  };
+
+  stream << "Statistics\n\n";
+  stream << "  " << std::left << std::setw(32) << "Event" << std::right
+         << std::setw(10) << "Count" << std::setw(14) << "Total (ms)"
+         << std::setw(12) << "Avg (ms)" << std::setw(12) << "Max (ms)"
+         << std::setw(16) << "Peak RSS (MB)" << "\n";
+
+  stream << std::fixed << std::setprecision(2);
+
+  for (const auto &p : statistics_map) {
+    const auto &statistics = p.second;
+
+    auto total_duration = static_cast<double>(statistics.total_duration);
+    auto average_duration =
+        total_duration / static_cast<double>(statistics.count);
+
+    stream << "  " << std::left << std::setw(32) << p.first << std::right
+           << std::setw(10) << statistics.count << std::setw(14)
+           << L_milliseconds(total_duration) << std::setw(12)
+           << L_milliseconds(average_duration) << std::setw(12)
+           << L_milliseconds(static_cast<double>(statistics.max_duration))
+           << std::setw(16) << L_megabytes(statistics.peak_resident_set_size)
+           << "\n";
+  }
+
+  if (!state.counter_map.empty()) {
+    stream << "\n";
+
+    for (const auto &p : state.counter_map) {
+      stream << "  " << std::left << std::setw(32) << p.first << std::right
+             << std::setw(10) << p.second << "\n";
+    }
+  }
+
+  stream << "\n";
+
+  stream.flags(previous_flags);
+  stream.precision(previous_precision);
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+
+/// Enables the recording of the trace events and counters; tracing is
+/// disabled by default, and the instrumentation does nothing until this
+/// function is called
+void enableTracing();
+
+/// Disables tracing, and discards the recorded events and counters; used to
+/// start each request of a long-running process from a clean state
+void resetTracing();
+
+/// Returns true if the trace events are being recorded
+bool isTracingEnabled();
+
+/// Records a complete trace event, spanning from the construction of the
+/// object to its destruction. Events recorded from different threads are
+/// reported on separate tracks, and the peak resident set size reached by
+/// the process is attached to each one of them
+class TraceScope final {
+  struct PrivateData;
+
+  /// Private class data; null when tracing is disabled
+  std::unique_ptr<PrivateData> d;
+
+ public:
+  /// Starts a new event with the given category and name
+  TraceScope(const char *category, const std::string &name);
+
+  /// Records the event
+  ~TraceScope();
+
+  /// Attaches a numeric argument to the event
+  void addArgument(const std::string &name, std::int64_t value);
+
+  /// Attaches a string argument to the event
+  void addArgument(const std::string &name, const std::string &value);
+
+  /// Disable the copy constructor
+  TraceScope(const TraceScope &other) = delete;
+
+  /// Disable the assignment operator
+  TraceScope &operator=(const TraceScope &other) = delete;
+};
+
+/// Adds the given amount to the specified counter
+void incrementTraceCounter(const std::string &name, std::int64_t value = 1);
+
+/// Saves the recorded events and counters using the Chrome trace event
+/// format; the file can be opened with chrome://tracing or Perfetto
+bool saveTraceFile(const std::string &path);
+
+/// Prints the total, average and maximum duration of each event name, along
+/// with the peak resident set size, followed by the counter values
+void printTraceStatistics(std::ostream &stream);
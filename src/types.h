@@ -17,6 +17,7 @@
 #pragma once
 
 #include <map>
+#include <set>
 #include <string>
 #include <unordered_map>
 #include <variant>
@@ -86,6 +87,39 @@ struct WhitelistedFunction final {
 /// List of whitelisted functions
 using WhitelistedFunctionList = std::vector<WhitelistedFunction>;
 
+/// The include graph recorded while parsing a translation unit. Each
+/// inclusion is tracked on its own, since a header without an include guard
+/// may pull in different files every time (i.e.: depending on the macros
+/// defined before it); inclusions are identified by the FileID clang assigns
+/// to the included file, and zero means that the file has not been entered
+struct IncludeGraph final {
+  /// An include directive found in the main file
+  struct IncludeDirective final {
+    /// The file name, as written in the directive
+    std::string file_name;
+
+    /// The path of the file it resolved to; empty if it could not be found
+    std::string path;
+
+    /// The inclusion started by this directive; zero if the file has been
+    /// skipped (i.e.: thanks to its include guard)
+    unsigned inclusion{0U};
+  };
+
+  /// The include directives found in the main file, in source order
+  std::vector<IncludeDirective> main_file_includes;
+
+  /// Maps each inclusion to the path of the included file
+  std::map<unsigned, std::string> inclusion_paths;
+
+  /// Maps each inclusion to the inclusions found inside it, in source order
+  std::map<unsigned, std::vector<unsigned>> edges;
+
+  /// The included files that are protected by an include guard or by
+  /// #pragma once; including them a second time has no effect
+  std::set<std::string> guarded_files;
+};
+
 /// ABI library contents
 struct ABILibrary final {
   /// Functions that have been blacklisted
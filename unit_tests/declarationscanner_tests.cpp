@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "declarationscanner.h"
+#include "unittests.h"
+
+namespace {
+/// A guarded header; the definitions inside the conditional block are not
+/// indexed
+const std::string kGuardedHeader =
+    "#ifndef GUARDED_H\n"
+    "#define GUARDED_H\n"
+    "\n"
+    "#define GUARDED_VALUE 1\n"
+    "\n"
+    "struct point { int x; int y; };\n"
+    "typedef unsigned int word_t;\n"
+    "enum color { red, green };\n"
+    "static int add(int a, int b) { return a + b; }\n"
+    "\n"
+    "#ifdef GUARDED_EXTRA\n"
+    "struct hidden { int z; };\n"
+    "#endif\n"
+    "\n"
+    "#endif\n";
+
+/// The guard is only recognized when it wraps the whole file
+const std::string kLateGuardHeader =
+    "struct early { int a; };\n"
+    "\n"
+    "#ifndef LATE_GUARD_H\n"
+    "#define LATE_GUARD_H\n"
+    "#endif\n";
+
+/// Redefines some of the names found in kGuardedHeader
+const std::string kConflictingHeader =
+    "#pragma once\n"
+    "\n"
+    "struct point { long x; long y; };\n"
+    "typedef unsigned word_t;\n"
+    "enum shade { red };\n";
+
+/// Scans the given header, saved inside the test folder
+bool scanTestHeader(HeaderDeclarationIndex &index, const std::string &folder,
+                    const std::string &name, const std::string &contents) {
+  auto path = folder + "/" + name;
+
+  return expect(writeTestFile(path, contents), "writing " + name) &&
+         expect(scanHeaderDeclarations(index, path, Language::C),
+                "scanning " + name);
+}
+}  // namespace
+
+bool runDeclarationScannerTests() {
+  std::string folder;
+  if (!expect(createTestFolder(folder), "creating the test folder")) {
+    return false;
+  }
+
+  bool succeeded = true;
+
+  HeaderDeclarationIndex guarded_index;
+  HeaderDeclarationIndex late_guard_index;
+  HeaderDeclarationIndex conflicting_index;
+
+  if (!scanTestHeader(guarded_index, folder, "guarded.h", kGuardedHeader) ||
+      !scanTestHeader(late_guard_index, folder, "late_guard.h",
+                      kLateGuardHeader) ||
+      !scanTestHeader(conflicting_index, folder, "conflicting.h",
+                      kConflictingHeader)) {
+    deleteTestFolder(folder);
+    return false;
+  }
+
+  // Include guards
+  succeeded &= expect(guarded_index.include_guard == "GUARDED_H",
+                      "the include guard is detected");
+
+  succeeded &= expect(!guarded_index.pragma_once,
+                      "guarded.h does not use #pragma once");
+
+  succeeded &= expect(guarded_index.macros.count("GUARDED_H") == 0U,
+                      "the include guard is not indexed as a macro");
+
+  succeeded &= expect(guarded_index.macros.count("GUARDED_VALUE") != 0U,
+                      "the macros inside the include guard are indexed");
+
+  succeeded &= expect(late_guard_index.include_guard.empty(),
+                      "a guard following the code is not an include guard");
+
+  succeeded &= expect(conflicting_index.include_guard.empty() &&
+                          conflicting_index.pragma_once,
+                      "#pragma once is detected");
+
+  // Definitions
+  const auto &definitions = guarded_index.definitions;
+
+  succeeded &= expect(definitions.count("tag point") != 0U,
+                      "the struct definition is indexed");
+
+  succeeded &= expect(definitions.count("word_t") != 0U,
+                      "the typedef is indexed");
+
+  succeeded &= expect(definitions.count("red") != 0U &&
+                          definitions.count("green") != 0U,
+                      "the enumerators are indexed");
+
+  succeeded &= expect(definitions.count("add") != 0U,
+                      "the function definition is indexed");
+
+  succeeded &= expect(definitions.count("tag hidden") == 0U,
+                      "conditional definitions are not indexed");
+
+  // Conflicts between the two headers
+  auto L_isConflicting = [&](const std::string &name) -> bool {
+    auto lhs_it = guarded_index.definitions.find(name);
+    auto rhs_it = conflicting_index.definitions.find(name);
+
+    return lhs_it != guarded_index.definitions.end() &&
+           rhs_it != conflicting_index.definitions.end() &&
+           isConflictingDefinition(lhs_it->second, rhs_it->second);
+  };
+
+  succeeded &= expect(L_isConflicting("tag point"),
+                      "two struct definitions conflict");
+
+  succeeded &= expect(L_isConflicting("red"), "two enumerators conflict");
+
+  succeeded &= expect(conflicting_index.definitions.count("word_t") != 0U &&
+                          !L_isConflicting("word_t"),
+                      "typedef redefinitions never conflict");
+
+  DeclarationIndexEntry typedef_entry;
+  typedef_entry.kind = DeclarationIndexEntry::Kind::Typedef;
+
+  DeclarationIndexEntry tag_entry;
+  tag_entry.kind = DeclarationIndexEntry::Kind::Tag;
+
+  succeeded &= expect(isConflictingDefinition(typedef_entry, tag_entry) &&
+                          isConflictingDefinition(tag_entry, typedef_entry),
+                      "a typedef conflicts with any other definition");
+
+  deleteTestFolder(folder);
+  return succeeded;
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "headermap.h"
+#include "unittests.h"
+
+#include <clang/Lex/HeaderMap.h>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+bool runHeaderMapTests() {
+  std::string folder;
+  if (!expect(createTestFolder(folder), "creating the test folder")) {
+    return false;
+  }
+
+  // Enough entries to fill several buckets with the same hash
+  HeaderMapEntries entries = {
+      {"stdio.h", "/usr/include/stdio.h"},
+      {"sys/types.h", "/usr/include/x86_64-linux-gnu/sys/types.h"}};
+
+  for (int i = 0; i < 100; ++i) {
+    auto name = "folder_" + std::to_string(i % 7) + "/header_" +
+                std::to_string(i) + ".h";
+
+    entries.insert({name, "/opt/include/" + name});
+  }
+
+  auto header_map_path = folder + "/test.hmap";
+
+  auto L_readHeaderMap = [&]() -> bool {
+    if (!expect(writeHeaderMap(header_map_path, entries),
+                "writing the header map")) {
+      return false;
+    }
+
+    auto buffer = llvm::MemoryBuffer::getFile(header_map_path);
+    if (!expect(static_cast<bool>(buffer), "reading the header map")) {
+      return false;
+    }
+
+    bool needs_byte_swap = false;
+    if (!expect(clang::HeaderMapImpl::checkHeader(*buffer.get(),
+                                                  needs_byte_swap),
+                "the header map is accepted by clang")) {
+      return false;
+    }
+
+    clang::HeaderMapImpl header_map(std::move(buffer.get()), needs_byte_swap);
+
+    bool all_found = true;
+    for (const auto &p : entries) {
+      llvm::SmallString<256> destination;
+      auto path = header_map.lookupFilename(p.first, destination);
+
+      all_found &= expect(path == p.second, "looking up " + p.first);
+    }
+
+    llvm::SmallString<256> destination;
+
+    bool missing_ignored =
+        expect(header_map.lookupFilename("missing.h", destination).empty(),
+               "names that have not been mapped are not found");
+
+    // clang ignores the case of the keys; this is why header maps are
+    // opt-in in the generate command
+    destination.clear();
+
+    bool case_ignored =
+        expect(header_map.lookupFilename("STDIO.H", destination) ==
+                   "/usr/include/stdio.h",
+               "the keys are looked up without regard to case");
+
+    return all_found && missing_ignored && case_ignored;
+  };
+
+  auto succeeded = L_readHeaderMap();
+
+  deleteTestFolder(folder);
+  return succeeded;
+}
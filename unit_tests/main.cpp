@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "unittests.h"
+
+#include <iostream>
+
+int main() {
+  struct TestSuite final {
+    const char *name;
+    bool (*callback)();
+  };
+
+  const TestSuite kTestSuiteList[] = {
+      {"declaration scanner", runDeclarationScannerTests},
+      {"header map", runHeaderMapTests},
+      {"profile archive", runProfileArchiveTests}};
+
+  bool succeeded = true;
+
+  for (const auto &test_suite : kTestSuiteList) {
+    std::cerr << "Running the " << test_suite.name << " tests\n";
+
+    if (!test_suite.callback()) {
+      succeeded = false;
+    }
+  }
+
+  std::cerr << (succeeded ? "All tests passed" : "Some tests have failed")
+            << "\n";
+
+  return succeeded ? 0 : 1;
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "profilearchive.h"
+#include "unittests.h"
+
+#include <map>
+
+namespace {
+/// The files saved inside the test profile; the empty one checks that the
+/// null terminator is still appended
+const std::map<std::string, std::string> kProfileFiles = {
+    {"include/stdio.h", "#pragma once\n\nint printf(const char *, ...);\n"},
+    {"include/sys/types.h", "typedef unsigned long size_t;\n"},
+    {"include/empty.h", ""}};
+
+/// Packs the test profile, and reads it back
+bool testProfileArchive(const std::string &folder, bool compress) {
+  auto profile_root = folder + "/profile";
+  auto archive_path = folder + (compress ? "/compressed.pack" : "/stored.pack");
+
+  auto status = ProfileArchive::pack(profile_root, archive_path, compress);
+  if (!status.succeeded()) {
+    // zlib is optional in LLVM
+    if (compress && status.statusCode() ==
+                        ProfileArchive::StatusCode::CompressionError) {
+      return true;
+    }
+
+    return expect(false, "packing the profile: " + status.message());
+  }
+
+  ProfileArchiveRef archive;
+  status = ProfileArchive::create(archive, archive_path);
+  if (!expect(status.succeeded(), "opening the archive")) {
+    return false;
+  }
+
+  bool succeeded = true;
+
+  for (const auto &p : kProfileFiles) {
+    const auto &relative_path = p.first;
+    const auto &contents = p.second;
+
+    ProfileStorageEntry entry;
+    if (!expect(archive->lookup(entry, relative_path),
+                "looking up " + relative_path)) {
+      succeeded = false;
+      continue;
+    }
+
+    succeeded &= expect(!entry.is_directory && entry.size == contents.size(),
+                        "the size of " + relative_path);
+
+    auto buffer = archive->getFile(relative_path, relative_path);
+    if (!expect(buffer != nullptr, "reading " + relative_path)) {
+      succeeded = false;
+      continue;
+    }
+
+    succeeded &= expect(buffer->getBuffer() == contents,
+                        "the contents of " + relative_path);
+
+    succeeded &= expect(*buffer->getBufferEnd() == '\0',
+                        "the null terminator of " + relative_path);
+  }
+
+  ProfileStorageEntry entry;
+  succeeded &= expect(archive->lookup(entry, "include/sys") &&
+                          entry.is_directory,
+                      "the folders are listed");
+
+  succeeded &= expect(!archive->lookup(entry, "include/missing.h") &&
+                          archive->getFile("include/missing.h",
+                                           "include/missing.h") == nullptr,
+                      "missing files are not found");
+
+  return succeeded;
+}
+}  // namespace
+
+bool runProfileArchiveTests() {
+  std::string folder;
+  if (!expect(createTestFolder(folder), "creating the test folder")) {
+    return false;
+  }
+
+  bool succeeded = true;
+
+  for (const auto &p : kProfileFiles) {
+    if (!expect(writeTestFile(folder + "/profile/" + p.first, p.second),
+                "writing " + p.first)) {
+      succeeded = false;
+    }
+  }
+
+  if (succeeded) {
+    succeeded = testProfileArchive(folder, false);
+    succeeded &= testProfileArchive(folder, true);
+  }
+
+  deleteTestFolder(folder);
+  return succeeded;
+}
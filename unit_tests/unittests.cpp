@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "unittests.h"
+#include "std_filesystem.h"
+
+#include <fstream>
+#include <iostream>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+
+bool expect(bool condition, const std::string &description) {
+  if (!condition) {
+    std::cerr << "  Failed: " << description << "\n";
+  }
+
+  return condition;
+}
+
+bool createTestFolder(std::string &path) {
+  path.clear();
+
+  llvm::SmallString<256> unique_path;
+  if (llvm::sys::fs::createUniqueDirectory("abigen-unit-tests",
+                                           unique_path)) {
+    return false;
+  }
+
+  path = unique_path.str().str();
+  return true;
+}
+
+void deleteTestFolder(const std::string &path) {
+  std::error_code error;
+  stdfs::remove_all(path, error);
+}
+
+bool writeTestFile(const std::string &path, const std::string &contents) {
+  std::error_code error;
+  stdfs::create_directories(stdfs::path(path).parent_path(), error);
+  if (error) {
+    return false;
+  }
+
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file << contents;
+
+  return static_cast<bool>(file);
+}
@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2018-present, Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+
+/// Reports a failed check when the condition is false; returns the condition
+bool expect(bool condition, const std::string &description);
+
+/// Creates a new, empty temporary folder for a test
+bool createTestFolder(std::string &path);
+
+/// Deletes the given test folder, along with its contents
+void deleteTestFolder(const std::string &path);
+
+/// Writes the given file, creating the parent folders when needed
+bool writeTestFile(const std::string &path, const std::string &contents);
+
+/// Tests the include guard detection and the definition conflicts of the
+/// declaration scanner
+bool runDeclarationScannerTests();
+
+/// Writes a header map, and reads it back with the clang implementation
+bool runHeaderMapTests();
+
+/// Packs a profile folder, and reads the files back from the archive
+bool runProfileArchiveTests();